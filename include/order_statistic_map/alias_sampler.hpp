@@ -0,0 +1,126 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Provides O(1) weighted sampling from a fixed population with Walker's alias method, built in O(n)
+// with Vose's algorithm.
+// The sampler stores a snapshot of the entries and weights: it is not updated when the originating
+// container changes, and must be rebuilt explicitly.
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace maplib {
+
+template <class Entry>
+class AliasSampler {
+public:
+  AliasSampler() = default;
+
+  // Builds the table for `entries`, with probabilities proportional to `weights`.
+  // Throws std::invalid_argument if the sizes differ or a weight is negative.
+  template <class Weight>
+  AliasSampler(std::vector<Entry> entries, const std::vector<Weight>& weights);
+
+  // Returns an entry sampled with probability proportional to its weight.
+  // Precondition: the sampler is not empty.
+  template <class Rng>
+  const Entry& sample(Rng& rng) const;
+
+  // Number of entries with a non-zero probability of being sampled.
+  std::size_t size() const noexcept {
+    return entries_.size();
+  }
+
+  bool empty() const noexcept {
+    return entries_.empty();
+  }
+
+private:
+  struct Bucket {
+    double threshold;   // Probability of keeping the bucket's own entry.
+    std::size_t alias;  // Entry sampled otherwise.
+  };
+
+  std::vector<Entry> entries_;
+  std::vector<Bucket> buckets_;
+};
+
+template <class Entry>
+template <class Weight>
+AliasSampler<Entry>::AliasSampler(std::vector<Entry> entries, const std::vector<Weight>& weights) {
+  if (entries.size() != weights.size())
+    throw(std::invalid_argument("Number of entries and weights differ."));
+
+  // Entries with zero weight are dropped.
+  double total = 0;
+  std::vector<double> scaled;
+  scaled.reserve(weights.size());
+  for (std::size_t i = 0; i < weights.size(); ++i) {
+    if (weights[i] < 0)
+      throw(std::invalid_argument("Negative weight."));
+    if (weights[i] > 0) {
+      if (scaled.size() != i)
+        entries[scaled.size()] = std::move(entries[i]);
+      scaled.push_back(weights[i]);
+      total += weights[i];
+    }
+  }
+  entries.resize(scaled.size());
+  entries_ = std::move(entries);
+
+  const std::size_t n = entries_.size();
+  for (auto& w : scaled)
+    w *= n / total;  // Mean of one.
+
+  // Vose's algorithm: pair each under-full bucket with an over-full one.
+  buckets_.resize(n);
+  std::vector<std::size_t> small, large;
+  for (std::size_t i = 0; i < n; ++i)
+    (scaled[i] < 1 ? small : large).push_back(i);
+
+  while (!small.empty() && !large.empty()) {
+    const auto s = small.back();
+    const auto l = large.back();
+    small.pop_back();
+
+    buckets_[s] = Bucket{scaled[s], l};
+    scaled[l] -= 1 - scaled[s];
+    if (scaled[l] < 1) {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+
+  // Leftovers are full up to rounding errors.
+  for (auto i : small)
+    buckets_[i] = Bucket{1, i};
+  for (auto i : large)
+    buckets_[i] = Bucket{1, i};
+}
+
+template <class Entry>
+template <class Rng>
+const Entry& AliasSampler<Entry>::sample(Rng& rng) const {
+  assert(!empty());
+  // A single draw selects both the bucket, with the integer part, and the entry, with the
+  // fractional part.
+  const double u = std::uniform_real_distribution<double>(0, size())(rng);
+  const std::size_t index = std::min(static_cast<std::size_t>(u), size() - 1);
+  const Bucket& bucket = buckets_[index];
+
+  return u - index < bucket.threshold ? entries_[index] : entries_[bucket.alias];
+}
+
+}  // namespace maplib
@@ -0,0 +1,69 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Augmentation policies for SamplingMap. Each node stores the aggregate of the entries of its
+// subtree, in key order, and the map answers range and search queries on it in O(log n).
+// A policy is a class with the static interface:
+//   using value_type = ...;
+//   static value_type identity();
+//   static value_type make(const Key& key, const Value& value, Weight weight);
+//   static value_type combine(const value_type& left, const value_type& right);
+// `combine` must be associative, with `identity()` as neutral element, but is not required to be
+// commutative. Optionally, to allow SamplingMap::scaleAll and scaleRange, the policy provides
+//   static void scale(value_type& aggregate, Weight factor);
+// such that scale(make(k, v, w), f) equals make(k, v, w * f), and scale distributes over combine.
+
+#pragma once
+
+#include <algorithm>
+#include <limits>
+
+namespace maplib {
+namespace augmentation {
+
+// Largest weight in a range, e.g. the bound of a rejection sampler.
+template <class Weight>
+struct MaxWeight {
+  using value_type = Weight;
+
+  static value_type identity() {
+    return 0;
+  }
+  template <class Key, class Value>
+  static value_type make(const Key&, const Value&, const Weight weight) {
+    return weight;
+  }
+  static value_type combine(const value_type& left, const value_type& right) {
+    return std::max(left, right);
+  }
+  static void scale(value_type& aggregate, const Weight factor) {
+    aggregate *= factor;
+  }
+};
+
+// Smallest value in a range.
+template <class Value>
+struct MinValue {
+  using value_type = Value;
+
+  static value_type identity() {
+    return std::numeric_limits<Value>::max();
+  }
+  template <class Key, class Weight>
+  static value_type make(const Key&, const Value& value, const Weight) {
+    return value;
+  }
+  static value_type combine(const value_type& left, const value_type& right) {
+    return std::min(left, right);
+  }
+  template <class Weight>
+  static void scale(value_type&, const Weight) {}  // Independent of the weights.
+};
+
+}  // namespace augmentation
+}  // namespace maplib
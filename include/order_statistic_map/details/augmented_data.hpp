@@ -0,0 +1,79 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Storage and helpers of the user defined aggregate of a node. See augmentation.hpp for the
+// requirements of an augmentation policy.
+
+#pragma once
+
+#include <cassert>
+#include <type_traits>
+#include <utility>
+
+namespace maplib {
+namespace details {
+
+// Aggregate of the subtree under `Augmentation`. Empty if the augmentation is void.
+template <class Augmentation>
+struct AugmentedData {
+  template <class Key, class Value, class Weight>
+  AugmentedData(const Key& key, const Value& value, const Weight weight)
+      : aggregate(Augmentation::make(key, value, weight)) {}
+
+  typename Augmentation::value_type aggregate;
+};
+template <>
+struct AugmentedData<void> {
+  template <class Key, class Value, class Weight>
+  AugmentedData(const Key&, const Value&, const Weight) {}
+};
+
+// Type of the aggregate, void if there is no augmentation.
+template <class Augmentation>
+struct AggregateType {
+  using type = typename Augmentation::value_type;
+};
+template <>
+struct AggregateType<void> {
+  using type = void;
+};
+
+template <class Augmentation, class Weight, class = void>
+struct IsScalable : std::false_type {};
+template <class Augmentation, class Weight>
+struct IsScalable<Augmentation, Weight,
+                  std::void_t<decltype(Augmentation::scale(
+                      std::declval<typename Augmentation::value_type&>(), std::declval<Weight>()))>>
+    : std::true_type {};
+
+// True if the weights can be scaled lazily with the augmentation: either there is none, or it
+// provides `scale`.
+template <class Augmentation, class Weight>
+constexpr bool allowsScaling() {
+  if constexpr (std::is_void_v<Augmentation>)
+    return true;
+  else
+    return IsScalable<Augmentation, Weight>::value;
+}
+
+// Returns `aggregate` multiplied by `factor`, for an aggregate of weights scaled by `factor`.
+template <class Augmentation, class Weight>
+typename Augmentation::value_type scaleAggregate(typename Augmentation::value_type aggregate,
+                                                 const Weight factor) {
+  if constexpr (IsScalable<Augmentation, Weight>::value) {
+    if (factor != 1)
+      Augmentation::scale(aggregate, factor);
+  }
+  else {
+    assert(factor == 1);
+  }
+  return aggregate;
+}
+
+}  // namespace details
+}  // namespace maplib
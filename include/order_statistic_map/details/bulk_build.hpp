@@ -0,0 +1,50 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Construction of a valid red-black tree from sorted elements in O(n).
+
+#pragma once
+
+#include <cstddef>
+
+#include "color.hpp"
+
+namespace maplib {
+namespace details {
+
+// Builds a balanced tree from `n` elements sorted by key. `make_node(i, parent)` must return a new
+// node storing the i-th element. Splitting at the midpoint leaves all the null leaves at depth
+// floor(log2(n + 1)) or one level below: the nodes on that last, incomplete level are colored red,
+// and all the others black.
+// Returns: the root of the tree.
+template <class Node, class MakeNode>
+Node* buildBalanced(const std::size_t n, MakeNode&& make_node) {
+  unsigned red_depth = 0;
+  while ((std::size_t(2) << red_depth) <= n + 1)
+    ++red_depth;
+
+  auto build = [&](auto&& build, std::size_t begin, std::size_t end, Node* parent,
+                   unsigned depth) -> Node* {
+    if (begin == end)
+      return nullptr;
+
+    const std::size_t mid = begin + (end - begin) / 2;
+    Node* node = make_node(mid, parent);
+    node->left = build(build, begin, mid, node, depth + 1);
+    node->right = build(build, mid + 1, end, node, depth + 1);
+
+    node->color = depth == red_depth ? RED : BLACK;
+    node->updateSubtreeWeight();
+    return node;
+  };
+
+  return build(build, 0, n, nullptr, 0);
+}
+
+}  // namespace details
+}  // namespace maplib
@@ -0,0 +1,58 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Relocation of a tree in fresh memory with a cache friendly layout.
+
+#pragma once
+
+#include <queue>
+#include <utility>
+
+namespace maplib {
+namespace details {
+
+// Moves each node of the tree rooted at `root` into memory obtained from `new_allocator`, in
+// breadth first order. As the allocator hands out consecutive chunks of a fresh pool, the top
+// levels of the tree, which are touched by every search, end up close to each other.
+// The old nodes are destroyed through `old_allocator`.
+// Returns: the relocated root.
+template <class Node, class Allocator>
+Node* relocateBreadthFirst(Node* root, Allocator& old_allocator, Allocator& new_allocator) {
+  if (!root)
+    return nullptr;
+
+  // Pairs of old node and its relocated copy, whose links still point to the old children.
+  std::queue<std::pair<Node*, Node*>> to_relocate;
+
+  Node* const new_root = new_allocator.create(std::move(*root));
+  to_relocate.emplace(root, new_root);
+
+  while (!to_relocate.empty()) {
+    auto [old_node, new_node] = to_relocate.front();
+    to_relocate.pop();
+
+    auto relocate_child = [&](Node*& child) {
+      if (child) {
+        Node* const new_child = new_allocator.create(std::move(*child));
+        new_child->parent = new_node;
+        to_relocate.emplace(child, new_child);
+        child = new_child;
+      }
+    };
+
+    relocate_child(new_node->left);
+    relocate_child(new_node->right);
+
+    old_allocator.destroy(old_node);
+  }
+
+  return new_root;
+}
+
+}  // namespace details
+}  // namespace maplib
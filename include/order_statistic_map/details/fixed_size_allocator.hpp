@@ -47,6 +47,11 @@ public:
   [[nodiscard]] T* allocate(std::size_t n = 1);
   void deallocate(T* ptr, std::size_t n = 1) noexcept;
 
+  // Number of pools of memory allocated so far.
+  std::size_t poolCount() const noexcept {
+    return pools_.size();
+  }
+
 private:
   void allocatePool();
 
@@ -0,0 +1,163 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Records the latency of the single container operations in log-bucketed histograms, to measure
+// the tail latency caused by rebalancing cascades and pool allocations.
+// Tracing is enabled by defining MAPLIB_ENABLE_TRACING before including any header of the library
+// and by attaching a LatencyTracer to a container. Otherwise the hooks compile to nothing.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace maplib {
+
+// Histogram of latencies with four buckets per power of two, i.e. a relative error below 25%.
+class LatencyHistogram {
+public:
+  void record(std::uint64_t ticks) noexcept {
+    ++buckets_[bucketIndex(ticks)];
+    ++count_;
+    max_ = std::max(max_, ticks);
+  }
+
+  // Returns an upper bound of the `q`-quantile, with q in [0, 1]. Returns zero if empty.
+  std::uint64_t percentile(double q) const noexcept;
+
+  std::uint64_t max() const noexcept {
+    return max_;
+  }
+  std::size_t count() const noexcept {
+    return count_;
+  }
+
+  void reset() noexcept {
+    *this = LatencyHistogram();
+  }
+
+private:
+  constexpr static int sub_bits_ = 2;
+  constexpr static std::size_t linear_range_ = 4 << sub_bits_;
+  constexpr static std::size_t n_buckets_ = linear_range_ + (64 - 2 - sub_bits_) * (1 << sub_bits_);
+
+  static std::size_t bucketIndex(std::uint64_t ticks) noexcept;
+  static std::uint64_t bucketUpperBound(std::size_t index) noexcept;
+
+  std::array<std::size_t, n_buckets_> buckets_{};
+  std::size_t count_ = 0;
+  std::uint64_t max_ = 0;
+};
+
+enum class Operation { INSERT, ERASE, FIND, FIND_BY_INDEX, SAMPLE, COUNT };
+
+// Collects the latencies, in ticks of the time stamp counter, of the operations performed by the
+// containers it is attached to. On architectures without a time stamp counter, ticks are ns.
+class LatencyTracer {
+public:
+  void record(Operation op, std::uint64_t ticks) noexcept {
+    histograms_[static_cast<int>(op)].record(ticks);
+  }
+
+  const LatencyHistogram& histogram(Operation op) const noexcept {
+    return histograms_[static_cast<int>(op)];
+  }
+
+  void reset() noexcept {
+    for (auto& histogram : histograms_)
+      histogram.reset();
+  }
+
+private:
+  std::array<LatencyHistogram, static_cast<int>(Operation::COUNT)> histograms_;
+};
+
+inline std::uint64_t LatencyHistogram::percentile(double q) const noexcept {
+  if (!count_)
+    return 0;
+
+  const auto target = std::max<std::size_t>(1, static_cast<std::size_t>(q * count_ + 0.5));
+  std::size_t seen = 0;
+  for (std::size_t i = 0; i < n_buckets_; ++i) {
+    seen += buckets_[i];
+    if (seen >= target)
+      return std::min(bucketUpperBound(i), max_);
+  }
+  return max_;
+}
+
+inline std::size_t LatencyHistogram::bucketIndex(std::uint64_t ticks) noexcept {
+  if (ticks < linear_range_)
+    return ticks;
+
+  int exponent = 63;
+  while (!(ticks >> exponent))
+    --exponent;
+  const std::size_t sub = (ticks >> (exponent - sub_bits_)) & ((1 << sub_bits_) - 1);
+  return linear_range_ + (exponent - 2 - sub_bits_) * (1 << sub_bits_) + sub;
+}
+
+inline std::uint64_t LatencyHistogram::bucketUpperBound(std::size_t index) noexcept {
+  if (index < linear_range_)
+    return index;
+
+  const int exponent = (index - linear_range_) / (1 << sub_bits_) + 2 + sub_bits_;
+  const std::uint64_t sub = (index - linear_range_) % (1 << sub_bits_);
+  const std::uint64_t lower = (std::uint64_t(1) << exponent) | (sub << (exponent - sub_bits_));
+  return lower + (std::uint64_t(1) << (exponent - sub_bits_)) - 1;
+}
+
+namespace details {
+
+inline std::uint64_t readTicks() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+// Records the lifetime of the object into the tracer, if any.
+class ScopedTrace {
+public:
+  ScopedTrace(LatencyTracer* tracer, Operation op) noexcept
+      : tracer_(tracer), op_(op), start_(tracer ? readTicks() : 0) {}
+  ~ScopedTrace() {
+    if (tracer_)
+      tracer_->record(op_, readTicks() - start_);
+  }
+
+  ScopedTrace(const ScopedTrace&) = delete;
+  ScopedTrace& operator=(const ScopedTrace&) = delete;
+
+private:
+  LatencyTracer* const tracer_;
+  const Operation op_;
+  const std::uint64_t start_;
+};
+
+class NoTrace {
+public:
+  NoTrace(LatencyTracer*, Operation) noexcept {}
+};
+
+#ifdef MAPLIB_ENABLE_TRACING
+using Trace = ScopedTrace;
+#else
+using Trace = NoTrace;
+#endif
+
+}  // namespace details
+}  // namespace maplib
@@ -0,0 +1,267 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Storage of fixed size objects in a memory mapped file (POSIX only).
+// The file starts with a small layout description, followed by a user defined header and an array
+// of slots. Free slots are kept in a stack linked by index, so that the file is position independent.
+
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace maplib {
+namespace details {
+
+template <class T, class Header>
+class MappedStorage {
+public:
+  // Takes ownership of the open file descriptor `fd`. An empty file is initialized with room for
+  // `initial_capacity` objects and a value initialized header, otherwise its layout is validated.
+  // If `growable` is false, allocating beyond the capacity throws std::length_error.
+  // A `read_only` storage must be backed by an initialized file and can not allocate.
+  MappedStorage(int fd, std::size_t initial_capacity, bool growable = true, bool read_only = false);
+  ~MappedStorage();
+
+  MappedStorage(const MappedStorage&) = delete;
+  MappedStorage& operator=(const MappedStorage&) = delete;
+
+  Header& header() noexcept {
+    return layout()->header;
+  }
+  const Header& header() const noexcept {
+    return layout()->header;
+  }
+
+  // Guarantees that the next `n` allocations do not remap the file.
+  // Returns true if the file has been remapped, possibly at a different address: every pointer
+  // into the storage is then invalidated.
+  bool reserve(std::size_t n);
+
+  // Constructs a new object in a free slot.
+  // Precondition: a slot has been reserved.
+  template <class... Args>
+  [[nodiscard]] T* create(Args&&... args);
+
+  // Calls the destructor and returns the slot to the free stack.
+  void destroy(T* ptr) noexcept;
+
+  // Flushes the dirty pages to the file. Blocks until the write is complete.
+  void sync();
+
+  std::size_t capacity() const noexcept {
+    return layout()->capacity;
+  }
+
+  // Returns true if `ptr` points to a slot of the current mapping.
+  bool contains(const void* ptr) const noexcept;
+
+private:
+  struct Layout {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t object_size;
+    std::uint32_t header_size;
+    std::uint64_t capacity;   // number of slots.
+    std::uint64_t used;       // slots handed out at least once.
+    std::uint64_t free_head;  // index + 1 of the topmost free slot, zero if the stack is empty.
+    Header header;
+  };
+
+  static constexpr char expected_magic_[8] = {'M', 'A', 'P', 'L', 'I', 'B', 'M', 'M'};
+  static constexpr std::uint32_t version_ = 1;
+  static constexpr std::size_t alignment_ = std::max(alignof(T), alignof(std::uint64_t));
+  static constexpr std::size_t slot_size_ =
+      (std::max(sizeof(T), sizeof(std::uint64_t)) + alignment_ - 1) / alignment_ * alignment_;
+  static constexpr std::size_t slots_offset_ =
+      (sizeof(Layout) + alignment_ - 1) / alignment_ * alignment_;
+
+  static std::size_t fileSize(std::size_t capacity) noexcept {
+    return slots_offset_ + capacity * slot_size_;
+  }
+
+  Layout* layout() const noexcept {
+    return reinterpret_cast<Layout*>(base_);
+  }
+  char* slot(std::uint64_t index) const noexcept {
+    return base_ + slots_offset_ + index * slot_size_;
+  }
+
+  void map(std::size_t bytes);
+  void unmap() noexcept;
+  void grow(std::size_t new_capacity);
+
+  [[noreturn]] static void throwErrno(const char* what) {
+    throw(std::system_error(errno, std::generic_category(), what));
+  }
+
+  int fd_ = -1;
+  char* base_ = nullptr;
+  std::size_t mapped_bytes_ = 0;
+  bool growable_;
+  bool read_only_;
+};
+
+template <class T, class Header>
+MappedStorage<T, Header>::MappedStorage(int fd, std::size_t initial_capacity, bool growable,
+                                        bool read_only)
+    : fd_(fd), growable_(growable && !read_only), read_only_(read_only) {
+  struct stat file_stat;
+  if (fstat(fd_, &file_stat)) {
+    close(fd_);
+    throwErrno("fstat");
+  }
+
+  try {
+    if (file_stat.st_size == 0) {
+      if (read_only_)
+        throw(std::runtime_error("Can not initialize a read only storage."));
+
+      initial_capacity = std::max<std::size_t>(initial_capacity, 1);
+      if (ftruncate(fd_, fileSize(initial_capacity)))
+        throwErrno("ftruncate");
+      map(fileSize(initial_capacity));
+
+      Layout* const l = new (base_) Layout{};
+      std::memcpy(l->magic, expected_magic_, sizeof(l->magic));
+      l->version = version_;
+      l->object_size = sizeof(T);
+      l->header_size = sizeof(Header);
+      l->capacity = initial_capacity;
+    }
+    else {
+      if (static_cast<std::size_t>(file_stat.st_size) < sizeof(Layout))
+        throw(std::runtime_error("File is too small to contain a map."));
+      map(file_stat.st_size);
+
+      const Layout* const l = layout();
+      if (std::memcmp(l->magic, expected_magic_, sizeof(l->magic)) || l->version != version_)
+        throw(std::runtime_error("File does not contain a map."));
+      if (l->object_size != sizeof(T) || l->header_size != sizeof(Header))
+        throw(std::runtime_error("File was written with different types."));
+      if (fileSize(l->capacity) > mapped_bytes_)
+        throw(std::runtime_error("File is truncated."));
+    }
+  }
+  catch (...) {
+    unmap();
+    close(fd_);
+    throw;
+  }
+}
+
+template <class T, class Header>
+MappedStorage<T, Header>::~MappedStorage() {
+  unmap();
+  close(fd_);
+}
+
+template <class T, class Header>
+bool MappedStorage<T, Header>::reserve(std::size_t n) {
+  std::size_t available = capacity() - layout()->used;
+  for (std::uint64_t idx = layout()->free_head; idx && available < n;) {
+    ++available;
+    std::memcpy(&idx, slot(idx - 1), sizeof(idx));
+  }
+
+  if (available >= n)
+    return false;
+
+  if (!growable_)
+    throw(std::length_error("Mapped storage is full."));
+
+  grow(std::max(2 * capacity(), capacity() + n - available));
+  return true;
+}
+
+template <class T, class Header>
+template <class... Args>
+T* MappedStorage<T, Header>::create(Args&&... args) {
+  Layout* const l = layout();
+  char* allocation;
+
+  if (l->free_head) {
+    allocation = slot(l->free_head - 1);
+    std::memcpy(&l->free_head, allocation, sizeof(l->free_head));
+  }
+  else {
+    if (l->used == l->capacity)
+      throw(std::length_error("Mapped storage is full."));
+    allocation = slot(l->used++);
+  }
+
+  return new (allocation) T(std::forward<Args>(args)...);
+}
+
+template <class T, class Header>
+void MappedStorage<T, Header>::destroy(T* ptr) noexcept {
+  if (!ptr)
+    return;
+  ptr->~T();
+
+  Layout* const l = layout();
+  char* const allocation = reinterpret_cast<char*>(ptr);
+  std::memcpy(allocation, &l->free_head, sizeof(l->free_head));
+  l->free_head = (allocation - slot(0)) / slot_size_ + 1;
+}
+
+template <class T, class Header>
+void MappedStorage<T, Header>::sync() {
+  if (msync(base_, mapped_bytes_, MS_SYNC))
+    throwErrno("msync");
+}
+
+template <class T, class Header>
+bool MappedStorage<T, Header>::contains(const void* ptr) const noexcept {
+  const char* const p = reinterpret_cast<const char*>(ptr);
+  return p >= slot(0) && p + sizeof(T) <= base_ + mapped_bytes_ &&
+         (p - slot(0)) % slot_size_ == 0;
+}
+
+template <class T, class Header>
+void MappedStorage<T, Header>::map(std::size_t bytes) {
+  const int protection = read_only_ ? PROT_READ : PROT_READ | PROT_WRITE;
+  void* const address = mmap(nullptr, bytes, protection, MAP_SHARED, fd_, 0);
+  if (address == MAP_FAILED)
+    throwErrno("mmap");
+
+  base_ = static_cast<char*>(address);
+  mapped_bytes_ = bytes;
+}
+
+template <class T, class Header>
+void MappedStorage<T, Header>::unmap() noexcept {
+  if (base_)
+    munmap(base_, mapped_bytes_);
+  base_ = nullptr;
+  mapped_bytes_ = 0;
+}
+
+template <class T, class Header>
+void MappedStorage<T, Header>::grow(std::size_t new_capacity) {
+  if (ftruncate(fd_, fileSize(new_capacity)))
+    throwErrno("ftruncate");
+
+  // The content is position independent: a new mapping anywhere in memory stays valid.
+  unmap();
+  map(fileSize(new_capacity));
+  layout()->capacity = new_capacity;
+}
+
+}  // namespace details
+}  // namespace maplib
@@ -0,0 +1,78 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Internal node for MultiSamplingMap, storing one weight and subtree weight per channel.
+// The channels of a node are contiguous, and are updated together by loops of fixed length that
+// the compiler vectorizes.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "color.hpp"
+
+namespace maplib {
+namespace details {
+
+template <class Weight, std::size_t channels>
+using WeightArray = std::array<Weight, channels>;
+
+// Element-wise a += b and a -= b.
+template <class Weight, std::size_t channels>
+void addWeights(WeightArray<Weight, channels>& a, const WeightArray<Weight, channels>& b) {
+  for (std::size_t c = 0; c < channels; ++c)
+    a[c] += b[c];
+}
+template <class Weight, std::size_t channels>
+void subtractWeights(WeightArray<Weight, channels>& a, const WeightArray<Weight, channels>& b) {
+  for (std::size_t c = 0; c < channels; ++c)
+    a[c] -= b[c];
+}
+
+template <class _Key, class _Value, class _Weight, std::size_t _channels>
+struct MultiWeightedNode {
+  using Key = _Key;
+  using Value = _Value;
+  using Weight = _Weight;
+  constexpr static std::size_t channels = _channels;
+  using Weights = WeightArray<Weight, channels>;
+
+  MultiWeightedNode(const Key& k, const Value& v, const Weights& w, MultiWeightedNode* p)
+      : parent(p), weight(w), subtree_weight(w), data(k, v) {}
+
+  void updateSubtreeWeight();
+  void swapMetadata(MultiWeightedNode& rhs) {
+    std::swap(subtree_weight, rhs.subtree_weight);
+  }
+
+  MultiWeightedNode* left = nullptr;
+  MultiWeightedNode* right = nullptr;
+  MultiWeightedNode* parent = nullptr;
+
+  Weights weight;
+  Weights subtree_weight;
+
+  std::pair<Key, Value> data;
+
+  Color color = RED;
+};
+
+template <class Key, class Value, class Weight, std::size_t channels>
+void MultiWeightedNode<Key, Value, Weight, channels>::updateSubtreeWeight() {
+  subtree_weight = weight;
+  if (left)
+    addWeights(subtree_weight, left->subtree_weight);
+  if (right)
+    addWeights(subtree_weight, right->subtree_weight);
+}
+
+}  // namespace details
+}  // namespace maplib
@@ -11,7 +11,11 @@
 
 #pragma once
 
+#include <type_traits>
+#include <utility>
+
 #include "color.hpp"
+#include "statistics.hpp"
 
 namespace maplib {
 namespace details {
@@ -52,6 +56,26 @@ auto getSibling(const Node* node) -> Node* {
     return nullptr;
 }
 
+template <class Node, class = void>
+struct HasPushDown : std::false_type {};
+template <class Node>
+struct HasPushDown<Node, std::void_t<decltype(std::declval<Node&>().pushDown())>> : std::true_type {};
+
+// True for nodes storing a pending scale of the weights of their descendants.
+template <class Node, class = void>
+struct HasPendingScale : std::false_type {};
+template <class Node>
+struct HasPendingScale<Node, std::void_t<decltype(std::declval<const Node&>().scale)>>
+    : std::true_type {};
+
+// Applies the pending lazy updates of nodes that support them, e.g. WeightedNode, to the children.
+// Must be called before a node changes children.
+template <class Node>
+void pushDown(Node* node) {
+  if constexpr (HasPushDown<Node>::value)
+    node->pushDown();
+}
+
 template <class Node>
 void moveDown(Node* node, Node* new_parent) {
   auto& parent = node->parent;
@@ -65,8 +89,10 @@ void moveDown(Node* node, Node* new_parent) {
   parent = new_parent;
 }
 
-template <class Node>
-void fixDoubleBlack(Node* x, Node*& root) {
+// The optional `stats` argument of the following functions records the work performed.
+template <class Node, class Stats = NoStatistics>
+void fixDoubleBlack(Node* x, Node*& root, Stats&& stats = Stats(), std::size_t depth = 1) {
+  stats.countFixDepth(depth);
   if (x == root) {  // Reached root
     return;
   }
@@ -81,7 +107,7 @@ void fixDoubleBlack(Node* x, Node*& root) {
 
   if (sibling == nullptr) {
     // No sibiling, double black pushed up
-    fixDoubleBlack(parent, root);
+    fixDoubleBlack(parent, root, stats, depth + 1);
   }
   else {
     if (sibling->color == RED) {
@@ -90,13 +116,13 @@ void fixDoubleBlack(Node* x, Node*& root) {
       sibling->color = BLACK;
       if (isLeftChild(sibling)) {
         // left case
-        rightRotate(parent, root);
+        rightRotate(parent, root, stats);
       }
       else {
         // right case
-        leftRotate(parent, root);
+        leftRotate(parent, root, stats);
       }
-      fixDoubleBlack(x, root);
+      fixDoubleBlack(x, root, stats, depth + 1);
     }
     else {
       // Sibling black
@@ -107,27 +133,27 @@ void fixDoubleBlack(Node* x, Node*& root) {
             // left left
             sibling->left->color = sibling->color;
             sibling->color = parent->color;
-            rightRotate(parent, root);
+            rightRotate(parent, root, stats);
           }
           else {
             // right left
             sibling->left->color = parent->color;
-            rightRotate(sibling, root);
-            leftRotate(parent, root);
+            rightRotate(sibling, root, stats);
+            leftRotate(parent, root, stats);
           }
         }
         else {
           if (isLeftChild(sibling)) {
             // left right
             sibling->right->color = parent->color;
-            leftRotate(sibling, root);
-            rightRotate(parent, root);
+            leftRotate(sibling, root, stats);
+            rightRotate(parent, root, stats);
           }
           else {
             // right right
             sibling->right->color = sibling->color;
             sibling->color = parent->color;
-            leftRotate(parent, root);
+            leftRotate(parent, root, stats);
           }
         }
         parent->color = BLACK;
@@ -136,7 +162,7 @@ void fixDoubleBlack(Node* x, Node*& root) {
         // 2 black children
         sibling->color = RED;
         if (parent->color == BLACK)
-          fixDoubleBlack(parent, root);
+          fixDoubleBlack(parent, root, stats, depth + 1);
         else
           parent->color = BLACK;
       }
@@ -144,10 +170,14 @@ void fixDoubleBlack(Node* x, Node*& root) {
   }
 }
 
-template <class Node>
-void rightRotate(Node* const node, Node*& root) {
+template <class Node, class Stats = NoStatistics>
+void rightRotate(Node* const node, Node*& root, Stats&& stats = Stats()) {
+  stats.countRotation();
+
   // new parent will be node's left child
   Node* new_parent = node->left;
+  pushDown(node);
+  pushDown(new_parent);
 
   // update root if current node is root
   if (node == root)
@@ -169,10 +199,14 @@ void rightRotate(Node* const node, Node*& root) {
   new_parent->updateSubtreeWeight();
 }
 
-template <class Node>
-void leftRotate(Node* node, Node*& root) {
+template <class Node, class Stats = NoStatistics>
+void leftRotate(Node* node, Node*& root, Stats&& stats = Stats()) {
+  stats.countRotation();
+
   // new parent will be node's right child
   Node* new_parent = node->right;
+  pushDown(node);
+  pushDown(new_parent);
 
   // update root_ if current node is root_
   if (node == root)
@@ -194,8 +228,8 @@ void leftRotate(Node* node, Node*& root) {
   new_parent->updateSubtreeWeight();
 }
 
-template <class Node>
-void fixRedRed(Node* x, Node*& root) {
+template <class Node, class Stats = NoStatistics>
+void fixRedRed(Node* x, Node*& root, Stats&& stats = Stats()) {
   // if x is root color it black and return
   if (x == root) {
     x->color = BLACK;
@@ -213,7 +247,7 @@ void fixRedRed(Node* x, Node*& root) {
       parent->color = BLACK;
       uncle->color = BLACK;
       grandparent->color = RED;
-      fixRedRed(grandparent, root);
+      fixRedRed(grandparent, root, stats);
     }
     else {
       if (isLeftChild(parent)) {
@@ -222,16 +256,16 @@ void fixRedRed(Node* x, Node*& root) {
           std::swap(parent->color, grandparent->color);
         }
         else {
-          leftRotate(parent, root);
+          leftRotate(parent, root, stats);
           std::swap(x->color, grandparent->color);
         }
         // for left left and left right
-        rightRotate(grandparent, root);
+        rightRotate(grandparent, root, stats);
       }
       else {
         if (isLeftChild(x)) {
           // for right left
-          rightRotate(parent, root);
+          rightRotate(parent, root, stats);
           std::swap(x->color, grandparent->color);
         }
         else {
@@ -239,20 +273,20 @@ void fixRedRed(Node* x, Node*& root) {
         }
 
         // for right right and right left
-        leftRotate(grandparent, root);
+        leftRotate(grandparent, root, stats);
       }
     }
   }
 }
-template <class Node>
-void removeNoDoubleChild(Node* to_delete, Node*& root) noexcept {
+template <class Node, class Stats = NoStatistics>
+void removeNoDoubleChild(Node* to_delete, Node*& root, Stats&& stats = Stats()) noexcept {
   Node* replacement = to_delete->left ? to_delete->left : to_delete->right;
 
   auto color = [](const Node* n) { return n ? n->color : BLACK; };
   const bool both_black = color(replacement) == BLACK && to_delete->color == BLACK;
 
   if (both_black) {
-    fixDoubleBlack(to_delete, root);
+    fixDoubleBlack(to_delete, root, stats);
   }
   else {
     auto sibling = getSibling(to_delete);
@@ -0,0 +1,91 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Small hash table from node addresses to values, with open addressing and linear probing.
+// Used to annotate a few nodes of a tree for the duration of a query, without touching the tree and
+// without allocating one bucket per entry.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace maplib {
+namespace details {
+
+template <class Node, class Value>
+class NodeTable {
+public:
+  // Allocates room for `expected_size` entries.
+  explicit NodeTable(std::size_t expected_size = 8) {
+    std::size_t capacity = 16;
+    while (capacity < 2 * expected_size)
+      capacity *= 2;
+    slots_.resize(capacity);
+  }
+
+  // Returns the value associated with `node`, or nullptr if absent.
+  const Value* find(const Node* node) const noexcept {
+    for (std::size_t i = hash(node);; i = (i + 1) & mask()) {
+      if (slots_[i].first == node)
+        return &slots_[i].second;
+      if (!slots_[i].first)
+        return nullptr;
+    }
+  }
+
+  // Returns the value associated with `node`, default constructing it if absent.
+  Value& operator[](const Node* node) {
+    std::size_t i = hash(node);
+    for (; slots_[i].first; i = (i + 1) & mask()) {
+      if (slots_[i].first == node)
+        return slots_[i].second;
+    }
+
+    if (2 * (size_ + 1) > slots_.size()) {  // Keep the load factor below 1/2.
+      grow();
+      return (*this)[node];
+    }
+    ++size_;
+    slots_[i].first = node;
+    return slots_[i].second;
+  }
+
+  std::size_t size() const noexcept {
+    return size_;
+  }
+
+private:
+  std::size_t mask() const noexcept {
+    return slots_.size() - 1;
+  }
+
+  std::size_t hash(const Node* node) const noexcept {
+    // Fibonacci hashing of the address, discarding the alignment bits.
+    const auto bits = reinterpret_cast<std::uintptr_t>(node) >> 4;
+    return static_cast<std::size_t>(bits * 11400714819323198485ull >> 32) & mask();
+  }
+
+  void grow() {
+    std::vector<std::pair<const Node*, Value>> old(slots_.size() * 2);
+    std::swap(old, slots_);
+    size_ = 0;
+    for (auto& [node, value] : old) {
+      if (node)
+        (*this)[node] = std::move(value);
+    }
+  }
+
+  std::vector<std::pair<const Node*, Value>> slots_;
+  std::size_t size_ = 0;
+};
+
+}  // namespace details
+}  // namespace maplib
@@ -0,0 +1,55 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Internal node for PersistentOrderStatisticMap. Same as Node, but linked through self-relative
+// pointers, so that a tree stored in a memory mapped file can be mapped at any address.
+
+#pragma once
+
+#include <utility>
+
+#include "color.hpp"
+#include "offset_ptr.hpp"
+
+namespace maplib {
+namespace details {
+
+template <class _Key, class _Value>
+struct OffsetNode {
+  using Key = _Key;
+  using Value = _Value;
+
+  OffsetNode(const Key& k, const Value& v, OffsetNode* p) : parent(p), data(k, v) {}
+
+  void updateSubtreeWeight();
+  void swapMetadata(OffsetNode& rhs) {
+    std::swap(subtree_size, rhs.subtree_size);
+  }
+
+  OffsetPtr<OffsetNode> left = nullptr;
+  OffsetPtr<OffsetNode> right = nullptr;
+  OffsetPtr<OffsetNode> parent = nullptr;
+
+  std::size_t subtree_size = 1;
+
+  std::pair<Key, Value> data;
+
+  Color color = RED;
+};
+
+template <class Key, class Value>
+void OffsetNode<Key, Value>::updateSubtreeWeight() {
+  subtree_size = 1;
+  if (left)
+    subtree_size += left->subtree_size;
+  if (right)
+    subtree_size += right->subtree_size;
+}
+
+}  // namespace details
+}  // namespace maplib
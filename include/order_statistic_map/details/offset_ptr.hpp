@@ -0,0 +1,66 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Self-relative pointer: stores the distance between the pointee and the pointer itself, so that a
+// block of memory containing both stays valid when it is mapped at a different address.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace maplib {
+namespace details {
+
+template <class T>
+class OffsetPtr {
+public:
+  OffsetPtr(T* ptr = nullptr) noexcept {
+    set(ptr);
+  }
+  // The offset depends on the address of the pointer: copies must recompute it.
+  OffsetPtr(const OffsetPtr& rhs) noexcept {
+    set(rhs.get());
+  }
+
+  OffsetPtr& operator=(const OffsetPtr& rhs) noexcept {
+    set(rhs.get());
+    return *this;
+  }
+  OffsetPtr& operator=(T* ptr) noexcept {
+    set(ptr);
+    return *this;
+  }
+
+  T* get() const noexcept {
+    if (!offset_)
+      return nullptr;
+    return reinterpret_cast<T*>(reinterpret_cast<std::intptr_t>(this) + offset_);
+  }
+
+  operator T*() const noexcept {
+    return get();
+  }
+  T* operator->() const noexcept {
+    return get();
+  }
+  T& operator*() const noexcept {
+    return *get();
+  }
+
+private:
+  // A zero offset represents the null pointer, as nothing points to itself.
+  void set(T* ptr) noexcept {
+    offset_ = ptr ? reinterpret_cast<std::intptr_t>(ptr) - reinterpret_cast<std::intptr_t>(this) : 0;
+  }
+
+  std::ptrdiff_t offset_ = 0;
+};
+
+}  // namespace details
+}  // namespace maplib
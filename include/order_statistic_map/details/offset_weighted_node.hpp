@@ -0,0 +1,72 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Internal node for SharedSamplingMap. Same as WeightedNode, but linked through self-relative
+// pointers, so that each process can map the tree at a different address. The subtree size is
+// stored as well, to support access by index.
+
+#pragma once
+
+#include <utility>
+
+#include "color.hpp"
+#include "offset_ptr.hpp"
+
+namespace maplib {
+namespace details {
+
+template <class _Key, class _Value, class _Weight>
+struct OffsetWeightedNode {
+  using Key = _Key;
+  using Value = _Value;
+  using Weight = _Weight;
+  constexpr static bool augmented = false;
+
+  OffsetWeightedNode(const Key& k, const Value& v, const Weight w, OffsetWeightedNode* p)
+      : parent(p), weight(w), subtree_weight(w), data(k, v) {}
+
+  void updateSubtreeWeight();
+  void swapMetadata(OffsetWeightedNode& rhs) {
+    std::swap(subtree_weight, rhs.subtree_weight);
+    std::swap(subtree_size, rhs.subtree_size);
+  }
+
+  // Lazy scaling is not supported: the stored weights are always exact.
+  Weight ancestorsScale() const {
+    return 1;
+  }
+
+  OffsetPtr<OffsetWeightedNode> left = nullptr;
+  OffsetPtr<OffsetWeightedNode> right = nullptr;
+  OffsetPtr<OffsetWeightedNode> parent = nullptr;
+
+  Weight weight;
+  Weight subtree_weight;
+  std::size_t subtree_size = 1;
+
+  std::pair<Key, Value> data;
+
+  Color color = RED;
+};
+
+template <class Key, class Value, class Weight>
+void OffsetWeightedNode<Key, Value, Weight>::updateSubtreeWeight() {
+  subtree_weight = weight;
+  subtree_size = 1;
+  if (left) {
+    subtree_weight += left->subtree_weight;
+    subtree_size += left->subtree_size;
+  }
+  if (right) {
+    subtree_weight += right->subtree_weight;
+    subtree_size += right->subtree_size;
+  }
+}
+
+}  // namespace details
+}  // namespace maplib
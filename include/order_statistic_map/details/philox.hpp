@@ -0,0 +1,53 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Counter based random number generator Philox4x32-10 (Salmon et al., "Parallel random numbers: as
+// easy as 1, 2, 3", SC 2011). The output is a pure function of a counter and a key, so that the
+// i-th random number of a stream can be computed independently by any thread.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace maplib {
+namespace details {
+
+using PhiloxCounter = std::array<std::uint32_t, 4>;
+using PhiloxKey = std::array<std::uint32_t, 2>;
+
+// Returns the ten rounds encryption of `counter` with `key`.
+inline PhiloxCounter philox4x32(PhiloxCounter counter, PhiloxKey key) noexcept {
+  constexpr std::uint32_t multipliers[2] = {0xD2511F53, 0xCD9E8D57};
+  constexpr std::uint32_t key_increments[2] = {0x9E3779B9, 0xBB67AE85};
+
+  for (int round = 0; round < 10; ++round) {
+    if (round > 0) {
+      key[0] += key_increments[0];
+      key[1] += key_increments[1];
+    }
+
+    const std::uint64_t product0 = std::uint64_t(multipliers[0]) * counter[0];
+    const std::uint64_t product1 = std::uint64_t(multipliers[1]) * counter[2];
+    counter = {std::uint32_t(product1 >> 32) ^ counter[1] ^ key[0], std::uint32_t(product1),
+               std::uint32_t(product0 >> 32) ^ counter[3] ^ key[1], std::uint32_t(product0)};
+  }
+
+  return counter;
+}
+
+// Returns the `index`-th number of the stream `seed`, uniformly distributed in [0, 1).
+inline double philoxUniform(const std::uint64_t seed, const std::uint64_t index) noexcept {
+  const auto bits = philox4x32({std::uint32_t(index), std::uint32_t(index >> 32), 0, 0},
+                               {std::uint32_t(seed), std::uint32_t(seed >> 32)});
+  const std::uint64_t mantissa = (std::uint64_t(bits[0]) << 32 | bits[1]) >> 11;
+  return mantissa * 0x1p-53;
+}
+
+}  // namespace details
+}  // namespace maplib
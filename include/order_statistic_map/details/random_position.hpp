@@ -0,0 +1,103 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Uniform draws of cumulative weight positions, used to sample a weighted tree.
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <random>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace maplib {
+namespace details {
+
+// Returns a position uniformly distributed in [0, total) for integer weights, and in [0, total]
+// for floating point weights.
+template <class Weight, class Rng>
+Weight randomPosition(Rng& rng, const Weight total) {
+  if constexpr (std::is_floating_point_v<Weight>) {
+    assert(total >= 0);
+    return std::uniform_real_distribution<Weight>(0, total)(rng);
+  }
+  else {  // is integer
+    static_assert(std::is_integral_v<Weight>, "Weight needs to be floating or integer.");
+    return std::uniform_int_distribution<Weight>(0, total - 1)(rng);
+  }
+}
+
+// Maps `uniform` in [0, 1] to a position in the range of randomPosition, preserving the order.
+// Precondition: total > 0.
+template <class Weight>
+Weight scalePosition(const double uniform, const Weight total) noexcept {
+  if constexpr (std::is_floating_point_v<Weight>) {
+    return std::min<Weight>(uniform * total, total);
+  }
+  else {
+    static_assert(std::is_integral_v<Weight>, "Weight needs to be floating or integer.");
+    return std::min<Weight>(static_cast<Weight>(uniform * total), total - 1);
+  }
+}
+
+// Writes in `positions`, in ascending order, `k` values distributed as `k` independent calls to
+// randomPosition. The sorted sample is generated in O(k) as the normalized partial sums of k + 1
+// exponential spacings, without sorting.
+template <class Weight, class Rng>
+void sortedRandomPositions(Rng& rng, const Weight total, const std::size_t k,
+                           std::vector<Weight>& positions) {
+  positions.resize(k);
+  if (total <= 0) {  // Nothing to sample.
+    std::fill(positions.begin(), positions.end(), Weight(0));
+    return;
+  }
+
+  std::exponential_distribution<double> spacing;
+  std::vector<double> partial_sums(k);
+  double sum = 0;
+  for (auto& partial_sum : partial_sums) {
+    sum += spacing(rng);
+    partial_sum = sum;
+  }
+  sum += spacing(rng);
+
+  for (std::size_t i = 0; i < k; ++i)  // i-th order statistic of k uniforms in [0, 1].
+    positions[i] = scalePosition(partial_sums[i] / sum, total);
+}
+
+// Sorts pairs by their first element, uniformly distributed in [0, 1), in O(n) expected time by
+// distributing them into n buckets.
+template <class T>
+void bucketSortUniform(std::vector<std::pair<double, T>>& values) {
+  const std::size_t n = values.size();
+  auto bucket = [n](double u) { return std::min(static_cast<std::size_t>(u * n), n - 1); };
+
+  std::vector<std::size_t> bucket_begin(n + 1, 0);
+  for (const auto& value : values)
+    ++bucket_begin[bucket(value.first) + 1];
+  for (std::size_t b = 0; b < n; ++b)
+    bucket_begin[b + 1] += bucket_begin[b];
+
+  std::vector<std::pair<double, T>> sorted(n);
+  std::vector<std::size_t> bucket_end(bucket_begin.begin(), bucket_begin.end() - 1);
+  for (auto& value : values)
+    sorted[bucket_end[bucket(value.first)]++] = std::move(value);
+
+  // Buckets hold one value on average.
+  for (std::size_t b = 0; b < n; ++b) {
+    if (bucket_begin[b + 1] - bucket_begin[b] > 1)
+      std::sort(sorted.begin() + bucket_begin[b], sorted.begin() + bucket_begin[b + 1]);
+  }
+  values = std::move(sorted);
+}
+
+}  // namespace details
+}  // namespace maplib
@@ -0,0 +1,96 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Binary snapshot format shared by the containers' save and load methods.
+// Layout: SnapshotHeader, followed by one contiguous array per column (keys, values, weights).
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace maplib {
+namespace details {
+
+struct SnapshotHeader {
+  static constexpr char expected_magic[8] = {'M', 'A', 'P', 'L', 'I', 'B', 'S', 'N'};
+  static constexpr std::uint32_t current_version = 1;
+
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t n_columns;
+  std::uint32_t column_sizes[4];  // sizeof of each column's type, zero if unused.
+  std::uint64_t size;             // number of elements.
+};
+
+template <class... Columns>
+SnapshotHeader makeSnapshotHeader(const std::size_t size) {
+  static_assert(sizeof...(Columns) <= 4, "Too many columns.");
+  static_assert((std::is_trivially_copyable_v<Columns> && ...),
+                "Only trivially copyable types can be saved.");
+
+  SnapshotHeader header{};
+  std::memcpy(header.magic, SnapshotHeader::expected_magic, sizeof(header.magic));
+  header.version = SnapshotHeader::current_version;
+  header.n_columns = sizeof...(Columns);
+  std::uint32_t sizes[] = {static_cast<std::uint32_t>(sizeof(Columns))...};
+  std::memcpy(header.column_sizes, sizes, sizeof(sizes));
+  header.size = size;
+  return header;
+}
+
+// Reads the header and checks that it describes a snapshot of elements of type Columns.
+template <class... Columns>
+std::size_t readSnapshotHeader(std::istream& in) {
+  SnapshotHeader header;
+  in.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!in)
+    throw(std::runtime_error("Snapshot stream ended prematurely."));
+
+  const SnapshotHeader expected = makeSnapshotHeader<Columns...>(header.size);
+  if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)))
+    throw(std::runtime_error("Not a snapshot stream."));
+  if (header.version != expected.version)
+    throw(std::runtime_error("Unsupported snapshot version."));
+  if (header.n_columns != expected.n_columns ||
+      std::memcmp(header.column_sizes, expected.column_sizes, sizeof(header.column_sizes)))
+    throw(std::runtime_error("Snapshot was saved with different types."));
+
+  return header.size;
+}
+
+template <class T>
+void writeColumn(std::ostream& out, const std::vector<T>& column) {
+  out.write(reinterpret_cast<const char*>(column.data()), column.size() * sizeof(T));
+}
+
+// The size comes from the untrusted header: the column is read in chunks of bounded size, so that
+// a corrupted size fails on the short read instead of attempting a huge allocation.
+template <class T>
+std::vector<T> readColumn(std::istream& in, const std::size_t size) {
+  constexpr std::size_t chunk = std::max<std::size_t>(1, (std::size_t(1) << 20) / sizeof(T));
+  std::vector<T> column;
+  while (column.size() < size) {
+    const std::size_t offset = column.size();
+    const std::size_t n = std::min(chunk, size - offset);
+    column.resize(offset + n);
+    in.read(reinterpret_cast<char*>(column.data() + offset), n * sizeof(T));
+    if (!in)
+      throw(std::runtime_error("Snapshot stream ended prematurely."));
+  }
+  return column;
+}
+
+}  // namespace details
+}  // namespace maplib
@@ -0,0 +1,110 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Counters of the work performed by the containers, to tune them for a given workload.
+// The counting is a policy, chosen by the `Stats` template parameter of each container:
+// CountingStatistics counts the work, while NoStatistics, the default, is an empty base class whose
+// counters are no-ops and compile to nothing.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+namespace maplib {
+
+struct OperationCounters {
+  std::size_t comparisons = 0;        // key comparisons.
+  std::size_t descended_nodes = 0;    // nodes visited while descending from the root.
+  std::size_t rotations = 0;          // left and right rotations.
+  std::size_t max_fix_depth = 0;      // deepest recursion of the double black fix after erasure.
+  std::size_t pool_allocations = 0;   // memory pools requested by the allocator.
+  std::size_t undone_insertions = 0;  // insertions of a present key, undoing the subtree updates.
+  std::size_t undone_erasures = 0;    // erasures of a missing key, undoing the subtree updates.
+};
+
+class NoStatistics {
+public:
+  constexpr static bool enabled = false;
+
+  void countComparison() noexcept {}
+  void countDescent() noexcept {}
+  void countRotation() noexcept {}
+  void countFixDepth(std::size_t) noexcept {}
+  void countUndoneInsertion() noexcept {}
+  void countUndoneErasure() noexcept {}
+
+  OperationCounters counters() const noexcept {
+    return {};
+  }
+  std::size_t poolsSinceReset(std::size_t) const noexcept {
+    return 0;
+  }
+  void reset(std::size_t = 0) noexcept {}
+  void clearPoolBaseline() noexcept {}
+  void merge(const NoStatistics&) noexcept {}
+};
+
+class CountingStatistics {
+public:
+  constexpr static bool enabled = true;
+
+  void countComparison() noexcept {
+    ++counters_.comparisons;
+  }
+  void countDescent() noexcept {
+    ++counters_.descended_nodes;
+  }
+  void countRotation() noexcept {
+    ++counters_.rotations;
+  }
+  void countFixDepth(std::size_t depth) noexcept {
+    counters_.max_fix_depth = std::max(counters_.max_fix_depth, depth);
+  }
+  void countUndoneInsertion() noexcept {
+    ++counters_.undone_insertions;
+  }
+  void countUndoneErasure() noexcept {
+    ++counters_.undone_erasures;
+  }
+
+  OperationCounters counters() const noexcept {
+    return counters_;
+  }
+  // Pools allocated since the last reset, given the current `pool_count` of the allocator.
+  std::size_t poolsSinceReset(std::size_t pool_count) const noexcept {
+    return pool_count - std::min(pool_count, pools_at_reset_);
+  }
+  // `pool_count` is the number of pools held by the allocator at the time of the reset.
+  void reset(std::size_t pool_count = 0) noexcept {
+    counters_ = OperationCounters();
+    pools_at_reset_ = pool_count;
+  }
+  // Counts every pool of the allocator as new, after it has been replaced.
+  void clearPoolBaseline() noexcept {
+    pools_at_reset_ = 0;
+  }
+
+  // Adds the work counted by `rhs`, e.g. by a worker thread.
+  void merge(const CountingStatistics& rhs) noexcept {
+    const OperationCounters& other = rhs.counters_;
+    counters_.comparisons += other.comparisons;
+    counters_.descended_nodes += other.descended_nodes;
+    counters_.rotations += other.rotations;
+    counters_.max_fix_depth = std::max(counters_.max_fix_depth, other.max_fix_depth);
+    counters_.pool_allocations += other.pool_allocations;
+    counters_.undone_insertions += other.undone_insertions;
+    counters_.undone_erasures += other.undone_erasures;
+  }
+
+private:
+  OperationCounters counters_;
+  std::size_t pools_at_reset_ = 0;
+};
+
+}  // namespace maplib
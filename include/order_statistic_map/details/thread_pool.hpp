@@ -0,0 +1,144 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Process wide pool of worker threads, used by the parallel algorithms of the containers.
+// Workers are started on demand and reused by the following calls, so that a parallel call does
+// not pay for the creation of its threads.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace maplib {
+namespace details {
+
+class ThreadPool {
+public:
+  ThreadPool() = default;
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // Instance shared by the whole process.
+  static ThreadPool& instance() {
+    static ThreadPool pool;
+    return pool;
+  }
+
+  // Runs `task(id)` for each id in [0, n_tasks), the first on the calling thread and the others on
+  // the workers, and waits for all of them. If tasks throw, the first exception is rethrown once
+  // every task is complete.
+  void run(unsigned n_tasks, const std::function<void(unsigned)>& task);
+
+  std::size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return workers_.size();
+  }
+
+private:
+  // Completion of the tasks of a call to run.
+  struct Batch {
+    std::mutex mutex;
+    std::condition_variable done;
+    unsigned remaining;
+    std::exception_ptr error;
+
+    void finish(std::exception_ptr task_error) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (task_error && !error)
+        error = task_error;
+      if (--remaining == 0)
+        done.notify_one();
+    }
+  };
+
+  void workerLoop();
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  std::deque<std::function<void()>> queue_;
+  std::vector<std::thread> workers_;
+  bool stop_ = false;
+};
+
+inline ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (auto& worker : workers_)
+    worker.join();
+}
+
+inline void ThreadPool::run(const unsigned n_tasks, const std::function<void(unsigned)>& task) {
+  if (n_tasks == 0)
+    return;
+
+  Batch batch;
+  batch.remaining = n_tasks;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (workers_.size() < n_tasks - 1)
+      workers_.emplace_back([this] { workerLoop(); });
+    for (unsigned id = 1; id < n_tasks; ++id) {
+      queue_.emplace_back([&batch, &task, id] {
+        std::exception_ptr error;
+        try {
+          task(id);
+        }
+        catch (...) {
+          error = std::current_exception();
+        }
+        batch.finish(error);
+      });
+    }
+  }
+  wake_.notify_all();
+
+  std::exception_ptr error;
+  try {
+    task(0);
+  }
+  catch (...) {
+    error = std::current_exception();
+  }
+  batch.finish(error);
+
+  std::unique_lock<std::mutex> lock(batch.mutex);
+  batch.done.wait(lock, [&] { return batch.remaining == 0; });
+  if (batch.error)
+    std::rethrow_exception(batch.error);
+}
+
+inline void ThreadPool::workerLoop() {
+  while (true) {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [&] { return stop_ || !queue_.empty(); });
+      if (queue_.empty())  // Stopped.
+        return;
+      job = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    job();
+  }
+}
+
+}  // namespace details
+}  // namespace maplib
@@ -10,42 +10,202 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include "augmented_data.hpp"
 #include "color.hpp"
 
 namespace maplib {
 namespace details {
 
-template <class _Key, class _Value, class _Weight>
-struct WeightedNode {
+// Size of the subtree, stored only by ranked nodes.
+template <bool ranked>
+struct SubtreeSize {};
+template <>
+struct SubtreeSize<true> {
+  std::size_t subtree_size = 1;
+};
+
+// Pending factor of the weights of the descendants, stored only by nodes with floating point
+// weights, as integer weights cannot be scaled.
+template <class Weight, bool scalable = std::is_floating_point_v<Weight>>
+struct PendingScale {};
+template <class Weight>
+struct PendingScale<Weight, true> {
+  Weight scale = 1;
+};
+
+template <class _Key, class _Value, class _Weight, bool _ranked = false, class _Augmentation = void>
+struct WeightedNode : SubtreeSize<_ranked>, PendingScale<_Weight>, AugmentedData<_Augmentation> {
   using Key = _Key;
   using Value = _Value;
   using Weight = _Weight;
+  using Augmentation = _Augmentation;
+  constexpr static bool ranked = _ranked;
+  constexpr static bool augmented = !std::is_void_v<Augmentation>;
+  constexpr static bool scalable = std::is_floating_point_v<Weight>;
+
+  // Number of containers of this node type that might hold a pending scale. While it is zero, the
+  // stored weights are exact and the ancestors of a node need not be visited.
+  inline static std::atomic<std::size_t> scaled_trees{0};
 
   WeightedNode(const Key& k, const Value& v, const Weight w, WeightedNode* p)
-      : parent(p), weight(w), subtree_weight(w), data(k, v) {}
+      : AugmentedData<Augmentation>(k, v, w), parent(p), weight(w), subtree_weight(w), data(k, v) {}
 
   void updateSubtreeWeight();
-  void swapMetadata(WeightedNode& rhs) {}
+  void swapMetadata(WeightedNode& rhs) {
+    std::swap(subtree_weight, rhs.subtree_weight);
+    if constexpr (scalable)
+      std::swap(this->scale, rhs.scale);
+    if constexpr (ranked)
+      std::swap(this->subtree_size, rhs.subtree_size);
+    if constexpr (augmented)
+      std::swap(this->aggregate, rhs.aggregate);
+  }
+  // Removes the node itself from its subtree weight, size and aggregate, before it is unlinked.
+  void excludeSelf();
+
+  // Multiplies the weight of every node in the subtree by `factor`. Only this node is updated, and
+  // the factor is recorded in `scale` for the descendants.
+  void scaleSubtree(Weight factor);
+  // Applies the pending scale to the children.
+  void pushDown();
+  // Applies the pending scales from the root down to this node, included. Afterwards the stored
+  // weights of the node, of its children and of its ancestors are exact.
+  void pushDownFromRoot();
+  // Returns the product of the pending scales of the ancestors, i.e. the factor between the stored
+  // and the actual weights of this node.
+  Weight ancestorsScale() const;
+  // Applies the pending scales from the ancestor `top` down to this node, included.
+  void pushDownFrom(const WeightedNode* top);
+  // Returns the pending scale of the descendants, 1 for integer weights.
+  Weight pendingScale() const noexcept {
+    if constexpr (scalable)
+      return this->scale;
+    else
+      return 1;
+  }
 
   WeightedNode* left = nullptr;
   WeightedNode* right = nullptr;
   WeightedNode* parent = nullptr;
 
   Weight weight;
-  Weight subtree_weight;
+  Weight subtree_weight;  // Stored weight plus the children's subtree weights times `scale`.
 
   std::pair<Key, Value> data;
 
   Color color = RED;
 };
 
-template <class Key, class Value, class Weight>
-void WeightedNode<Key, Value, Weight>::updateSubtreeWeight() {
-  subtree_weight = weight;
+template <class Key, class Value, class Weight, bool ranked, class Augmentation>
+void WeightedNode<Key, Value, Weight, ranked, Augmentation>::updateSubtreeWeight() {
+  Weight children_weight = 0;
   if (left)
-    subtree_weight += left->subtree_weight;
+    children_weight += left->subtree_weight;
   if (right)
-    subtree_weight += right->subtree_weight;
+    children_weight += right->subtree_weight;
+
+  if constexpr (scalable)
+    subtree_weight = weight + this->scale * children_weight;
+  else
+    subtree_weight = weight + children_weight;
+
+  if constexpr (ranked) {
+    this->subtree_size = 1;
+    if (left)
+      this->subtree_size += left->subtree_size;
+    if (right)
+      this->subtree_size += right->subtree_size;
+  }
+
+  if constexpr (augmented) {  // Children's aggregates are relative to the pending scale.
+    this->aggregate = Augmentation::make(data.first, data.second, weight);
+    if (left)
+      this->aggregate = Augmentation::combine(
+          scaleAggregate<Augmentation>(left->aggregate, pendingScale()), this->aggregate);
+    if (right)
+      this->aggregate = Augmentation::combine(
+          this->aggregate, scaleAggregate<Augmentation>(right->aggregate, pendingScale()));
+  }
+}
+
+template <class Key, class Value, class Weight, bool ranked, class Augmentation>
+void WeightedNode<Key, Value, Weight, ranked, Augmentation>::excludeSelf() {
+  weight = 0;
+  updateSubtreeWeight();
+  if constexpr (ranked)
+    --this->subtree_size;
+
+  if constexpr (augmented) {
+    this->aggregate = Augmentation::identity();
+    if (left)
+      this->aggregate = scaleAggregate<Augmentation>(left->aggregate, pendingScale());
+    if (right)
+      this->aggregate = Augmentation::combine(
+          this->aggregate, scaleAggregate<Augmentation>(right->aggregate, pendingScale()));
+  }
+}
+
+template <class Key, class Value, class Weight, bool ranked, class Augmentation>
+void WeightedNode<Key, Value, Weight, ranked, Augmentation>::scaleSubtree(const Weight factor) {
+  static_assert(scalable, "Only floating point weights can be scaled.");
+  weight *= factor;
+  subtree_weight *= factor;
+  this->scale *= factor;
+  if constexpr (augmented)
+    this->aggregate = scaleAggregate<Augmentation>(this->aggregate, factor);
+}
+
+template <class Key, class Value, class Weight, bool ranked, class Augmentation>
+void WeightedNode<Key, Value, Weight, ranked, Augmentation>::pushDown() {
+  if constexpr (scalable) {
+    if (this->scale == 1)
+      return;
+    if (left)
+      left->scaleSubtree(this->scale);
+    if (right)
+      right->scaleSubtree(this->scale);
+    this->scale = 1;
+  }
+}
+
+template <class Key, class Value, class Weight, bool ranked, class Augmentation>
+void WeightedNode<Key, Value, Weight, ranked, Augmentation>::pushDownFromRoot() {
+  if constexpr (scalable) {
+    if (scaled_trees.load(std::memory_order_relaxed) == 0)
+      return;
+    // Usually no scale is pending: find the highest one first, without recursion.
+    const WeightedNode* top = nullptr;
+    for (const WeightedNode* node = this; node; node = node->parent) {
+      if (node->scale != 1)
+        top = node;
+    }
+    if (top)
+      pushDownFrom(top);
+  }
+}
+
+template <class Key, class Value, class Weight, bool ranked, class Augmentation>
+void WeightedNode<Key, Value, Weight, ranked, Augmentation>::pushDownFrom(const WeightedNode* top) {
+  if (this != top)
+    parent->pushDownFrom(top);
+  pushDown();
+}
+
+template <class Key, class Value, class Weight, bool ranked, class Augmentation>
+Weight WeightedNode<Key, Value, Weight, ranked, Augmentation>::ancestorsScale() const {
+  Weight result = 1;
+  if constexpr (scalable) {
+    if (scaled_trees.load(std::memory_order_relaxed) == 0)
+      return result;
+    for (const WeightedNode* ancestor = parent; ancestor; ancestor = ancestor->parent)
+      result *= ancestor->scale;
+  }
+  return result;
 }
 
 }  // namespace details
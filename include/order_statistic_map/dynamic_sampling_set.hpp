@@ -0,0 +1,335 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Provides a weighted set with O(1) expected insertion, removal, weight update and sampling.
+// Keys are grouped in buckets of weights within a factor two, i.e. [2^e, 2^(e+1)). A sample picks a
+// bucket proportionally to its total weight with a linear scan, then an entry of the bucket by
+// rejection, accepted with probability at least 1/2.
+// The cost of the scan grows with the number of distinct magnitudes of the weights, not with the
+// number of keys. Emptied buckets are recycled. Unlike SamplingSet the keys are not ordered.
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace maplib {
+
+// Precondition: Key is hashable with Hash.
+template <class Key, class Weight, class Hash = std::hash<Key>>
+class DynamicSamplingSet {
+public:
+  DynamicSamplingSet() = default;
+  DynamicSamplingSet(const std::initializer_list<std::pair<Key, Weight>>& list);
+
+  // Insert new key. Returns false if the key is already present.
+  bool insert(const Key& key, const Weight& weight);
+  bool insert(const std::pair<Key, Weight>& values) {
+    return insert(values.first, values.second);
+  }
+
+  // Remove the key.
+  // Returns: true if the key is found and removed. False if no operation is performed.
+  bool erase(const Key& key);
+
+  // Changes the weight of key. Returns false if the key is not present.
+  bool setWeight(const Key& key, Weight weight);
+
+  // Returns the weight of key.
+  // Throws std::out_of_range if the key is not present.
+  Weight getWeight(const Key& key) const;
+
+  // Returns true if a stored key compares equal to the argument.
+  bool contains(const Key& key) const {
+    return index_.count(key);
+  }
+  bool count(const Key& key) const {
+    return contains(key);
+  }
+
+  // Returns a key sampled with probability proportional to its weight.
+  // Throws std::out_of_range if all the weights are zero.
+  template <class Rng>
+  const Key& sample(Rng& rng) const;
+
+  std::size_t size() const noexcept {
+    return index_.size();
+  }
+
+  // Floating point totals are updated incrementally and can differ from the exact sum of the
+  // weights by rounding errors.
+  Weight totalWeight() const noexcept {
+    return total_;
+  }
+
+  // For testing purposes.
+  bool checkConsistency() const noexcept;
+
+private:
+  struct Entry {
+    Key key;
+    Weight weight;
+  };
+
+  // Weights of the entries are in [2^exponent, 2^(exponent + 1)), or zero for zero_exponent.
+  constexpr static int zero_exponent = std::numeric_limits<int>::min();
+
+  struct Bucket {
+    std::vector<Entry> entries;
+    Weight total = 0;
+    int exponent = zero_exponent;
+  };
+
+  struct Location {
+    std::size_t bucket;
+    std::size_t position;
+  };
+
+  static int exponentOf(Weight weight);
+  // Returns the bucket of `weight`, creating it if needed. Zero weights share a bucket that is never
+  // sampled.
+  std::size_t bucketIndex(Weight weight);
+  void add(const Key& key, Weight weight, Location& location);
+  // Removes the entry, and recycles its bucket if emptied.
+  void remove(const Location& location);
+
+  std::vector<Bucket> buckets_;
+  std::vector<std::size_t> free_buckets_;  // Emptied buckets, to be reused.
+  std::unordered_map<int, std::size_t> bucket_of_exponent_;
+  std::unordered_map<Key, Location, Hash> index_;
+  Weight total_ = 0;
+  std::size_t n_positive_ = 0;  // Number of entries with non-zero weight.
+};
+
+template <class Key, class Weight, class Hash>
+DynamicSamplingSet<Key, Weight, Hash>::DynamicSamplingSet(
+    const std::initializer_list<std::pair<Key, Weight>>& list) {
+  for (const auto& elem : list)
+    insert(elem);
+}
+
+template <class Key, class Weight, class Hash>
+bool DynamicSamplingSet<Key, Weight, Hash>::insert(const Key& key, const Weight& weight) {
+  if (weight < 0)
+    throw(std::invalid_argument("Negative weight."));
+
+  auto [it, inserted] = index_.try_emplace(key);
+  if (!inserted)
+    return false;
+
+  add(key, weight, it->second);
+  return true;
+}
+
+template <class Key, class Weight, class Hash>
+bool DynamicSamplingSet<Key, Weight, Hash>::erase(const Key& key) {
+  auto it = index_.find(key);
+  if (it == index_.end())
+    return false;
+
+  remove(it->second);
+  index_.erase(it);
+  return true;
+}
+
+template <class Key, class Weight, class Hash>
+bool DynamicSamplingSet<Key, Weight, Hash>::setWeight(const Key& key, Weight weight) {
+  if (weight < 0)
+    throw(std::invalid_argument("Negative weight."));
+
+  auto it = index_.find(key);
+  if (it == index_.end())
+    return false;
+
+  Location& location = it->second;
+  const std::size_t new_bucket = bucketIndex(weight);  // Can reallocate the buckets.
+  Bucket& bucket = buckets_[location.bucket];
+  Entry& entry = bucket.entries[location.position];
+
+  if (new_bucket == location.bucket) {  // Update in place.
+    bucket.total += weight - entry.weight;
+    total_ += weight - entry.weight;
+    entry.weight = weight;
+  }
+  else {
+    remove(location);
+    add(key, weight, location);
+  }
+  return true;
+}
+
+template <class Key, class Weight, class Hash>
+Weight DynamicSamplingSet<Key, Weight, Hash>::getWeight(const Key& key) const {
+  const Location& location = index_.at(key);
+  return buckets_[location.bucket].entries[location.position].weight;
+}
+
+template <class Key, class Weight, class Hash>
+template <class Rng>
+const Key& DynamicSamplingSet<Key, Weight, Hash>::sample(Rng& rng) const {
+  if (!n_positive_ || !(total_ > 0))
+    throw(std::out_of_range("Sampling out of the set range."));
+
+  // Select a bucket proportionally to its total weight.
+  const double position = std::uniform_real_distribution<double>(0, total_)(rng);
+  const Bucket* selected = nullptr;
+  double on_the_left = 0;
+  for (const auto& bucket : buckets_) {
+    if (bucket.exponent == zero_exponent || bucket.entries.empty())  // Zero weight or recycled.
+      continue;
+    selected = &bucket;  // Due to rounding errors the position could be past the last bucket.
+    on_the_left += bucket.total;
+    if (position < on_the_left)
+      break;
+  }
+  if (!selected)
+    throw(std::out_of_range("Sampling out of the set range."));
+
+  // Rejection sampling within the bucket, on the weights divided by 2^exponent, in [1, 2), to
+  // avoid an overflow of the upper bound. Each trial succeeds with probability above 1/2.
+  std::uniform_int_distribution<std::size_t> pick(0, selected->entries.size() - 1);
+  std::uniform_real_distribution<double> accept(0, 2);
+  while (true) {
+    const Entry& entry = selected->entries[pick(rng)];
+    if (accept(rng) < std::ldexp(static_cast<double>(entry.weight), -selected->exponent))
+      return entry.key;
+  }
+}
+
+template <class Key, class Weight, class Hash>
+int DynamicSamplingSet<Key, Weight, Hash>::exponentOf(const Weight weight) {
+  if (!(weight > 0))
+    return zero_exponent;
+
+  if constexpr (std::is_floating_point_v<Weight>) {
+    return std::ilogb(weight);
+  }
+  else {
+    static_assert(std::is_integral_v<Weight>, "Weight needs to be floating or integer.");
+    int exponent = -1;
+    for (auto w = weight; w; w >>= 1)
+      ++exponent;
+    return exponent;
+  }
+}
+
+template <class Key, class Weight, class Hash>
+std::size_t DynamicSamplingSet<Key, Weight, Hash>::bucketIndex(const Weight weight) {
+  const int exponent = exponentOf(weight);
+  const std::size_t new_index = free_buckets_.empty() ? buckets_.size() : free_buckets_.back();
+
+  auto [it, inserted] = bucket_of_exponent_.try_emplace(exponent, new_index);
+  if (inserted) {
+    if (new_index == buckets_.size())
+      buckets_.emplace_back();
+    else
+      free_buckets_.pop_back();
+    buckets_[new_index].exponent = exponent;
+  }
+  return it->second;
+}
+
+template <class Key, class Weight, class Hash>
+void DynamicSamplingSet<Key, Weight, Hash>::add(const Key& key, const Weight weight,
+                                                Location& location) {
+  location.bucket = bucketIndex(weight);
+  Bucket& bucket = buckets_[location.bucket];
+  location.position = bucket.entries.size();
+  bucket.entries.push_back(Entry{key, weight});
+  bucket.total += weight;
+  total_ += weight;
+  if (weight > 0)
+    ++n_positive_;
+}
+
+template <class Key, class Weight, class Hash>
+void DynamicSamplingSet<Key, Weight, Hash>::remove(const Location& location) {
+  Bucket& bucket = buckets_[location.bucket];
+  const Weight weight = bucket.entries[location.position].weight;
+
+  // Move the last entry of the bucket into the hole.
+  if (location.position != bucket.entries.size() - 1) {
+    bucket.entries[location.position] = std::move(bucket.entries.back());
+    index_.find(bucket.entries[location.position].key)->second.position = location.position;
+  }
+  bucket.entries.pop_back();
+
+  bucket.total -= weight;
+  total_ -= weight;
+  if (weight > 0)
+    --n_positive_;
+
+  // Reset the rounding errors when possible. When a bucket is emptied, the total is summed again
+  // from the buckets, as the cancellation with a large removed weight can lose all its digits.
+  if (bucket.entries.empty()) {
+    bucket.total = 0;
+    bucket_of_exponent_.erase(bucket.exponent);
+    free_buckets_.push_back(location.bucket);
+
+    total_ = 0;
+    for (const auto& b : buckets_)
+      total_ += b.total;
+  }
+  if (!n_positive_)  // Every sampled bucket is empty.
+    total_ = 0;
+}
+
+template <class Key, class Weight, class Hash>
+bool DynamicSamplingSet<Key, Weight, Hash>::checkConsistency() const noexcept {
+  // The incremental totals accumulate rounding errors.
+  auto similar = [](double a, double b) {
+    if constexpr (std::is_floating_point_v<Weight>)
+      return std::abs(a - b) <= std::sqrt(std::numeric_limits<Weight>::epsilon()) * (1 + b);
+    else
+      return a == b;
+  };
+
+  std::size_t n_entries = 0;
+  double total = 0;
+
+  if (bucket_of_exponent_.size() + free_buckets_.size() != buckets_.size())
+    return false;
+  for (const auto& [exponent, b] : bucket_of_exponent_) {
+    if (b >= buckets_.size() || buckets_[b].exponent != exponent || buckets_[b].entries.empty())
+      return false;
+  }
+
+  std::size_t n_positive = 0;
+  for (std::size_t b = 0; b < buckets_.size(); ++b) {
+    const Bucket& bucket = buckets_[b];
+    double bucket_total = 0;
+    for (std::size_t i = 0; i < bucket.entries.size(); ++i) {
+      const Entry& entry = bucket.entries[i];
+      const auto it = index_.find(entry.key);
+      if (it == index_.end() || it->second.bucket != b || it->second.position != i)
+        return false;
+      if (exponentOf(entry.weight) != bucket.exponent)  // Wrong bucket.
+        return false;
+      bucket_total += entry.weight;
+      n_positive += entry.weight > 0;
+    }
+
+    if (!similar(bucket.total, bucket_total))
+      return false;
+    total += bucket_total;
+    n_entries += bucket.entries.size();
+  }
+
+  return n_entries == index_.size() && n_positive == n_positive_ && similar(total_, total);
+}
+
+}  // namespace maplib
@@ -0,0 +1,25 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Hint on the outcome of an insertion or erasure, selecting how the subtree metadata is updated.
+
+#pragma once
+
+namespace maplib {
+
+enum class Expect {
+  // The key is expected to be inserted or erased. The subtree metadata is updated during the
+  // descent, and restored with a second pass if the key turns out to be present (insertion) or
+  // missing (erasure).
+  CHANGE,
+  // The key is expected to be present for an insertion, or missing for an erasure. The key is
+  // looked up first, and the path to the root is updated with a second pass only on a change.
+  NO_CHANGE
+};
+
+}  // namespace maplib
@@ -84,13 +84,17 @@ public:
   }
 
   // Grant access of the node to the container.
-  template <class K, class V, std::size_t s>
+  template <class K, class V, std::size_t s, class St>
   friend class OrderStatisticMap;
+  template <class K, class V>
+  friend class PersistentOrderStatisticMap;
   // Grant access to the const or non-const version.
   template <class N, bool c>
   friend class MapIterator;
   template <class N, bool c>
   friend class SamplingMapIterator;
+  template <class N, bool c>
+  friend class MultiSamplingMapIterator;
 
 private:
   Conditional<const Node*, Node*> node_ = nullptr;
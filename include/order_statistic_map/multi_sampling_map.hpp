@@ -0,0 +1,509 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Provides a map with O(log n) insertion, removal and weighted sampling, where each entry has a
+// fixed number of weights, or channels. Each sample selects the channel defining its distribution,
+// so that several distributions over the same population share a single tree, instead of one
+// SamplingMap per distribution holding copies of the keys and values.
+// Implemented as an augmented red-black tree.
+
+#pragma once
+
+#include <cassert>
+#include <cmath>
+#include <functional>
+#include <initializer_list>
+#include <limits>
+#include <stack>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "multi_sampling_map_iterator.hpp"
+#include "details/compare.hpp"
+#include "details/fixed_size_allocator.hpp"
+#include "details/multi_weighted_node.hpp"
+#include "details/node_operations.hpp"
+#include "details/random_position.hpp"
+#include "details/statistics.hpp"
+
+namespace maplib {
+
+// Precondition: elements of type Key have full order. channels > 0.
+template <class Key, class Value, class Weight, std::size_t channels, std::size_t chunk_size = 64,
+          class Stats = NoStatistics>
+class MultiSamplingMap : private Stats {
+public:
+  using Node = details::MultiWeightedNode<Key, Value, Weight, channels>;
+  using Weights = typename Node::Weights;
+  using const_iterator = MultiSamplingMapIterator<Node, true>;
+  using iterator = MultiSamplingMapIterator<Node, false>;
+  using statistics_type = Stats;
+
+  static_assert(channels > 0, "At least one channel is required.");
+
+  MultiSamplingMap() = default;
+  MultiSamplingMap(const std::initializer_list<std::tuple<Key, Value, Weights>>& list);
+
+  MultiSamplingMap(const MultiSamplingMap& rhs);
+  MultiSamplingMap(MultiSamplingMap&& rhs);
+
+  MultiSamplingMap& operator=(const MultiSamplingMap& rhs);
+  MultiSamplingMap& operator=(MultiSamplingMap&& rhs);
+
+  ~MultiSamplingMap();
+
+  auto begin() const noexcept -> const_iterator;
+  auto end() const noexcept -> const_iterator {
+    return const_iterator(nullptr);
+  }
+
+  auto begin() noexcept -> iterator;
+  auto end() noexcept -> iterator {
+    return iterator(nullptr);
+  }
+
+  // Insert new key, value pair with a weight per channel if key is not already present, and
+  // returns an iterator to the node and true.
+  // If the key is already present, update the value and returns an iterator to the node and false.
+  // The weights of an existing key are unchanged, see the iterator method `setWeights`.
+  auto insert(const Key& key, const Value& value, const Weights& weights) noexcept
+      -> std::pair<iterator, bool>;
+  auto insert(const std::tuple<Key, Value, Weights>& values) noexcept {
+    return insert(std::get<0>(values), std::get<1>(values), std::get<2>(values));
+  }
+
+  // Remove the node relative to key.
+  // Returns: true if the key is found and removed. False if no operation is performed.
+  bool erase(const Key& key) noexcept;
+
+  // Remove the node.
+  // Precondition: the node is in the map.
+  void erase(iterator it);
+
+  // Returns the iterator associated with key.
+  // If the key is not in the map, returns a null iterator.
+  auto findByKey(const Key& key) const noexcept -> const_iterator;
+  auto findByKey(const Key& key) noexcept -> iterator;
+
+  // Returns true if a stored key compares equal to the argument.
+  bool contains(const Key& key) const noexcept {
+    return static_cast<bool>(findByKey(key));
+  }
+  bool count(const Key& key) const noexcept {
+    return contains(key);
+  }
+
+  // Returns an iterator relative to a node sampled with probability proportional to its weight in
+  // `channel`. The validity of `channel` is tested only in debug mode.
+  template <class Rng>
+  auto sample(Rng& rng, std::size_t channel) const noexcept -> const_iterator;
+  template <class Rng>
+  auto sample(Rng& rng, std::size_t channel) noexcept -> iterator;
+
+  // Same as SamplingMap::sample(position), with the weights of `channel`.
+  auto sample(Weight position, std::size_t channel) const noexcept -> const_iterator;
+  auto sample(Weight position, std::size_t channel) noexcept -> iterator;
+
+  // Sample from a value scaled in [0, 1].
+  auto sampleScaled(double position, std::size_t channel) const noexcept -> const_iterator {
+    return sample(position * totalWeight(channel), channel);
+  }
+  auto sampleScaled(double position, std::size_t channel) noexcept -> iterator {
+    return sample(position * totalWeight(channel), channel);
+  }
+
+  std::size_t size() const noexcept {
+    return size_;
+  }
+
+  Weight totalWeight(std::size_t channel) const noexcept {
+    assert(channel < channels);
+    return root_ ? root_->subtree_weight[channel] : 0;
+  }
+  Weights totalWeights() const noexcept {
+    return root_ ? root_->subtree_weight : Weights{};
+  }
+
+  // Counters of the work performed since construction or the last reset. All counters are zero
+  // with the default NoStatistics policy.
+  OperationCounters stats() const noexcept;
+  void resetStats() noexcept {
+    statistics().reset(allocator_.poolCount());
+  }
+
+  // For testing purposes.
+  bool checkConsistency() const noexcept;
+
+private:
+  constexpr static auto BLACK = details::BLACK;
+  constexpr static auto RED = details::RED;
+
+  void eraseNode(Node* to_delete);
+
+  // Returns the node at `position` of the cumulative weight of `channel`.
+  Node* findPosition(Weight position, std::size_t channel) const;
+
+  // The statistics policy is a base class, so that NoStatistics takes no space.
+  Stats& statistics() const noexcept {
+    return const_cast<MultiSamplingMap&>(*this);
+  }
+
+  // Members
+  Node* root_ = nullptr;
+  std::size_t size_ = 0;
+  FixedSizeAllocator<Node, chunk_size> allocator_;
+};
+
+template <class Key, class Value, class Weight, std::size_t channels, std::size_t chunk_size,
+          class Stats>
+MultiSamplingMap<Key, Value, Weight, channels, chunk_size, Stats>::MultiSamplingMap(
+    const std::initializer_list<std::tuple<Key, Value, Weights>>& list) {
+  for (const auto& elem : list)
+    insert(elem);
+}
+
+template <class Key, class Value, class Weight, std::size_t channels, std::size_t chunk_size,
+          class Stats>
+MultiSamplingMap<Key, Value, Weight, channels, chunk_size, Stats>::~MultiSamplingMap() {
+  std::stack<Node*> to_delete;
+  if (root_)
+    to_delete.push(root_);
+
+  while (!to_delete.empty()) {
+    auto node = to_delete.top();
+    to_delete.pop();
+
+    if (node->left)
+      to_delete.push(node->left);
+    if (node->right)
+      to_delete.push(node->right);
+
+    allocator_.destroy(node);
+  }
+}
+
+template <class Key, class Value, class Weight, std::size_t channels, std::size_t chunk_size,
+          class Stats>
+MultiSamplingMap<Key, Value, Weight, channels, chunk_size, Stats>::MultiSamplingMap(
+    const MultiSamplingMap& rhs) {
+  (*this) = rhs;
+}
+
+template <class Key, class Value, class Weight, std::size_t channels, std::size_t chunk_size,
+          class Stats>
+MultiSamplingMap<Key, Value, Weight, channels, chunk_size, Stats>::MultiSamplingMap(
+    MultiSamplingMap&& rhs) {
+  (*this) = std::move(rhs);
+}
+
+template <class Key, class Value, class Weight, std::size_t channels, std::size_t chunk_size,
+          class Stats>
+auto MultiSamplingMap<Key, Value, Weight, channels, chunk_size, Stats>::operator=(
+    const MultiSamplingMap& rhs) -> MultiSamplingMap& {
+  if (this != &rhs) {
+    *this = std::move(MultiSamplingMap());  // clear content.
+
+    for (auto it = rhs.begin(); it != rhs.end(); ++it)
+      insert(it->first, it->second, it.getWeights());
+  }
+  return *this;
+}
+
+template <class Key, class Value, class Weight, std::size_t channels, std::size_t chunk_size,
+          class Stats>
+auto MultiSamplingMap<Key, Value, Weight, channels, chunk_size, Stats>::operator=(
+    MultiSamplingMap&& rhs) -> MultiSamplingMap& {
+  std::swap(root_, rhs.root_);
+  std::swap(size_, rhs.size_);
+  std::swap(allocator_, rhs.allocator_);
+  std::swap(statistics(), rhs.statistics());
+  return *this;
+}
+
+template <class Key, class Value, class Weight, std::size_t channels, std::size_t chunk_size,
+          class Stats>
+auto MultiSamplingMap<Key, Value, Weight, channels, chunk_size, Stats>::insert(
+    const Key& key, const Value& val, const Weights& weights) noexcept
+    -> std::pair<iterator, bool> {
+  if (!root_) {
+    root_ = allocator_.create(key, val, weights, nullptr);
+    root_->color = BLACK;
+    ++size_;
+    return {iterator(root_), true};
+  }
+
+  // Look up the key, or its parent if missing, then update all the channels of the ancestors.
+  Node* node = root_;
+  while (true) {
+    statistics().countDescent();
+    statistics().countComparison();
+    const int comp = details::compare(key, get_key(node));
+
+    if (comp == 0) {
+      node->data.second = val;
+      return {iterator(node), false};
+    }
+
+    Node*& child = comp < 0 ? node->left : node->right;
+    if (!child) {
+      child = allocator_.create(key, val, weights, node);
+      node = child;
+      break;
+    }
+    node = child;
+  }
+
+  for (Node* ancestor = node->parent; ancestor; ancestor = ancestor->parent)
+    details::addWeights(ancestor->subtree_weight, weights);
+
+  details::fixRedRed(node, root_, statistics());
+  ++size_;
+  return {iterator(node), true};
+}
+
+template <class Key, class Value, class Weight, std::size_t channels, std::size_t chunk_size,
+          class Stats>
+bool MultiSamplingMap<Key, Value, Weight, channels, chunk_size, Stats>::erase(
+    const Key& key) noexcept {
+  Node* const to_delete = findByKey(key).node_;
+  if (!to_delete)
+    return false;
+
+  eraseNode(to_delete);
+  return true;
+}
+
+template <class Key, class Value, class Weight, std::size_t channels, std::size_t chunk_size,
+          class Stats>
+void MultiSamplingMap<Key, Value, Weight, channels, chunk_size, Stats>::erase(const iterator it) {
+  eraseNode(it.node_);
+}
+
+template <class Key, class Value, class Weight, std::size_t channels, std::size_t chunk_size,
+          class Stats>
+void MultiSamplingMap<Key, Value, Weight, channels, chunk_size, Stats>::eraseNode(Node* to_delete) {
+  const Weights removed_weights = to_delete->weight;
+
+  // A node with two children is swapped with its successor, which is then the removed position.
+  Node* successor = nullptr;
+  if (to_delete->left != nullptr && to_delete->right != nullptr) {
+    successor = to_delete->right;
+    while (successor->left) {
+      statistics().countDescent();
+      successor = successor->left;
+    }
+    swap(to_delete, successor, root_);
+  }
+
+  // The removed node keeps null weights until it is unlinked, as it is still visited by the
+  // rotations. The positions below the successor lose its weights, the ones above the removed one.
+  Node* ancestor = to_delete;
+  if (successor) {
+    for (; ancestor != successor; ancestor = ancestor->parent)
+      details::subtractWeights(ancestor->subtree_weight, successor->weight);
+  }
+  for (; ancestor; ancestor = ancestor->parent)
+    details::subtractWeights(ancestor->subtree_weight, removed_weights);
+  to_delete->weight.fill(0);
+
+  removeNoDoubleChild(to_delete, root_, statistics());
+
+  --size_;
+  allocator_.destroy(to_delete);
+}
+
+template <class Key, class Value, class Weight, std::size_t channels, std::size_t chunk_size,
+          class Stats>
+auto MultiSamplingMap<Key, Value, Weight, channels, chunk_size, Stats>::findByKey(
+    const Key& key) noexcept -> iterator {
+  Node* node = root_;
+  while (node) {
+    statistics().countDescent();
+    statistics().countComparison();
+    const int comp = details::compare(key, get_key(node));
+
+    if (comp == 0)
+      return iterator(node);
+    else if (comp < 0)
+      node = node->left;
+    else
+      node = node->right;
+  }
+
+  // Key not found.
+  return iterator(nullptr);
+}
+
+template <class Key, class Value, class Weight, std::size_t channels, std::size_t chunk_size,
+          class Stats>
+auto MultiSamplingMap<Key, Value, Weight, channels, chunk_size, Stats>::findByKey(
+    const Key& key) const noexcept -> const_iterator {
+  return const_iterator(const_cast<MultiSamplingMap&>(*this).findByKey(key));
+}
+
+template <class Key, class Value, class Weight, std::size_t channels, std::size_t chunk_size,
+          class Stats>
+template <class Rng>
+auto MultiSamplingMap<Key, Value, Weight, channels, chunk_size, Stats>::sample(
+    Rng& rng, const std::size_t channel) noexcept -> iterator {
+  return sample(details::randomPosition(rng, totalWeight(channel)), channel);
+}
+
+template <class Key, class Value, class Weight, std::size_t channels, std::size_t chunk_size,
+          class Stats>
+template <class Rng>
+auto MultiSamplingMap<Key, Value, Weight, channels, chunk_size, Stats>::sample(
+    Rng& rng, const std::size_t channel) const noexcept -> const_iterator {
+  return const_cast<MultiSamplingMap&>(*this).sample(rng, channel);
+}
+
+template <class Key, class Value, class Weight, std::size_t channels, std::size_t chunk_size,
+          class Stats>
+auto MultiSamplingMap<Key, Value, Weight, channels, chunk_size, Stats>::sample(
+    const Weight position, const std::size_t channel) noexcept -> iterator {
+  const auto total = totalWeight(channel);
+  if (!total || position < 0 || position > total ||
+      (std::is_integral_v<Weight> && position == total)) {  // Out of range.
+    return iterator(nullptr);
+  }
+
+  return iterator(findPosition(position, channel));
+}
+
+template <class Key, class Value, class Weight, std::size_t channels, std::size_t chunk_size,
+          class Stats>
+auto MultiSamplingMap<Key, Value, Weight, channels, chunk_size, Stats>::sample(
+    const Weight position, const std::size_t channel) const noexcept -> const_iterator {
+  return const_cast<MultiSamplingMap&>(*this).sample(position, channel);
+}
+
+template <class Key, class Value, class Weight, std::size_t channels, std::size_t chunk_size,
+          class Stats>
+auto MultiSamplingMap<Key, Value, Weight, channels, chunk_size, Stats>::findPosition(
+    Weight position, const std::size_t channel) const -> Node* {
+  Node* node = root_;
+  Weight on_the_left(0);
+
+  while (true) {
+    assert(node);
+    statistics().countDescent();
+
+    const Weight own_weight = node->weight[channel];
+    auto new_on_the_left = on_the_left;
+    if (node->left)
+      new_on_the_left += node->left->subtree_weight[channel];
+
+    if (position >= new_on_the_left && position < new_on_the_left + own_weight) {
+      return node;
+    }
+    else if (position < new_on_the_left) {  // go left
+      node = node->left;
+    }
+    else {  // go right
+      if constexpr (std::is_floating_point_v<Weight>) {
+        if (!node->right)  // Due to numerical issues the sample could be right at the edge.
+          return node;
+      }
+
+      on_the_left = new_on_the_left + own_weight;
+      node = node->right;
+    }
+  }
+}
+
+template <class Key, class Value, class Weight, std::size_t channels, std::size_t chunk_size,
+          class Stats>
+OperationCounters MultiSamplingMap<Key, Value, Weight, channels, chunk_size, Stats>::stats()
+    const noexcept {
+  OperationCounters counters = statistics().counters();
+  counters.pool_allocations = statistics().poolsSinceReset(allocator_.poolCount());
+  return counters;
+}
+
+template <class Key, class Value, class Weight, std::size_t channels, std::size_t chunk_size,
+          class Stats>
+bool MultiSamplingMap<Key, Value, Weight, channels, chunk_size, Stats>::checkConsistency()
+    const noexcept {
+  bool child_parent_violation = false;
+  bool red_red_violation = false;
+  bool black_count_violation = false;
+  bool subtree_weight_violation = false;
+
+  auto similar = [](Weight a, Weight b) {
+    if constexpr (std::is_floating_point_v<Weight>)
+      return std::abs(a - b) <= std::numeric_limits<Weight>::epsilon() * 100 * (1 + std::abs(b));
+    else
+      return a == b;
+  };
+
+  // Returns the subtree weights, and checks the node consistency.
+  std::function<Weights(const Node*)> check_weights = [&](const Node* node) -> Weights {
+    Weights result{};
+    if (!node)
+      return result;
+
+    if ((node->left && node->left->parent != node) || (node->right && node->right->parent != node))
+      child_parent_violation = true;
+
+    result = node->weight;
+    details::addWeights(result, check_weights(node->left));
+    details::addWeights(result, check_weights(node->right));
+    for (std::size_t c = 0; c < channels; ++c) {
+      if (!similar(node->subtree_weight[c], result[c]))
+        subtree_weight_violation = true;
+    }
+    return result;
+  };
+
+  // Returns number of black nodes in [node, leaves].
+  std::function<int(const Node*)> check_colors = [&](const Node* node) {
+    if (node == nullptr)
+      return 1;
+
+    auto color = [&](const Node* n) { return n ? n->color : BLACK; };
+    if (node->color == RED && (color(node->left) == RED || color(node->right) == RED))
+      red_red_violation = true;
+
+    const int count_left = check_colors(node->left);
+    const int count_right = check_colors(node->right);
+    if (count_left != count_right)
+      black_count_violation = true;
+
+    return count_left + (node->color == BLACK ? 1 : 0);
+  };
+
+  check_weights(root_);
+  check_colors(root_);
+
+  return !black_count_violation && !red_red_violation && !child_parent_violation &&
+         !subtree_weight_violation;
+}
+
+template <class Key, class Value, class Weight, std::size_t channels, std::size_t chunk_size,
+          class Stats>
+auto MultiSamplingMap<Key, Value, Weight, channels, chunk_size, Stats>::begin() noexcept
+    -> iterator {
+  if (!root_)
+    return iterator{nullptr};
+
+  Node* node = root_;
+  while (node->left)
+    node = node->left;
+
+  return iterator(node);
+}
+
+template <class Key, class Value, class Weight, std::size_t channels, std::size_t chunk_size,
+          class Stats>
+auto MultiSamplingMap<Key, Value, Weight, channels, chunk_size, Stats>::begin() const noexcept
+    -> const_iterator {
+  return const_cast<MultiSamplingMap&>(*this).begin();
+}
+
+}  // namespace maplib
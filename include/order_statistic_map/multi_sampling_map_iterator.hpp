@@ -0,0 +1,70 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Bidirectional iterator for the multi channel sampling map class.
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <stdexcept>
+
+#include "map_iterator.hpp"
+#include "details/multi_weighted_node.hpp"
+
+namespace maplib {
+
+template <class Node, bool is_const>
+class MultiSamplingMapIterator final : public MapIterator<Node, is_const> {
+public:
+  using Base = MapIterator<Node, is_const>;
+  using Weight = typename Node::Weight;
+  using Weights = typename Node::Weights;
+
+  MultiSamplingMapIterator(std::conditional_t<is_const, const Node*, Node*> node = nullptr)
+      : Base(node) {}
+
+  template <bool other_c>
+  MultiSamplingMapIterator(const MultiSamplingMapIterator<Node, other_c>& rhs) : Base(rhs) {}
+
+  // The validity of `channel` is tested only in debug mode.
+  Weight getWeight(std::size_t channel) const {
+    assert(channel < Node::channels);
+    return node_->weight[channel];
+  }
+  const Weights& getWeights() const {
+    return node_->weight;
+  }
+
+  // Changes the weight of a single channel. Complexity: O(log n).
+  void setWeight(std::size_t channel, const Weight weight) {
+    assert(channel < Node::channels);
+    const Weight diff = weight - node_->weight[channel];
+    node_->weight[channel] = weight;
+    for (auto ancestor = node_; ancestor; ancestor = ancestor->parent)
+      ancestor->subtree_weight[channel] += diff;
+  }
+
+  // Changes the weights of all the channels, in a single pass over the path to the root.
+  // Complexity: O(log n).
+  void setWeights(const Weights& weights) {
+    Weights diff = weights;
+    details::subtractWeights(diff, node_->weight);
+    node_->weight = weights;
+    for (auto ancestor = node_; ancestor; ancestor = ancestor->parent)
+      details::addWeights(ancestor->subtree_weight, diff);
+  }
+
+  template <class K, class V, class W, std::size_t n, std::size_t s, class St>
+  friend class MultiSamplingMap;
+
+private:
+  using Base::node_;
+};
+
+}  // namespace maplib
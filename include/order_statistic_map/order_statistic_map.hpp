@@ -20,24 +20,29 @@
 #include <stdexcept>
 #include <vector>
 
+#include "expect.hpp"
 #include "map_iterator.hpp"
+#include "details/compaction.hpp"
 #include "details/compare.hpp"
 #include "details/fixed_size_allocator.hpp"
+#include "details/latency_tracer.hpp"
 #include "details/node.hpp"
 #include "details/node_operations.hpp"
+#include "details/statistics.hpp"
 
 namespace maplib {
 
-template <class Key, std::size_t chunk_size>
+template <class Key, std::size_t chunk_size, class Stats>
 class OrderStatisticSet;
 
 // Precondition: elements of type Key have full order.
-template <class Key, class Value, std::size_t chunk_size = 64>
-class OrderStatisticMap {
+template <class Key, class Value, std::size_t chunk_size = 64, class Stats = NoStatistics>
+class OrderStatisticMap : private Stats {
 public:
   using Node = details::Node<Key, Value>;
   using const_iterator = MapIterator<Node, true>;
   using iterator = MapIterator<Node, false>;
+  using statistics_type = Stats;
 
   OrderStatisticMap() = default;
   OrderStatisticMap(const std::initializer_list<std::pair<Key, Value>>& list);
@@ -60,14 +65,17 @@ public:
   // Insert new key, value pair if key is not already present, and returns an iterator to the node
   // and true.
   // If the key is already present, update the value and returns an iterator to the node and false.
-  auto insert(const Key& key, const Value& value) noexcept -> std::pair<iterator, bool>;
+  // `expect` selects the update strategy of the subtree sizes, see Expect.
+  auto insert(const Key& key, const Value& value, Expect expect = Expect::CHANGE) noexcept
+      -> std::pair<iterator, bool>;
   auto insert(const std::pair<Key, Value>& pair) noexcept {
     insert(pair.first, pair.second);
   }
 
   // Remove the node relative to key.
   // Returns: true if the key is found and removed. False if no operation is performed.
-  bool erase(const Key& key) noexcept;
+  // `expect` selects the update strategy of the subtree sizes, see Expect.
+  bool erase(const Key& key, Expect expect = Expect::CHANGE) noexcept;
 
   // Remove the node.
   // Precondition: the node is in the map.
@@ -97,37 +105,67 @@ public:
   // Returns an array of ordered keys and value pairs.
   std::vector<std::pair<Key, Value>> linearize() const noexcept;
 
+  // Moves all the nodes into fresh memory, in breadth first order, and releases the old pools.
+  // Restores the cache efficiency of a container aged by many insertions and removals.
+  // Invalidates all iterators.
+  void compact();
+
+  // Counters of the work performed since construction or the last reset. All counters are zero
+  // with the default NoStatistics policy.
+  OperationCounters stats() const noexcept;
+  void resetStats() noexcept {
+    statistics().reset(allocator_.poolCount());
+  }
+
+  // Records the latency of each operation into `tracer`, or stops recording if null.
+  // Has no effect unless MAPLIB_ENABLE_TRACING is defined.
+  void setTracer(LatencyTracer* tracer) noexcept {
+    tracer_ = tracer;
+  }
+
   // For testing purposes.
   bool checkConsistency() const noexcept;
   bool checkSize() const noexcept;
 
-  friend class OrderStatisticSet<Key, chunk_size>;
+  friend class OrderStatisticSet<Key, chunk_size, Stats>;
 
 private:
   constexpr static auto BLACK = details::BLACK;
   constexpr static auto RED = details::RED;
 
+  // Returns the node with `key`, or its parent if the key is missing, without modifications, and
+  // sets `comp` to the comparison of `key` with the returned node.
+  // Precondition: the map is not empty.
+  Node* lookup(const Key& key, int& comp) const noexcept;
+  void eraseNode(Node* to_delete);
+
+  // The statistics policy is a base class, so that NoStatistics takes no space.
+  Stats& statistics() const noexcept {
+    return const_cast<OrderStatisticMap&>(*this);
+  }
+
   // Members
   Node* root_ = nullptr;
   FixedSizeAllocator<Node, chunk_size> allocator_;
+  LatencyTracer* tracer_ = nullptr;
 };
 
-template <class Key, class Value, std::size_t chunk_size>
-OrderStatisticMap<Key, Value, chunk_size>::OrderStatisticMap(
+template <class Key, class Value, std::size_t chunk_size, class Stats>
+OrderStatisticMap<Key, Value, chunk_size, Stats>::OrderStatisticMap(
     const std::initializer_list<std::pair<Key, Value>>& list) {
   for (const auto& [key, val] : list)
     insert(key, val);
 }
 
-template <class Key, class Value, std::size_t chunk_size>
-OrderStatisticMap<Key, Value, chunk_size>::OrderStatisticMap(
+template <class Key, class Value, std::size_t chunk_size, class Stats>
+OrderStatisticMap<Key, Value, chunk_size, Stats>::OrderStatisticMap(
     const std::vector<std::pair<Key, Value>>& linearized) {
   for (const auto& p : linearized)
     insert(p);
 }
 
-template <class Key, class Value, std::size_t chunk_size>
-OrderStatisticMap<Key, Value, chunk_size>::~OrderStatisticMap() {
+template <class Key, class Value, std::size_t chunk_size, class Stats>
+OrderStatisticMap<Key, Value, chunk_size, Stats>::~OrderStatisticMap() {
   std::stack<Node*> to_delete;
   if (root_)
     to_delete.push(root_);
@@ -145,19 +183,19 @@ OrderStatisticMap<Key, Value, chunk_size>::~OrderStatisticMap() {
   }
 }
 
-template <class Key, class Value, std::size_t chunk_size>
-OrderStatisticMap<Key, Value, chunk_size>::OrderStatisticMap(const OrderStatisticMap& rhs) {
+template <class Key, class Value, std::size_t chunk_size, class Stats>
+OrderStatisticMap<Key, Value, chunk_size, Stats>::OrderStatisticMap(const OrderStatisticMap& rhs) {
   (*this) = rhs;
 }
 
-template <class Key, class Value, std::size_t chunk_size>
-OrderStatisticMap<Key, Value, chunk_size>::OrderStatisticMap(OrderStatisticMap&& rhs) {
+template <class Key, class Value, std::size_t chunk_size, class Stats>
+OrderStatisticMap<Key, Value, chunk_size, Stats>::OrderStatisticMap(OrderStatisticMap&& rhs) {
   (*this) = std::move(rhs);
 }
 
-template <class Key, class Value, std::size_t chunk_size>
-OrderStatisticMap<Key, Value, chunk_size>& OrderStatisticMap<Key, Value, chunk_size>::operator=(
-    const OrderStatisticMap<Key, Value, chunk_size>& rhs) {
+template <class Key, class Value, std::size_t chunk_size, class Stats>
+OrderStatisticMap<Key, Value, chunk_size, Stats>&
+OrderStatisticMap<Key, Value, chunk_size, Stats>::operator=(const OrderStatisticMap& rhs) {
   if (this != &rhs) {
     *this = std::move(OrderStatisticMap());  // clear content.
 
@@ -167,17 +205,21 @@ OrderStatisticMap<Key, Value, chunk_size>& OrderStatisticMap<Key, Value, chunk_s
   return *this;
 }
 
-template <class Key, class Value, std::size_t chunk_size>
-OrderStatisticMap<Key, Value, chunk_size>& OrderStatisticMap<Key, Value, chunk_size>::operator=(
-    OrderStatisticMap<Key, Value, chunk_size>&& rhs) {
+template <class Key, class Value, std::size_t chunk_size, class Stats>
+OrderStatisticMap<Key, Value, chunk_size, Stats>&
+OrderStatisticMap<Key, Value, chunk_size, Stats>::operator=(OrderStatisticMap&& rhs) {
   std::swap(root_, rhs.root_);
   std::swap(allocator_, rhs.allocator_);
+  std::swap(statistics(), rhs.statistics());
+  std::swap(tracer_, rhs.tracer_);
   return *this;
 }
 
-template <class Key, class Value, std::size_t chunk_size>
-auto OrderStatisticMap<Key, Value, chunk_size>::insert(const Key& key, const Value& val) noexcept
+template <class Key, class Value, std::size_t chunk_size, class Stats>
+auto OrderStatisticMap<Key, Value, chunk_size, Stats>::insert(const Key& key, const Value& val,
+                                                              const Expect expect) noexcept
     -> std::pair<iterator, bool> {
+  const details::Trace trace(tracer_, Operation::INSERT);
   if (!root_) {
     root_ = allocator_.create(key, val, nullptr);
     root_->color = BLACK;
@@ -186,10 +228,31 @@ auto OrderStatisticMap<Key, Value, chunk_size>::insert(const Key& key, const Val
 
   Node* node = root_;
 
+  if (expect == Expect::NO_CHANGE) {  // Look up first, then update the sizes if inserted.
+    int comp;
+    node = lookup(key, comp);
+    if (comp == 0) {
+      node->data.second = val;
+      return {iterator(node), false};
+    }
+
+    Node* const parent = node;
+    node = allocator_.create(key, val, parent);
+    (comp < 0 ? parent->left : parent->right) = node;
+    for (Node* ancestor = parent; ancestor; ancestor = ancestor->parent)
+      ++ancestor->subtree_size;
+
+    details::fixRedRed(node, root_, statistics());
+    return {iterator(node), true};
+  }
+
   while (true) {
+    statistics().countDescent();
+    statistics().countComparison();
     const int comp = details::compare(key, get_key(node));
 
     if (comp == 0) {  // Key is already present. Undo changes and return.
+      statistics().countUndoneInsertion();
       node->data.second = val;
       iterator return_it = iterator(node);
 
@@ -220,22 +283,36 @@ auto OrderStatisticMap<Key, Value, chunk_size>::insert(const Key& key, const Val
   }
 
   // Check colors
-  details::fixRedRed(node, root_);
+  details::fixRedRed(node, root_, statistics());
 
   //  assert(checkConsistency());
   return {iterator(node), true};
 }
 
-template <class Key, class Value, std::size_t chunk_size>
-bool OrderStatisticMap<Key, Value, chunk_size>::erase(const Key& key) noexcept {
+template <class Key, class Value, std::size_t chunk_size, class Stats>
+bool OrderStatisticMap<Key, Value, chunk_size, Stats>::erase(const Key& key,
+                                                             const Expect expect) noexcept {
+  const details::Trace trace(tracer_, Operation::ERASE);
   if (!root_)
     return false;
+
+  if (expect == Expect::NO_CHANGE) {  // Look up first, then update the sizes if found.
+    int comp;
+    Node* const node = lookup(key, comp);
+    if (comp != 0)
+      return false;
+    eraseNode(node);
+    return true;
+  }
+
   Node* to_delete = root_;
 
   // Search while updating subtree count.
   bool found = false;
 
   while (true) {
+    statistics().countDescent();
+    statistics().countComparison();
     --to_delete->subtree_size;
     const int comp = details::compare(key, get_key(to_delete));
 
@@ -256,6 +333,7 @@ bool OrderStatisticMap<Key, Value, chunk_size>::erase(const Key& key) noexcept {
   }
 
   if (!found) {  // undo change
+    statistics().countUndoneErasure();
     ++to_delete->subtree_size;
     while (to_delete->parent) {
       to_delete = to_delete->parent;
@@ -270,6 +348,7 @@ bool OrderStatisticMap<Key, Value, chunk_size>::erase(const Key& key) noexcept {
     to_delete = to_delete->right;
     --to_delete->subtree_size;
     while (to_delete->left) {
+      statistics().countDescent();
       to_delete = to_delete->left;
       --to_delete->subtree_size;
     }
@@ -278,20 +357,40 @@ bool OrderStatisticMap<Key, Value, chunk_size>::erase(const Key& key) noexcept {
     to_delete = original;
   }
 
-  details::removeNoDoubleChild(to_delete, root_);
+  details::removeNoDoubleChild(to_delete, root_, statistics());
   allocator_.destroy(to_delete);
 
   return true;
 }
 
-template <class Key, class Value, std::size_t chunk_size>
-void OrderStatisticMap<Key, Value, chunk_size>::erase(iterator it) {
-  Node* to_delete = it.node_;
+template <class Key, class Value, std::size_t chunk_size, class Stats>
+void OrderStatisticMap<Key, Value, chunk_size, Stats>::erase(iterator it) {
+  const details::Trace trace(tracer_, Operation::ERASE);
+  eraseNode(it.node_);
+}
+
+template <class Key, class Value, std::size_t chunk_size, class Stats>
+auto OrderStatisticMap<Key, Value, chunk_size, Stats>::lookup(const Key& key, int& comp) const
+    noexcept -> Node* {
+  Node* node = root_;
+  while (true) {
+    statistics().countDescent();
+    statistics().countComparison();
+    comp = details::compare(key, get_key(node));
+    Node* const next = comp < 0 ? node->left : node->right;
+    if (comp == 0 || !next)
+      return node;
+    node = next;
+  }
+}
 
+template <class Key, class Value, std::size_t chunk_size, class Stats>
+void OrderStatisticMap<Key, Value, chunk_size, Stats>::eraseNode(Node* to_delete) {
   if (to_delete->left != nullptr && to_delete->right != nullptr) {  // to_delete has two children.
     Node* const original = to_delete;
     to_delete = to_delete->right;
     while (to_delete->left) {
+      statistics().countDescent();
       to_delete = to_delete->left;
     }
 
@@ -299,19 +398,29 @@ void OrderStatisticMap<Key, Value, chunk_size>::erase(iterator it) {
     to_delete = original;
   }
 
-  // Update subtree counts.
-  Node* ancestor = to_delete->parent;
+  // Update subtree counts, including the removed node which is still visited by the rotations.
+  Node* ancestor = to_delete;
   while (ancestor) {
     --ancestor->subtree_size;
     ancestor = ancestor->parent;
   }
 
-  details::removeNoDoubleChild(to_delete, root_);
+  details::removeNoDoubleChild(to_delete, root_, statistics());
   allocator_.destroy(to_delete);
 }
 
-template <class Key, class Value, std::size_t chunk_size>
-auto OrderStatisticMap<Key, Value, chunk_size>::findByIndex(const std::size_t index) -> iterator {
+template <class Key, class Value, std::size_t chunk_size, class Stats>
+void OrderStatisticMap<Key, Value, chunk_size, Stats>::compact() {
+  FixedSizeAllocator<Node, chunk_size> new_allocator;
+  root_ = details::relocateBreadthFirst(root_, allocator_, new_allocator);
+  allocator_ = std::move(new_allocator);
+  statistics().clearPoolBaseline();
+}
+
+template <class Key, class Value, std::size_t chunk_size, class Stats>
+auto OrderStatisticMap<Key, Value, chunk_size, Stats>::findByIndex(const std::size_t index)
+    -> iterator {
+  const details::Trace trace(tracer_, Operation::FIND_BY_INDEX);
   if (index >= size())
     throw(std::out_of_range("Index out of range"));
 
@@ -320,6 +429,7 @@ auto OrderStatisticMap<Key, Value, chunk_size>::findByIndex(const std::size_t in
   std::size_t on_the_left = 0;
   while (true) {
     assert(node);
+    statistics().countDescent();
 
     auto new_on_the_left = on_the_left;
     if (node->left)
@@ -338,16 +448,20 @@ auto OrderStatisticMap<Key, Value, chunk_size>::findByIndex(const std::size_t in
   }
 }
 
-template <class Key, class Value, std::size_t chunk_size>
-auto OrderStatisticMap<Key, Value, chunk_size>::findByIndex(const std::size_t index) const
+template <class Key, class Value, std::size_t chunk_size, class Stats>
+auto OrderStatisticMap<Key, Value, chunk_size, Stats>::findByIndex(const std::size_t index) const
     -> const_iterator {
   return const_cast<OrderStatisticMap&>(*this).findByIndex(index);
 }
 
-template <class Key, class Value, std::size_t chunk_size>
-auto OrderStatisticMap<Key, Value, chunk_size>::findByKey(const Key& key) noexcept -> iterator {
+template <class Key, class Value, std::size_t chunk_size, class Stats>
+auto OrderStatisticMap<Key, Value, chunk_size, Stats>::findByKey(const Key& key) noexcept
+    -> iterator {
+  const details::Trace trace(tracer_, Operation::FIND);
   Node* node = root_;
   while (node) {
+    statistics().countDescent();
+    statistics().countComparison();
     const int comp = details::compare(key, get_key(node));
     if (comp == 0)
       return iterator(node);
@@ -361,19 +475,22 @@ auto OrderStatisticMap<Key, Value, chunk_size>::findByKey(const Key& key) noexce
   return iterator(nullptr);
 }
 
-template <class Key, class Value, std::size_t chunk_size>
-auto OrderStatisticMap<Key, Value, chunk_size>::findByKey(const Key& key) const noexcept
+template <class Key, class Value, std::size_t chunk_size, class Stats>
+auto OrderStatisticMap<Key, Value, chunk_size, Stats>::findByKey(const Key& key) const noexcept
     -> const_iterator {
   // Avoid code duplication with a cast to non-const (const iterator does not allow data modification).
   return const_iterator(const_cast<OrderStatisticMap&>(*this).findByKey(key));
 }
 
-template <class Key, class Value, std::size_t chunk_size>
-bool OrderStatisticMap<Key, Value, chunk_size>::contains(const Key& key) const noexcept {
+template <class Key, class Value, std::size_t chunk_size, class Stats>
+bool OrderStatisticMap<Key, Value, chunk_size, Stats>::contains(const Key& key) const noexcept {
+  const details::Trace trace(tracer_, Operation::FIND);
   const Node* node = root_;
 
   if constexpr (std::is_same_v<Key, std::string>) {
     while (node) {
+      statistics().countDescent();
+      statistics().countComparison();
       const int comp = details::compare(key, get_key(node));
       if (comp < 0)
         node = node->left;
@@ -386,6 +503,8 @@ bool OrderStatisticMap<Key, Value, chunk_size>::contains(const Key& key) const n
 
   else {  // Overhead of intermediate result can be significant in this small function.
     while (node) {
+      statistics().countDescent();
+      statistics().countComparison();
       if (get_key(node) == key)
         return true;
       else if (key < get_key(node))
@@ -398,8 +517,9 @@ bool OrderStatisticMap<Key, Value, chunk_size>::contains(const Key& key) const n
   return false;
 }
 
-template <class Key, class Value, std::size_t chunk_size>
-std::vector<std::pair<Key, Value>> OrderStatisticMap<Key, Value, chunk_size>::linearize() const noexcept {
+template <class Key, class Value, std::size_t chunk_size, class Stats>
+std::vector<std::pair<Key, Value>> OrderStatisticMap<Key, Value, chunk_size, Stats>::linearize() const
+    noexcept {
   std::vector<std::pair<Key, Value>> result;
   result.reserve(size());
 
@@ -419,8 +539,15 @@ std::vector<std::pair<Key, Value>> OrderStatisticMap<Key, Value, chunk_size>::li
   return result;
 }
 
-template <class Key, class Value, std::size_t chunk_size>
-bool OrderStatisticMap<Key, Value, chunk_size>::checkConsistency() const noexcept {
+template <class Key, class Value, std::size_t chunk_size, class Stats>
+OperationCounters OrderStatisticMap<Key, Value, chunk_size, Stats>::stats() const noexcept {
+  OperationCounters counters = statistics().counters();
+  counters.pool_allocations = statistics().poolsSinceReset(allocator_.poolCount());
+  return counters;
+}
+
+template <class Key, class Value, std::size_t chunk_size, class Stats>
+bool OrderStatisticMap<Key, Value, chunk_size, Stats>::checkConsistency() const noexcept {
   bool child_parent_violation = false;
   bool red_red_violation = false;
   bool black_count_violation = false;
@@ -469,8 +596,8 @@ bool OrderStatisticMap<Key, Value, chunk_size>::checkConsistency() const noexcep
          !subtree_size_violation;
 }
 
-template <class Key, class Value, std::size_t chunk_size>
-auto OrderStatisticMap<Key, Value, chunk_size>::begin() noexcept -> iterator {
+template <class Key, class Value, std::size_t chunk_size, class Stats>
+auto OrderStatisticMap<Key, Value, chunk_size, Stats>::begin() noexcept -> iterator {
   if (!root_)
     return iterator{nullptr};
 
@@ -481,18 +608,18 @@ auto OrderStatisticMap<Key, Value, chunk_size>::begin() noexcept -> iterator {
   return iterator(node);
 }
 
-template <class Key, class Value, std::size_t chunk_size>
-auto OrderStatisticMap<Key, Value, chunk_size>::end() noexcept -> iterator {
+template <class Key, class Value, std::size_t chunk_size, class Stats>
+auto OrderStatisticMap<Key, Value, chunk_size, Stats>::end() noexcept -> iterator {
   return iterator{nullptr};
 }
 
-template <class Key, class Value, std::size_t chunk_size>
-auto OrderStatisticMap<Key, Value, chunk_size>::begin() const noexcept -> const_iterator {
+template <class Key, class Value, std::size_t chunk_size, class Stats>
+auto OrderStatisticMap<Key, Value, chunk_size, Stats>::begin() const noexcept -> const_iterator {
   return const_cast<OrderStatisticMap&>(*this).begin();
 }
 
-template <class Key, class Value, std::size_t chunk_size>
-auto OrderStatisticMap<Key, Value, chunk_size>::end() const noexcept -> const_iterator {
+template <class Key, class Value, std::size_t chunk_size, class Stats>
+auto OrderStatisticMap<Key, Value, chunk_size, Stats>::end() const noexcept -> const_iterator {
   return iterator{nullptr};
 }
 
@@ -17,7 +17,7 @@
 namespace maplib {
 
 // Precondition: elements of type Key have full order.
-template <class Key, std::size_t chunk_size = 64>
+template <class Key, std::size_t chunk_size = 64, class Stats = NoStatistics>
 class OrderStatisticSet {
 private:
   struct Null {
@@ -28,6 +28,7 @@ public:
   using Node = details::Node<Key, Null>;
   using const_iterator = MapIterator<Node, true>;
   using iterator = MapIterator<Node, false>;
+  using statistics_type = Stats;
 
   OrderStatisticSet() = default;
   OrderStatisticSet(const std::initializer_list<Key>& list);
@@ -53,11 +54,13 @@ public:
   };
 
   // Insert new key. Returns false if the key is already present.
-  auto insert(const Key& key) noexcept -> std::pair<iterator, bool>;
+  // `expect` selects the update strategy of the subtree sizes, see Expect.
+  auto insert(const Key& key, Expect expect = Expect::CHANGE) noexcept
+      -> std::pair<iterator, bool>;
 
   // Remove the node relative to key. Returns true if the key was present.
   // Returns false and leave the container unchanged otherwise.
-  bool erase(const Key& key) noexcept;
+  bool erase(const Key& key, Expect expect = Expect::CHANGE) noexcept;
 
   // Returns true if the key is present.
   bool contains(const Key& key) const noexcept;
@@ -67,7 +70,7 @@ public:
 
   // Returns the "index"-th lowest key.
   // Precondition: 0 <= index < size()
-  const Key& findByIndex(const std::size_t index) const noexcept;
+  const Key& findByIndex(const std::size_t index) const;
 
   // Number of keys stored in the map.
   std::size_t size() const noexcept {
@@ -77,51 +80,71 @@ public:
   // Returns an array of ordered keys.
   std::vector<Key> linearize() const noexcept;
 
+  // Relocates the keys in contiguous memory. See OrderStatisticMap::compact.
+  void compact() {
+    map_.compact();
+  }
+
+  // Counters of the work performed. See OrderStatisticMap::stats.
+  OperationCounters stats() const noexcept {
+    return map_.stats();
+  }
+  void resetStats() noexcept {
+    map_.resetStats();
+  }
+
+  // Records the latency of each operation. See OrderStatisticMap::setTracer.
+  void setTracer(LatencyTracer* tracer) noexcept {
+    map_.setTracer(tracer);
+  }
+
   bool checkConsistency() const noexcept {
     return map_.checkConsistency();
   }
 
 private:
-  OrderStatisticMap<Key, Null, chunk_size> map_;
+  OrderStatisticMap<Key, Null, chunk_size, Stats> map_;
 };
 
-template <class Key, std::size_t chunk_size>
-OrderStatisticSet<Key, chunk_size>::OrderStatisticSet(const std::initializer_list<Key>& list) {
+template <class Key, std::size_t chunk_size, class Stats>
+OrderStatisticSet<Key, chunk_size, Stats>::OrderStatisticSet(
+    const std::initializer_list<Key>& list) {
   for (const auto& k : list)
     map_.insert(k, {});
 }
 
-template <class Key, std::size_t chunk_size>
-OrderStatisticSet<Key, chunk_size>::OrderStatisticSet(const std::vector<Key>& linearized) {
+template <class Key, std::size_t chunk_size, class Stats>
+OrderStatisticSet<Key, chunk_size, Stats>::OrderStatisticSet(const std::vector<Key>& linearized) {
   for (const auto& k : linearized)
     map_.insert(k, {});
 }
 
-template <class Key, std::size_t chunk_size>
-auto OrderStatisticSet<Key, chunk_size>::insert(const Key& key) noexcept
+template <class Key, std::size_t chunk_size, class Stats>
+auto OrderStatisticSet<Key, chunk_size, Stats>::insert(const Key& key, const Expect expect) noexcept
     -> std::pair<iterator, bool> {
-  return map_.insert(key, {});
+  return map_.insert(key, {}, expect);
 }
 
-template <class Key, std::size_t chunk_size>
-bool OrderStatisticSet<Key, chunk_size>::erase(const Key& key) noexcept {
-  return map_.erase(key);
+template <class Key, std::size_t chunk_size, class Stats>
+bool OrderStatisticSet<Key, chunk_size, Stats>::erase(const Key& key,
+                                                      const Expect expect) noexcept {
+  return map_.erase(key, expect);
 }
 
-template <class Key, std::size_t chunk_size>
-bool OrderStatisticSet<Key, chunk_size>::contains(const Key& key) const noexcept {
+template <class Key, std::size_t chunk_size, class Stats>
+bool OrderStatisticSet<Key, chunk_size, Stats>::contains(const Key& key) const noexcept {
   return map_.contains(key);
 }
 
-template <class Key, std::size_t chunk_size>
-const Key& OrderStatisticSet<Key, chunk_size>::findByIndex(const std::size_t index) const noexcept {
+template <class Key, std::size_t chunk_size, class Stats>
+const Key& OrderStatisticSet<Key, chunk_size, Stats>::findByIndex(const std::size_t index) const {
   auto it = map_.findByIndex(index);
   assert(it);
   return it->first;
 }
 
-template <class Key, std::size_t chunk_size>
-std::vector<Key> OrderStatisticSet<Key, chunk_size>::linearize() const noexcept {
+template <class Key, std::size_t chunk_size, class Stats>
+std::vector<Key> OrderStatisticSet<Key, chunk_size, Stats>::linearize() const noexcept {
   std::vector<Key> result;
   result.reserve(size());
 
@@ -0,0 +1,379 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Provides an OrderStatisticMap whose nodes are stored in a memory mapped file (POSIX only).
+// Nodes are linked through self-relative offsets, hence reopening the file gives immediate access
+// to the stored tree, without any rebuild.
+
+#pragma once
+
+#include <cassert>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+
+#include "map_iterator.hpp"
+#include "details/compare.hpp"
+#include "details/mapped_storage.hpp"
+#include "details/node_operations.hpp"
+#include "details/offset_node.hpp"
+
+namespace maplib {
+
+// Precondition: elements of type Key have full order. Key and Value are trivially copyable.
+template <class Key, class Value>
+class PersistentOrderStatisticMap {
+public:
+  using Node = details::OffsetNode<Key, Value>;
+  using const_iterator = MapIterator<Node, true>;
+  using iterator = MapIterator<Node, false>;
+
+  // Opens the map stored in `filename`, or creates an empty one with room for `initial_capacity`
+  // elements if the file does not exist. The file grows automatically.
+  // Throws std::system_error if the file can not be opened or mapped, and std::runtime_error if
+  // it does not contain a map of the same type.
+  PersistentOrderStatisticMap(const std::string& filename, std::size_t initial_capacity = 1024);
+
+  PersistentOrderStatisticMap(const PersistentOrderStatisticMap& rhs) = delete;
+  PersistentOrderStatisticMap& operator=(const PersistentOrderStatisticMap& rhs) = delete;
+
+  // Note: iterators are invalidated when an insertion grows the file.
+  auto begin() const noexcept -> const_iterator;
+  auto end() const noexcept -> const_iterator;
+
+  auto begin() noexcept -> iterator;
+  auto end() noexcept -> iterator;
+
+  // Insert new key, value pair if key is not already present, and returns an iterator to the node
+  // and true.
+  // If the key is already present, update the value and returns an iterator to the node and false.
+  auto insert(const Key& key, const Value& value) -> std::pair<iterator, bool>;
+  auto insert(const std::pair<Key, Value>& pair) {
+    return insert(pair.first, pair.second);
+  }
+
+  // Remove the node relative to key.
+  // Returns: true if the key is found and removed. False if no operation is performed.
+  bool erase(const Key& key) noexcept;
+
+  // Remove the node.
+  // Precondition: the node is in the map.
+  void erase(iterator it);
+
+  // Returns the iterator associated with key.
+  // If the key is not in the map, returns a null iterator.
+  auto findByKey(const Key& key) const noexcept -> const_iterator;
+  auto findByKey(const Key& key) noexcept -> iterator;
+
+  // Returns true if a stored key compares equal to the argument.
+  bool contains(const Key& key) const noexcept {
+    return static_cast<bool>(findByKey(key));
+  }
+  bool count(const Key& key) const noexcept {
+    return contains(key);
+  }
+
+  // Returns an iterator relative to the 'index'-th lowest key.
+  // Precondition: 0 <= index < size()
+  auto findByIndex(const std::size_t index) const -> const_iterator;
+  auto findByIndex(const std::size_t index) -> iterator;
+
+  // Number of keys stored in the map.
+  std::size_t size() const noexcept {
+    return root() ? root()->subtree_size : 0;
+  }
+
+  // Flushes the modified pages to the file with msync. Blocks until the write is complete.
+  void sync() {
+    storage_.sync();
+  }
+
+  // Returns an array of ordered keys and value pairs.
+  std::vector<std::pair<Key, Value>> linearize() const noexcept;
+
+  // For testing purposes.
+  bool checkConsistency() const noexcept;
+
+private:
+  constexpr static auto BLACK = details::BLACK;
+  constexpr static auto RED = details::RED;
+
+  struct Header {
+    details::OffsetPtr<Node> root;
+  };
+
+  static int openFile(const std::string& filename);
+
+  Node* root() const noexcept {
+    return const_cast<Header&>(storage_.header()).root;
+  }
+
+  // Members
+  details::MappedStorage<Node, Header> storage_;
+};
+
+template <class Key, class Value>
+PersistentOrderStatisticMap<Key, Value>::PersistentOrderStatisticMap(const std::string& filename,
+                                                                     std::size_t initial_capacity)
+    : storage_(openFile(filename), initial_capacity) {
+  static_assert(std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<Value>,
+                "Only trivially copyable types can be stored in a file.");
+}
+
+template <class Key, class Value>
+int PersistentOrderStatisticMap<Key, Value>::openFile(const std::string& filename) {
+  const int fd = open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0)
+    throw(std::system_error(errno, std::generic_category(), "open " + filename));
+  return fd;
+}
+
+template <class Key, class Value>
+auto PersistentOrderStatisticMap<Key, Value>::insert(const Key& key, const Value& val)
+    -> std::pair<iterator, bool> {
+  // Grow the file before any pointer into it is taken.
+  storage_.reserve(1);
+
+  Node* root = this->root();
+  if (!root) {
+    root = storage_.create(key, val, nullptr);
+    root->color = BLACK;
+    storage_.header().root = root;
+    return {iterator(root), true};
+  }
+
+  Node* node = root;
+
+  while (true) {
+    const int comp = details::compare(key, get_key(node));
+
+    if (comp == 0) {  // Key is already present. Undo changes and return.
+      node->data.second = val;
+      iterator return_it = iterator(node);
+
+      node = node->parent;
+      while (node) {
+        --node->subtree_size;
+        node = node->parent;
+      }
+
+      return {return_it, false};
+    }
+    ++node->subtree_size;
+
+    if (comp < 0) {
+      if (node->left == nullptr) {
+        node = node->left = storage_.create(key, val, node);
+        break;
+      }
+      node = node->left;
+    }
+    else {
+      if (node->right == nullptr) {
+        node = node->right = storage_.create(key, val, node);
+        break;
+      }
+      node = node->right;
+    }
+  }
+
+  // Check colors
+  details::fixRedRed(node, root);
+  storage_.header().root = root;
+
+  return {iterator(node), true};
+}
+
+template <class Key, class Value>
+bool PersistentOrderStatisticMap<Key, Value>::erase(const Key& key) noexcept {
+  iterator it = findByKey(key);
+  if (!it)
+    return false;
+
+  erase(it);
+  return true;
+}
+
+template <class Key, class Value>
+void PersistentOrderStatisticMap<Key, Value>::erase(iterator it) {
+  Node* to_delete = it.node_;
+  Node* root = this->root();
+
+  if (to_delete->left != nullptr && to_delete->right != nullptr) {  // to_delete has two children.
+    Node* const original = to_delete;
+    to_delete = to_delete->right;
+    while (to_delete->left) {
+      to_delete = to_delete->left;
+    }
+
+    details::swap(original, to_delete, root);
+    to_delete = original;
+  }
+
+  // Update subtree counts, including the removed node which is still visited by the rotations.
+  Node* ancestor = to_delete;
+  while (ancestor) {
+    --ancestor->subtree_size;
+    ancestor = ancestor->parent;
+  }
+
+  details::removeNoDoubleChild(to_delete, root);
+  storage_.destroy(to_delete);
+  storage_.header().root = root;
+}
+
+template <class Key, class Value>
+auto PersistentOrderStatisticMap<Key, Value>::findByIndex(const std::size_t index) -> iterator {
+  if (index >= size())
+    throw(std::out_of_range("Index out of range"));
+
+  Node* node = root();
+
+  std::size_t on_the_left = 0;
+  while (true) {
+    assert(node);
+
+    auto new_on_the_left = on_the_left;
+    if (node->left)
+      new_on_the_left += node->left->subtree_size;
+
+    if (new_on_the_left == index) {
+      return iterator(node);
+    }
+    else if (new_on_the_left > index) {  // go left
+      node = node->left;
+    }
+    else {  // go right
+      on_the_left = new_on_the_left + 1;
+      node = node->right;
+    }
+  }
+}
+
+template <class Key, class Value>
+auto PersistentOrderStatisticMap<Key, Value>::findByIndex(const std::size_t index) const
+    -> const_iterator {
+  return const_cast<PersistentOrderStatisticMap&>(*this).findByIndex(index);
+}
+
+template <class Key, class Value>
+auto PersistentOrderStatisticMap<Key, Value>::findByKey(const Key& key) noexcept -> iterator {
+  Node* node = root();
+  while (node) {
+    const int comp = details::compare(key, get_key(node));
+    if (comp == 0)
+      return iterator(node);
+    else if (comp < 0)
+      node = node->left;
+    else
+      node = node->right;
+  }
+
+  // Key not found.
+  return iterator(nullptr);
+}
+
+template <class Key, class Value>
+auto PersistentOrderStatisticMap<Key, Value>::findByKey(const Key& key) const noexcept
+    -> const_iterator {
+  return const_iterator(const_cast<PersistentOrderStatisticMap&>(*this).findByKey(key));
+}
+
+template <class Key, class Value>
+std::vector<std::pair<Key, Value>> PersistentOrderStatisticMap<Key, Value>::linearize() const
+    noexcept {
+  std::vector<std::pair<Key, Value>> result;
+  result.reserve(size());
+
+  for (const auto& it : *this)
+    result.emplace_back(it.first, it.second);
+
+  return result;
+}
+
+template <class Key, class Value>
+bool PersistentOrderStatisticMap<Key, Value>::checkConsistency() const noexcept {
+  bool child_parent_violation = false;
+  bool red_red_violation = false;
+  bool black_count_violation = false;
+  bool subtree_size_violation = false;
+
+  // Check node consistency and returns the number of black nodes in [node, leaves].
+  std::function<int(const Node*)> check = [&](const Node* node) {
+    if (node == nullptr)
+      return 1;
+
+    // Check parent-child relationship.
+    if (node->left && node->left->parent != node)
+      child_parent_violation = true;
+    if (node->right && node->right->parent != node)
+      child_parent_violation = true;
+
+    // Check subtree size
+    std::size_t expected_size = 1;
+    if (node->left)
+      expected_size += node->left->subtree_size;
+    if (node->right)
+      expected_size += node->right->subtree_size;
+    if (node->subtree_size != expected_size)
+      subtree_size_violation = true;
+
+    // Check double red
+    auto color = [&](const Node* n) { return n ? n->color : BLACK; };
+    if (node->color == RED && (color(node->left) == RED || color(node->right) == RED))
+      red_red_violation = true;
+
+    // Check black count
+    int count_left = check(node->left);
+    int count_right = check(node->right);
+
+    if (count_left != count_right)
+      black_count_violation = true;
+
+    return count_left + (node->color == BLACK ? 1 : 0);
+  };
+
+  check(root());
+
+  return !black_count_violation && !red_red_violation && !child_parent_violation &&
+         !subtree_size_violation;
+}
+
+template <class Key, class Value>
+auto PersistentOrderStatisticMap<Key, Value>::begin() noexcept -> iterator {
+  Node* node = root();
+  if (!node)
+    return iterator{nullptr};
+
+  while (node->left)
+    node = node->left;
+
+  return iterator(node);
+}
+
+template <class Key, class Value>
+auto PersistentOrderStatisticMap<Key, Value>::end() noexcept -> iterator {
+  return iterator{nullptr};
+}
+
+template <class Key, class Value>
+auto PersistentOrderStatisticMap<Key, Value>::begin() const noexcept -> const_iterator {
+  return const_cast<PersistentOrderStatisticMap&>(*this).begin();
+}
+
+template <class Key, class Value>
+auto PersistentOrderStatisticMap<Key, Value>::end() const noexcept -> const_iterator {
+  return iterator{nullptr};
+}
+
+}  // namespace maplib
@@ -13,29 +13,54 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <functional>
 #include <initializer_list>
+#include <istream>
+#include <ostream>
 #include <random>
 #include <stack>
 #include <stdexcept>
+#include <thread>
 #include <vector>
 #include <tuple>
 
+#include "alias_sampler.hpp"
+#include "augmentation.hpp"
+#include "expect.hpp"
 #include "sampling_map_iterator.hpp"
+#include "details/bulk_build.hpp"
+#include "details/compaction.hpp"
 #include "details/compare.hpp"
 #include "details/fixed_size_allocator.hpp"
+#include "details/latency_tracer.hpp"
 #include "details/node_operations.hpp"
+#include "details/node_table.hpp"
+#include "details/philox.hpp"
+#include "details/random_position.hpp"
+#include "details/serialization.hpp"
+#include "details/statistics.hpp"
+#include "details/thread_pool.hpp"
 #include "details/weighted_node.hpp"
 
 namespace maplib {
 
 // Precondition: elements of type Key have full order.
-template <class Key, class Value, class Weight, std::size_t chunk_size = 64>
-class SamplingMap {
+// If `ranked` is true, each node also stores the size of its subtree, enabling the access by index
+// and the sampling within a range of indices. See RankedSamplingMap.
+// If `Augmentation` is not void, each node also stores the aggregate of its subtree under the
+// policy, enabling the range and search queries on it. See augmentation.hpp.
+template <class Key, class Value, class Weight, std::size_t chunk_size = 64, bool ranked = false,
+          class Augmentation = void, class Stats = NoStatistics>
+class SamplingMap : private Stats {
 public:
-  using Node = details::WeightedNode<Key, Value, Weight>;
+  using Node = details::WeightedNode<Key, Value, Weight, ranked, Augmentation>;
   using const_iterator = SamplingMapIterator<Node, true>;
   using iterator = SamplingMapIterator<Node, false>;
+  using aggregate_type = typename details::AggregateType<Augmentation>::type;
+  using statistics_type = Stats;
 
   SamplingMap() = default;
   SamplingMap(const std::initializer_list<std::tuple<Key, Value, Weight>>& list);
@@ -58,25 +83,66 @@ public:
   // Insert new key, value pair if key is not already present, and returns an iterator to the node
   // and true.
   // If the key is already present, update the value and returns an iterator to the node and false.
-  auto insert(const Key& key, const Value& value, const Weight& weight) noexcept
-      -> std::pair<iterator, bool>;
+  // `expect` selects the update strategy of the subtree weights, see Expect.
+  auto insert(const Key& key, const Value& value, const Weight& weight,
+              Expect expect = Expect::CHANGE) noexcept -> std::pair<iterator, bool>;
   auto insert(const std::tuple<Key, Value, Weight>& values) noexcept {
     insert(std::get<0>(values), std::get<1>(values), std::get<2>(values));
   }
 
+  // Insert new key, value pair if key is not already present, otherwise replace both its value and
+  // its weight. Returns an iterator to the node, and true if the key was inserted.
+  // The key is looked up first, then the path to the root is updated in a single pass.
+  auto insertOrAssign(const Key& key, const Value& value, const Weight& weight) noexcept
+      -> std::pair<iterator, bool> {
+    return insertAfterLookup(key, value, weight, true);
+  }
+
   // Remove the node relative to key.
   // Returns: true if the key is found and removed. False if no operation is performed.
+  // The removed node and its successor are found in a single descent, and nothing is modified if
+  // the key is missing.
   bool erase(const Key& key) noexcept;
 
   // Remove the node.
   // Precondition: the node is in the map.
   void erase(iterator it);
 
+  // Changes the weights of many nodes, given a range of pairs of iterator and new weight.
+  // Complexity: O(min(m log n, n)). If the paths to the root of the m nodes cover most of the tree,
+  // all the subtree weights are recomputed exactly in a single bottom-up pass.
+  // Precondition: the iterators are valid and not null.
+  template <class InputIt>
+  void setWeights(InputIt first, InputIt last);
+
+  // Same as setWeights, with a range of pairs of key and new weight. Keys not in the map are
+  // ignored. Returns the number of updated entries.
+  template <class InputIt>
+  std::size_t setWeightsByKey(InputIt first, InputIt last);
+
+  // Multiplies all the weights by `factor`. Complexity: O(1).
+  // The factor is stored as a pending scale of the root, and applied lazily to the nodes below by
+  // the operations descending the tree.
+  // Precondition: Weight is a floating point type, the augmentation, if any, provides `scale`, and
+  // factor >= 0.
+  void scaleAll(Weight factor);
+
+  // Multiplies the weights of the keys in [key_lo, key_hi) by `factor`. Complexity: O(log n).
+  // The subtrees entirely in the range are scaled lazily, as in scaleAll.
+  // Precondition: same as scaleAll.
+  void scaleRange(const Key& key_lo, const Key& key_hi, Weight factor);
+
   // Returns the iterator associated with key.
   // If the key is not in the map, returns a null iterator.
   auto findByKey(const Key& key) const noexcept -> const_iterator;
   auto findByKey(const Key& key) noexcept -> iterator;
 
+  // Returns an iterator to the key-value pair at position `index` in the sorted order.
+  // Throws std::out_of_range if index >= size().
+  // Precondition: the map is ranked. The inverse is the iterator method `position()`.
+  auto findByIndex(std::size_t index) const -> const_iterator;
+  auto findByIndex(std::size_t index) -> iterator;
+
   // Returns true if a stored key compares equal to the argument.
   bool contains(const Key& key) const noexcept;
   bool count(const Key& key) const noexcept {
@@ -97,6 +163,107 @@ public:
   auto sample(Weight position) const noexcept -> const_iterator;
   auto sample(Weight position) noexcept -> iterator;
 
+  // Same as writing `sample(position)` for each position in [first, last), but resolves all of them
+  // in a single traversal of the tree.
+  // Precondition: the positions are sorted in ascending order.
+  template <class PositionIt, class OutputIt>
+  OutputIt sample(PositionIt first, PositionIt last, OutputIt out) const;
+  template <class PositionIt, class OutputIt>
+  OutputIt sample(PositionIt first, PositionIt last, OutputIt out);
+
+  // Returns an iterator relative to a node with key in [key_lo, key_hi), sampled with probability
+  // proportional to its weight. Returns the null iterator if the range has no weight.
+  // Complexity: O(log n), without allocations.
+  template <class Rng>
+  auto sampleInRange(Rng& rng, const Key& key_lo, const Key& key_hi) const -> const_iterator;
+  template <class Rng>
+  auto sampleInRange(Rng& rng, const Key& key_lo, const Key& key_hi) -> iterator;
+
+  // Returns an iterator relative to a node with index in [first, last), sampled with probability
+  // proportional to its weight. Returns the null iterator if the range has no weight.
+  // Complexity: O(log n). Throws std::out_of_range if first > last or last > size().
+  // Precondition: the map is ranked.
+  template <class Rng>
+  auto sampleInIndexRange(Rng& rng, std::size_t first, std::size_t last) const -> const_iterator;
+  template <class Rng>
+  auto sampleInIndexRange(Rng& rng, std::size_t first, std::size_t last) -> iterator;
+
+  // Writes `k` iterators relative to nodes sampled independently with probability proportional to
+  // their weight. The samples are written in ascending key order.
+  // Complexity: O(k + k log(n / k)) for k < n, as the sorted positions are generated in O(k).
+  template <class Rng, class OutputIt>
+  OutputIt sampleBatch(Rng& rng, std::size_t k, OutputIt out) const;
+  template <class Rng, class OutputIt>
+  OutputIt sampleBatch(Rng& rng, std::size_t k, OutputIt out);
+
+  // Writes `k` iterators relative to nodes sampled independently with probability proportional to
+  // their weight, using `n_threads` threads. The i-th sample is a function of `seed` and i only,
+  // through a counter based generator, hence the output is identical for any number of threads.
+  // Each thread resolves its share of the samples with a single traversal. The threads are taken
+  // from a process wide pool, started by the first call and reused afterwards.
+  // Requires linking with the system thread library.
+  template <class OutputIt>
+  OutputIt parallelSample(std::size_t k, std::uint64_t seed, OutputIt out,
+                          unsigned n_threads = std::thread::hardware_concurrency()) const;
+  template <class OutputIt>
+  OutputIt parallelSample(std::size_t k, std::uint64_t seed, OutputIt out,
+                          unsigned n_threads = std::thread::hardware_concurrency());
+
+  // Writes iterators relative to `k` distinct nodes, each sampled with probability proportional to
+  // its weight among the nodes not yet sampled. The samples are written in the order they are
+  // drawn. Stops early if all the entries with non-zero weight have been sampled.
+  // The removed weights are tracked in a side table, and the container is left unchanged.
+  // Complexity: O(k log n).
+  template <class Rng, class OutputIt>
+  OutputIt sampleWithoutReplacement(Rng& rng, std::size_t k, OutputIt out) const;
+  template <class Rng, class OutputIt>
+  OutputIt sampleWithoutReplacement(Rng& rng, std::size_t k, OutputIt out);
+
+  // Returns the summed weight of the entries with key lower than `key`, which does not need to be
+  // in the map. Complexity: O(log n).
+  Weight cumulativeWeight(const Key& key) const noexcept;
+  // Returns the summed weight of the entries before `it`, or the total weight for the end
+  // iterator. Complexity: O(log n).
+  Weight cumulativeWeight(const_iterator it) const {
+    return it ? it.cumulativeWeight() : totalWeight();
+  }
+  Weight cumulativeWeight(iterator it) const {
+    return cumulativeWeight(const_iterator(it));
+  }
+
+  // Returns the summed weight of the entries with key in [key_lo, key_hi). The subtrees entirely
+  // in the range are summed once, rather than subtracting two cumulative weights.
+  // Complexity: O(log n).
+  Weight weightBetween(const Key& key_lo, const Key& key_hi) const noexcept;
+
+  // Returns the aggregate of all the entries, or of the entries with key in [key_lo, key_hi), in
+  // key order. Complexity: O(1) and O(log n) respectively.
+  // Precondition: the map is augmented.
+  aggregate_type aggregate() const;
+  aggregate_type aggregate(const Key& key_lo, const Key& key_hi) const;
+
+  // Returns an iterator to the first entry, in key order, such that `pred` is true for the
+  // aggregate of the entries from the beginning up to and including it. The second version only
+  // considers the entries with key not lower than key_lo. Returns the null iterator if there is
+  // no such entry.
+  // Complexity: O(log n) evaluations of `pred`.
+  // Precondition: the map is augmented, and `pred` is monotone: once true for an aggregate, it
+  // stays true for any aggregate extending it on the right.
+  template <class Pred>
+  auto findFirst(Pred&& pred) const -> const_iterator;
+  template <class Pred>
+  auto findFirst(Pred&& pred) -> iterator;
+  template <class Pred>
+  auto findFirst(const Key& key_lo, Pred&& pred) const -> const_iterator;
+  template <class Pred>
+  auto findFirst(const Key& key_lo, Pred&& pred) -> iterator;
+
+  // Returns an alias table over the current entries, sampling an iterator in O(1).
+  // The sampler is a snapshot: it is invalidated by any insertion, removal or weight change, and
+  // must be rebuilt explicitly. Complexity: O(n).
+  AliasSampler<const_iterator> buildStaticSampler() const;
+  AliasSampler<iterator> buildStaticSampler();
+
   // Sample from a value scaled in [0, 1].
   auto sampleScaled(double position) const noexcept -> const_iterator {
     return sample(position * totalWeight());
@@ -108,6 +275,19 @@ public:
   // Returns an array of ordered keys and value pairs.
   std::vector<std::tuple<Key, Value, Weight>> linearize() const noexcept;
 
+  // Writes the content to a versioned binary stream, with one contiguous array per column.
+  // Precondition: Key, Value and Weight are trivially copyable.
+  void save(std::ostream& out) const;
+
+  // Replaces the content with a stream written by `save`. Complexity: O(n).
+  // Throws std::runtime_error if the stream is truncated, corrupted, or saved with different types.
+  void load(std::istream& in);
+
+  // Moves all the nodes into fresh memory, in breadth first order, and releases the old pools.
+  // Restores the cache efficiency of a container aged by many insertions and removals.
+  // Invalidates all iterators.
+  void compact();
+
   std::size_t size() const noexcept {
     return size_;
   }
@@ -116,6 +296,19 @@ public:
     return root_ ? root_->subtree_weight : 0;
   }
 
+  // Counters of the work performed since construction or the last reset. All counters are zero
+  // with the default NoStatistics policy.
+  OperationCounters stats() const noexcept;
+  void resetStats() noexcept {
+    statistics().reset(allocator_.poolCount());
+  }
+
+  // Records the latency of each operation into `tracer`, or stops recording if null.
+  // Has no effect unless MAPLIB_ENABLE_TRACING is defined.
+  void setTracer(LatencyTracer* tracer) noexcept {
+    tracer_ = tracer;
+  }
+
   // For testing purposes.
   bool checkConsistency() const noexcept;
 
@@ -123,28 +316,150 @@ private:
   constexpr static auto BLACK = details::BLACK;
   constexpr static auto RED = details::RED;
 
+  // Looks up the key, then inserts it or assigns the value, and the weight if `assign_weight`.
+  auto insertAfterLookup(const Key& key, const Value& value, const Weight& weight,
+                         bool assign_weight) noexcept -> std::pair<iterator, bool>;
+  // Precondition: the pending scales of the ancestors of `to_delete` are applied.
+  void eraseNode(Node* to_delete);
+
+  // Returns the node at `position` of the cumulative weight of the subtree of `node`. `scale` is
+  // the product of the pending scales of the ancestors of `node`.
+  Node* findPosition(Node* node, Weight position, Weight scale = 1) const;
+  // Returns the factor between the stored and actual weights of the children of `node`, given the
+  // factor `scale` of `node` itself.
+  static Weight childrenScale(const Node* node, Weight scale) {
+    if constexpr (std::is_floating_point_v<Weight>)
+      return scale * node->scale;
+    else
+      return scale;
+  }
+  // Calls `f(node, weight)` on the nodes of the subtree of `node` in key order, with their actual
+  // weight. `scale` is the product of the pending scales of the ancestors of `node`.
+  template <class F>
+  static void forEachWeighted(const Node* node, Weight scale, F&& f);
+
+  // Returns the summed weight of the entries in the subtree of `node` with key lower than `bound`,
+  // if `below`, or not lower otherwise. `scale` is the product of the pending scales of the
+  // ancestors of `node`.
+  template <bool below>
+  Weight boundedWeight(const Node* node, const Key& bound, Weight scale) const noexcept;
+  // Same as boundedWeight, for the aggregate.
+  template <bool below>
+  aggregate_type boundedAggregate(const Node* node, const Key& bound, Weight scale) const;
+  // Returns the aggregate of the subtree of `node`, given the pending scales of its ancestors.
+  static aggregate_type subtreeAggregate(const Node* node, Weight scale) {
+    return node ? details::scaleAggregate<Augmentation>(node->aggregate, scale)
+                : Augmentation::identity();
+  }
+  // Returns the aggregate of the entry of `node` alone.
+  static aggregate_type ownAggregate(const Node* node, Weight scale) {
+    return Augmentation::make(node->data.first, node->data.second, scale * node->weight);
+  }
+
+  // Returns the first node of the subtree of `node` whose prefix aggregate, appended to `acc`,
+  // satisfies `pred`, and appends the skipped entries to `acc`. If `key_lo` is not null, only the
+  // entries not lower than *key_lo are considered.
+  template <class Aggregate, class Pred>
+  Node* findFirstIn(Node* node, const Key* key_lo, Weight scale, Aggregate& acc, Pred& pred) const;
+
+  // Returns the node at position `index` in the sorted order.
+  // Precondition: the map is ranked and index < size().
+  Node* nodeAtIndex(std::size_t index) const;
+
+  // Returns the highest node with key in [key_lo, *key_hi), or in [key_lo, inf) if key_hi is null,
+  // and sets `scale` to the product of the pending scales of its ancestors.
+  Node* findSplit(const Key& key_lo, const Key* key_hi, Weight& scale) const noexcept;
+  // Returns a node with key in [key_lo, *key_hi), or not lower than key_lo if key_hi is null,
+  // sampled proportionally to its weight.
+  template <class Rng>
+  Node* sampleBetween(Rng& rng, const Key& key_lo, const Key* key_hi) const;
+  // Returns the node at `position` of the weight of the entries in the subtree of `node` that are
+  // not lower than key_lo, if `below` is false, or lower than key_hi otherwise.
+  template <bool below>
+  Node* findBoundedPosition(Node* node, const Key& bound, Weight position, Weight scale) const;
+
+  // Writes an iterator of type It for each position in [first, last).
+  template <class It, class PositionIt, class OutputIt>
+  OutputIt samplePositions(PositionIt first, PositionIt last, OutputIt out) const;
+  // Resolves the positions in [first, last), all within the subtree of `node`, in one descent.
+  template <class It, class PositionIt, class OutputIt>
+  OutputIt sampleSubtree(Node* node, Weight on_the_left, Weight scale, PositionIt first,
+                         PositionIt last, OutputIt out, Stats& stats) const;
+  template <class It, class OutputIt>
+  OutputIt parallelSampleImpl(std::size_t k, std::uint64_t seed, OutputIt out,
+                              unsigned n_threads) const;
+
+  template <class It>
+  AliasSampler<It> buildAliasSampler() const;
+
+  void applyWeights(const std::vector<std::pair<Node*, Weight>>& updates);
+  // Recomputes the subtree weights bottom-up.
+  static void updateAllSubtreeWeights(Node* node);
+  // Applies all the pending scales, top-down.
+  static void pushDownAll(Node* node);
+  // Records whether some nodes might have a pending scale, and counts the map in
+  // Node::scaled_trees accordingly.
+  void setScaled(bool scaled) noexcept;
+
+  // Weight already sampled in the subtree of a node, used by sampleWithoutReplacement.
+  struct Removed {
+    Weight subtree_weight = 0;
+    bool sampled = false;
+  };
+  using RemovedWeights = details::NodeTable<Node, Removed>;
+
+  template <class It, class Rng, class OutputIt>
+  OutputIt sampleDistinct(Rng& rng, std::size_t k, OutputIt out) const;
+  // Returns the node not yet sampled at `position` of the remaining weight of the subtree.
+  // `entry` is the record of `node` in `removed`, or nullptr if no node of the subtree was sampled.
+  // `scale` is the product of the pending scales of the ancestors of `node`.
+  Node* sampleRemaining(Node* node, const Removed* entry, Weight position, Weight scale,
+                        const RemovedWeights& removed) const;
+
+  // The statistics policy is a base class, so that NoStatistics takes no space.
+  Stats& statistics() const noexcept {
+    return const_cast<SamplingMap&>(*this);
+  }
+
   // Members
   Node* root_ = nullptr;
   std::size_t size_ = 0;
   FixedSizeAllocator<Node, chunk_size> allocator_;
+  LatencyTracer* tracer_ = nullptr;
+  bool scaled_ = false;  // Some nodes might have a pending scale.
 };
 
-template <class Key, class Value, class Weight, std::size_t chunk_size>
-SamplingMap<Key, Value, Weight, chunk_size>::SamplingMap(
+// SamplingMap that also maintains the subtree sizes, i.e. the ranks of the keys.
+template <class Key, class Value, class Weight, std::size_t chunk_size = 64,
+          class Stats = NoStatistics>
+using RankedSamplingMap = SamplingMap<Key, Value, Weight, chunk_size, true, void, Stats>;
+
+// SamplingMap that also maintains the aggregate of each subtree under `Augmentation`.
+template <class Key, class Value, class Weight, class Augmentation, std::size_t chunk_size = 64,
+          class Stats = NoStatistics>
+using AugmentedSamplingMap =
+    SamplingMap<Key, Value, Weight, chunk_size, false, Augmentation, Stats>;
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::SamplingMap(
     const std::initializer_list<std::tuple<Key, Value, Weight>>& list) {
   for (const auto& elem : list)
     insert(elem);
 }
 
-template <class Key, class Value, class Weight, std::size_t chunk_size>
-SamplingMap<Key, Value, Weight, chunk_size>::SamplingMap(
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::SamplingMap(
     const std::vector<std::tuple<Key, Value, Weight>>& linearized) {
   for (const auto& elem : linearized)
     insert(elem);
 }
 
-template <class Key, class Value, class Weight, std::size_t chunk_size>
-SamplingMap<Key, Value, Weight, chunk_size>::~SamplingMap() {
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::~SamplingMap() {
+  setScaled(false);
   std::stack<Node*> to_delete;
   if (root_)
     to_delete.push(root_);
@@ -162,40 +477,56 @@ SamplingMap<Key, Value, Weight, chunk_size>::~SamplingMap() {
   }
 }
 
-template <class Key, class Value, class Weight, std::size_t chunk_size>
-SamplingMap<Key, Value, Weight, chunk_size>::SamplingMap(const SamplingMap& rhs) {
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::SamplingMap(
+    const SamplingMap& rhs) {
   (*this) = rhs;
 }
 
-template <class Key, class Value, class Weight, std::size_t chunk_size>
-SamplingMap<Key, Value, Weight, chunk_size>::SamplingMap(SamplingMap&& rhs) {
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::SamplingMap(
+    SamplingMap&& rhs) {
   (*this) = std::move(rhs);
 }
 
-template <class Key, class Value, class Weight, std::size_t chunk_size>
-SamplingMap<Key, Value, Weight, chunk_size>& SamplingMap<Key, Value, Weight, chunk_size>::operator=(
-    const SamplingMap<Key, Value, Weight, chunk_size>& rhs) {
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::operator=(
+    const SamplingMap& rhs) -> SamplingMap& {
   if (this != &rhs) {
     *this = std::move(SamplingMap());  // clear content.
 
-    for (auto it = rhs.begin(); it != rhs.end(); ++it)
-      insert(it->first, it->second, it.getWeight());
+    forEachWeighted(rhs.root_, 1, [&](const Node* node, const Weight weight) {
+      insert(node->data.first, node->data.second, weight);
+    });
   }
   return *this;
 }
 
-template <class Key, class Value, class Weight, std::size_t chunk_size>
-SamplingMap<Key, Value, Weight, chunk_size>& SamplingMap<Key, Value, Weight, chunk_size>::operator=(
-    SamplingMap<Key, Value, Weight, chunk_size>&& rhs) {
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::operator=(
+    SamplingMap&& rhs) -> SamplingMap& {
   std::swap(root_, rhs.root_);
+  std::swap(size_, rhs.size_);
   std::swap(allocator_, rhs.allocator_);
+  std::swap(statistics(), rhs.statistics());
+  std::swap(tracer_, rhs.tracer_);
+  std::swap(scaled_, rhs.scaled_);
   return *this;
 }
 
-template <class Key, class Value, class Weight, std::size_t chunk_size>
-auto SamplingMap<Key, Value, Weight, chunk_size>::insert(const Key& key, const Value& val,
-                                                         const Weight& weight) noexcept
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::insert(
+    const Key& key, const Value& val, const Weight& weight, const Expect expect) noexcept
     -> std::pair<iterator, bool> {
+  if (expect == Expect::NO_CHANGE)
+    return insertAfterLookup(key, val, weight, false);
+
+  const details::Trace trace(tracer_, Operation::INSERT);
   if (!root_) {
     root_ = allocator_.create(key, val, weight, nullptr);
     root_->color = BLACK;
@@ -207,21 +538,35 @@ auto SamplingMap<Key, Value, Weight, chunk_size>::insert(const Key& key, const V
   bool done = false;
 
   while (!done) {
+    statistics().countDescent();
+    statistics().countComparison();
     const int comp = details::compare(key, get_key(node));
 
     if (comp == 0) {  // Key is already present. Undo changes and return.
+      statistics().countUndoneInsertion();
       node->data.second = val;
       iterator return_it = iterator(node);
 
+      if constexpr (Node::augmented) {  // The aggregates depend on the new value.
+        for (; node; node = node->parent)
+          node->updateSubtreeWeight();
+        return {return_it, false};
+      }
+
       node = node->parent;
       while (node) {
         node->subtree_weight -= weight;
+        if constexpr (ranked)
+          --node->subtree_size;
         node = node->parent;
       }
 
       return {return_it, false};
     }
+    node->pushDown();  // The weights of the children must be exact before the insertion below.
     node->subtree_weight += weight;
+    if constexpr (ranked)
+      ++node->subtree_size;
 
     if (comp < 0) {
       if (node->left == nullptr) {
@@ -239,86 +584,164 @@ auto SamplingMap<Key, Value, Weight, chunk_size>::insert(const Key& key, const V
     }
   }
 
+  if constexpr (Node::augmented) {
+    for (Node* ancestor = node->parent; ancestor; ancestor = ancestor->parent)
+      ancestor->updateSubtreeWeight();
+  }
+
   // Check colors
-  details::fixRedRed(node, root_);
+  details::fixRedRed(node, root_, statistics());
 
   //  assert(checkConsistency());
   ++size_;
   return {iterator(node), true};
 }
 
-template <class Key, class Value, class Weight, std::size_t chunk_size>
-bool SamplingMap<Key, Value, Weight, chunk_size>::erase(const Key& key) noexcept {
-  if (!root_)
-    return false;
-  Node* to_delete = root_;
-
-  // Search while updating subtree count.
-  bool found = false;
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::insertAfterLookup(
+    const Key& key, const Value& val, const Weight& weight, const bool assign_weight) noexcept
+    -> std::pair<iterator, bool> {
+  const details::Trace trace(tracer_, Operation::INSERT);
+  if (!root_) {
+    root_ = allocator_.create(key, val, weight, nullptr);
+    root_->color = BLACK;
+    ++size_;
+    return {iterator(root_), true};
+  }
 
+  // Look up the key, or its parent if missing. The pending scales are applied on the way, so that
+  // the ancestors' stored weights are exact.
+  Node* node = root_;
   while (true) {
-    const int comp = details::compare(key, get_key(to_delete));
+    statistics().countDescent();
+    statistics().countComparison();
+    const int comp = details::compare(key, get_key(node));
 
-    if (comp == 0) {
-      found = true;
+    if (comp == 0) {  // Assign value, and weight if requested.
+      node->data.second = val;
+      if constexpr (Node::augmented) {
+        if (assign_weight)
+          node->weight = weight;
+        for (Node* ancestor = node; ancestor; ancestor = ancestor->parent)
+          ancestor->updateSubtreeWeight();
+      }
+      else if (assign_weight) {
+        const Weight diff = weight - node->weight;
+        node->weight = weight;
+        for (Node* ancestor = node; ancestor; ancestor = ancestor->parent)
+          ancestor->subtree_weight += diff;
+      }
+      return {iterator(node), false};
+    }
+
+    node->pushDown();
+    Node*& child = comp < 0 ? node->left : node->right;
+    if (!child) {
+      child = allocator_.create(key, val, weight, node);
+      node = child;
       break;
     }
+    node = child;
+  }
 
-    if (comp < 0) {
-      if (!to_delete->left)
-        break;
-      to_delete = to_delete->left;
+  for (Node* ancestor = node->parent; ancestor; ancestor = ancestor->parent) {
+    if constexpr (Node::augmented) {
+      ancestor->updateSubtreeWeight();
     }
     else {
-      if (!to_delete->right)
-        break;
-      to_delete = to_delete->right;
+      ancestor->subtree_weight += weight;
+      if constexpr (ranked)
+        ++ancestor->subtree_size;
     }
   }
 
-  if (!found) {
-    return false;
+  details::fixRedRed(node, root_, statistics());
+  ++size_;
+  return {iterator(node), true};
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+bool SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::erase(
+    const Key& key) noexcept {
+  const details::Trace trace(tracer_, Operation::ERASE);
+  Node* to_delete = root_;
+
+  // Search while applying the pending scales, as required by eraseNode.
+  while (to_delete) {
+    statistics().countDescent();
+    statistics().countComparison();
+    const int comp = details::compare(key, get_key(to_delete));
+    if (comp == 0)
+      break;
+    to_delete->pushDown();
+    to_delete = comp < 0 ? to_delete->left : to_delete->right;
   }
 
-  erase(iterator(to_delete));
+  if (!to_delete)
+    return false;
 
+  eraseNode(to_delete);
   return true;
 }
 
-template <class Key, class Value, class Weight, std::size_t chunk_size>
-void SamplingMap<Key, Value, Weight, chunk_size>::erase(const iterator it) {
-  Node* to_delete = it.node_;
-
-  // Update upstream weights
-  Node* original = to_delete;
-  bool double_children = false;
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+void SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::erase(
+    const iterator it) {
+  const details::Trace trace(tracer_, Operation::ERASE);
+  it.node_->pushDownFromRoot();
+  eraseNode(it.node_);
+}
 
-  if (to_delete->left != nullptr && to_delete->right != nullptr) {  // to_delete has two children.
-    double_children = true;
-    to_delete = to_delete->right;
-    while (to_delete->left) {
-      to_delete = to_delete->left;
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+void SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::eraseNode(
+    Node* to_delete) {
+  const Weight removed_weight = to_delete->weight;
+  to_delete->pushDown();
+
+  // A node with two children is swapped with its successor, which is then the removed position.
+  Node* successor = nullptr;
+  if (to_delete->left != nullptr && to_delete->right != nullptr) {
+    successor = to_delete->right;
+    successor->pushDown();
+    while (successor->left) {
+      statistics().countDescent();
+      successor = successor->left;
+      successor->pushDown();
     }
+    swap(to_delete, successor, root_);
   }
 
-  if (double_children) {  // Update original and downstream.
-    const Weight moved_w = to_delete->weight;
-
-    original->weight = 0;
-
-    swap(original, to_delete, root_);
-    std::swap(to_delete, original);
+  // The removed node keeps a null weight, size and aggregate until it is unlinked, as it is still
+  // visited by the rotations. All the scales on the path are 1: the weights are updated by
+  // difference. The positions below the successor lose its weight, the ones above the removed one.
+  if constexpr (Node::augmented) {
+    to_delete->excludeSelf();
+    for (Node* ancestor = to_delete->parent; ancestor; ancestor = ancestor->parent)
+      ancestor->updateSubtreeWeight();
   }
-
-  // TODO: slightly optimize weight update.
-  to_delete->weight = 0;
-  Node* ancestor = to_delete;
-  while (ancestor) {
-    ancestor->updateSubtreeWeight();
-    ancestor = ancestor->parent;
+  else {
+    Node* ancestor = to_delete;
+    if (successor) {
+      const Weight moved_weight = successor->weight;
+      for (; ancestor != successor; ancestor = ancestor->parent) {
+        ancestor->subtree_weight -= moved_weight;
+        if constexpr (ranked)
+          --ancestor->subtree_size;
+      }
+    }
+    for (; ancestor; ancestor = ancestor->parent) {
+      ancestor->subtree_weight -= removed_weight;
+      if constexpr (ranked)
+        --ancestor->subtree_size;
+    }
+    to_delete->weight = 0;
   }
 
-  removeNoDoubleChild(to_delete, root_);
+  removeNoDoubleChild(to_delete, root_, statistics());
 
   --size_;
   allocator_.destroy(to_delete);
@@ -326,50 +749,54 @@ void SamplingMap<Key, Value, Weight, chunk_size>::erase(const iterator it) {
   //  assert(checkConsistency());
 }
 
-template <class Key, class Value, class Weight, std::size_t chunk_size>
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
 template <class Rng>
-auto SamplingMap<Key, Value, Weight, chunk_size>::sample(Rng& rng) noexcept -> iterator {
-  const Weight total_weight = totalWeight();
-  Weight scaled;
-
-  if constexpr (std::is_floating_point_v<Weight>) {
-    assert(total_weight >= 0);
-    scaled = std::uniform_real_distribution<Weight>(0, total_weight)(rng);
-  }
-  else {  // is integer
-    static_assert(std::is_integral_v<Weight>, "Weight needs to be floating or integer.");
-    scaled = std::uniform_int_distribution<Weight>(0, total_weight - 1)(rng);
-  }
-
-  return sample(scaled);
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::sample(
+    Rng& rng) noexcept -> iterator {
+  return sample(details::randomPosition(rng, totalWeight()));
 }
 
-template <class Key, class Value, class Weight, std::size_t chunk_size>
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
 template <class Rng>
-auto SamplingMap<Key, Value, Weight, chunk_size>::sample(Rng& rng) const noexcept -> const_iterator {
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::sample(
+    Rng& rng) const noexcept -> const_iterator {
   return const_cast<SamplingMap&>(*this).sample(rng);
 }
 
-template <class Key, class Value, class Weight, std::size_t chunk_size>
-auto SamplingMap<Key, Value, Weight, chunk_size>::sample(const Weight position) noexcept -> iterator {
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::sample(
+    const Weight position) noexcept -> iterator {
+  const details::Trace trace(tracer_, Operation::SAMPLE);
   const auto total = totalWeight();
   if (!total || position < 0 || position > total ||
       (std::is_integral_v<Weight> && position == total)) {  // Out of range.
     return iterator(nullptr);
   }
 
+  return iterator(findPosition(root_, position));
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::findPosition(
+    Node* node, Weight position, Weight scale) const -> Node* {
   Weight on_the_left(0);
-  Node* node = root_;
 
   while (true) {
     assert(node);
+    statistics().countDescent();
 
+    const Weight children_scale = childrenScale(node, scale);
+    const Weight own_weight = scale * node->weight;
     auto new_on_the_left = on_the_left;
     if (node->left)
-      new_on_the_left += node->left->subtree_weight;
+      new_on_the_left += children_scale * node->left->subtree_weight;
 
-    if (position >= new_on_the_left && position < new_on_the_left + node->weight) {
-      return iterator(node);
+    if (position >= new_on_the_left && position < new_on_the_left + own_weight) {
+      return node;
     }
     else if (position < new_on_the_left) {  // go left
       node = node->left;
@@ -377,26 +804,912 @@ auto SamplingMap<Key, Value, Weight, chunk_size>::sample(const Weight position)
     else {  // go right
       if constexpr (std::is_floating_point_v<Weight>) {
         if (!node->right) {  // Due to numerical issues the sample could be right at the edge of the interval.
-          return iterator(node);
+          return node;
         }
       }
 
-      on_the_left = new_on_the_left + node->weight;
+      on_the_left = new_on_the_left + own_weight;
       node = node->right;
     }
+    scale = children_scale;
   }
 }
 
-template <class Key, class Value, class Weight, std::size_t chunk_size>
-auto SamplingMap<Key, Value, Weight, chunk_size>::sample(const Weight position) const noexcept
-    -> const_iterator {
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::sample(
+    const Weight position) const noexcept -> const_iterator {
   return const_cast<SamplingMap&>(*this).sample(position);
 }
 
-template <class Key, class Value, class Weight, std::size_t chunk_size>
-auto SamplingMap<Key, Value, Weight, chunk_size>::findByKey(const Key& key) noexcept -> iterator {
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+template <class PositionIt, class OutputIt>
+OutputIt SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::sample(
+    PositionIt first, PositionIt last, OutputIt out) {
+  return samplePositions<iterator>(first, last, out);
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+template <class PositionIt, class OutputIt>
+OutputIt SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::sample(
+    PositionIt first, PositionIt last, OutputIt out) const {
+  return samplePositions<const_iterator>(first, last, out);
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+template <class Rng, class OutputIt>
+OutputIt SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::sampleBatch(
+    Rng& rng, const std::size_t k, OutputIt out) {
+  std::vector<Weight> positions;
+  details::sortedRandomPositions(rng, totalWeight(), k, positions);
+  return samplePositions<iterator>(positions.begin(), positions.end(), out);
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+template <class Rng, class OutputIt>
+OutputIt SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::sampleBatch(
+    Rng& rng, const std::size_t k, OutputIt out) const {
+  std::vector<Weight> positions;
+  details::sortedRandomPositions(rng, totalWeight(), k, positions);
+  return samplePositions<const_iterator>(positions.begin(), positions.end(), out);
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+template <class It, class PositionIt, class OutputIt>
+OutputIt SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::samplePositions(
+    PositionIt first, PositionIt last, OutputIt out) const {
+  const auto total = totalWeight();
+  auto write_null = [&](PositionIt from, PositionIt to) {
+    for (; from != to; ++from)
+      *out++ = It(nullptr);
+  };
+
+  if (!total) {
+    write_null(first, last);
+    return out;
+  }
+
+  // Out of range positions are at the two ends of the sorted range.
+  const auto valid_begin = std::partition_point(first, last, [](Weight p) { return p < 0; });
+  const auto valid_end = std::partition_point(valid_begin, last, [&](Weight p) {
+    return std::is_integral_v<Weight> ? p < total : p <= total;
+  });
+
+  write_null(first, valid_begin);
+  out = sampleSubtree<It>(root_, Weight(0), Weight(1), valid_begin, valid_end, out, statistics());
+  write_null(valid_end, last);
+  return out;
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+template <class It, class PositionIt, class OutputIt>
+OutputIt SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::sampleSubtree(
+    Node* node, Weight on_the_left, const Weight scale, PositionIt first, PositionIt last,
+    OutputIt out, Stats& stats) const {
+  if (first == last)
+    return out;
+  assert(node);
+  stats.countDescent();
+
+  const Weight children_scale = childrenScale(node, scale);
+  auto new_on_the_left = on_the_left;
+  if (node->left)
+    new_on_the_left += children_scale * node->left->subtree_weight;
+  const Weight on_the_right = new_on_the_left + scale * node->weight;
+
+  // Split the positions between left subtree, node, and right subtree.
+  auto node_begin = std::partition_point(first, last, [&](Weight p) { return p < new_on_the_left; });
+  auto node_end = std::partition_point(node_begin, last, [&](Weight p) { return p < on_the_right; });
+  if (!node->left)
+    node_begin = first;
+  if (!node->right)  // Due to numerical issues a sample could be right at the edge of the interval.
+    node_end = last;
+
+  out = sampleSubtree<It>(node->left, on_the_left, children_scale, first, node_begin, out, stats);
+  for (; node_begin != node_end; ++node_begin)
+    *out++ = It(node);
+  return sampleSubtree<It>(node->right, on_the_right, children_scale, node_end, last, out, stats);
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+template <class OutputIt>
+OutputIt SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::parallelSample(
+    const std::size_t k, const std::uint64_t seed, OutputIt out, const unsigned n_threads) {
+  return parallelSampleImpl<iterator>(k, seed, out, n_threads);
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+template <class OutputIt>
+OutputIt SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::parallelSample(
+    const std::size_t k, const std::uint64_t seed, OutputIt out, const unsigned n_threads) const {
+  return parallelSampleImpl<const_iterator>(k, seed, out, n_threads);
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+template <class It, class OutputIt>
+OutputIt
+SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::parallelSampleImpl(
+    const std::size_t k, const std::uint64_t seed, OutputIt out, unsigned n_threads) const {
+  const Weight total = totalWeight();
+  std::vector<It> samples(k, It(nullptr));
+  if (!total || !k)
+    return std::copy(samples.begin(), samples.end(), out);
+
+  n_threads = std::max(1u, static_cast<unsigned>(std::min<std::size_t>(n_threads, k)));
+  std::vector<Stats> thread_stats(n_threads);
+
+  // Resolves the samples with index in [k * id / n_threads, k * (id + 1) / n_threads).
+  auto work = [&](const unsigned id) {
+    const std::size_t begin = k * id / n_threads;
+    const std::size_t end = k * (id + 1) / n_threads;
+    Stats& stats = thread_stats[id];
+    std::vector<std::pair<double, std::size_t>> indexed_uniforms(end - begin);
+    for (std::size_t i = begin; i < end; ++i)
+      indexed_uniforms[i - begin] = {details::philoxUniform(seed, i), i};
+    details::bucketSortUniform(indexed_uniforms);
+
+    std::vector<Weight> positions(end - begin);
+    for (std::size_t j = 0; j < positions.size(); ++j)
+      positions[j] = details::scalePosition(indexed_uniforms[j].first, total);
+    std::vector<It> sorted_samples(end - begin);
+    sampleSubtree<It>(root_, Weight(0), Weight(1), positions.begin(), positions.end(),
+                      sorted_samples.begin(), stats);
+
+    for (std::size_t j = 0; j < sorted_samples.size(); ++j)
+      samples[indexed_uniforms[j].second] = sorted_samples[j];
+  };
+
+  details::ThreadPool::instance().run(n_threads, work);
+  for (const auto& stats : thread_stats)
+    statistics().merge(stats);
+
+  return std::copy(samples.begin(), samples.end(), out);
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+template <class Rng, class OutputIt>
+OutputIt
+SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::sampleWithoutReplacement(
+    Rng& rng, const std::size_t k, OutputIt out) {
+  return sampleDistinct<iterator>(rng, k, out);
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+template <class Rng, class OutputIt>
+OutputIt
+SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::sampleWithoutReplacement(
+    Rng& rng, const std::size_t k, OutputIt out) const {
+  return sampleDistinct<const_iterator>(rng, k, out);
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+template <class It, class Rng, class OutputIt>
+OutputIt SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::sampleDistinct(
+    Rng& rng, const std::size_t k, OutputIt out) const {
+  // Each sample marks its ancestors, about log2(n) nodes, but the paths share the top levels.
+  std::size_t depth = 1;
+  while ((std::size_t(1) << depth) <= size_)
+    ++depth;
+  RemovedWeights removed(std::min(k, size_) * depth / 2);
+  Weight remaining = totalWeight();
+
+  for (std::size_t i = 0; i < k && remaining > 0; ++i) {
+    Node* const node = sampleRemaining(root_, removed.find(root_),
+                                       details::randomPosition(rng, remaining), Weight(1), removed);
+    if (!node)  // Only rounding errors are left.
+      break;
+    *out++ = It(node);
+
+    // Subtract the weight from the node and its ancestors.
+    removed[node].sampled = true;
+    const Weight weight = node->weight * node->ancestorsScale();
+    for (const Node* ancestor = node; ancestor; ancestor = ancestor->parent)
+      removed[ancestor].subtree_weight += weight;
+    remaining = root_->subtree_weight - removed.find(root_)->subtree_weight;
+  }
+
+  return out;
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::sampleRemaining(
+    Node* node, const Removed* entry, Weight position, const Weight scale,
+    const RemovedWeights& removed) const -> Node* {
+  if (!entry)  // Nothing was sampled from this subtree.
+    return node && node->subtree_weight > 0 ? findPosition(node, position, scale) : nullptr;
+  if (scale * node->subtree_weight - entry->subtree_weight <= 0)
+    return nullptr;
+  statistics().countDescent();
+
+  const Weight children_scale = childrenScale(node, scale);
+  const Removed* const left_entry = node->left ? removed.find(node->left) : nullptr;
+  Weight left_weight = node->left ? children_scale * node->left->subtree_weight : 0;
+  if (left_entry)
+    left_weight -= left_entry->subtree_weight;
+  const Weight own_weight = entry->sampled ? 0 : scale * node->weight;
+  auto right_entry = [&] { return node->right ? removed.find(node->right) : nullptr; };
+
+  if (position < left_weight) {
+    if (Node* result = sampleRemaining(node->left, left_entry, position, children_scale, removed))
+      return result;
+  }
+  else if (position < left_weight + own_weight) {
+    return node;
+  }
+  else if (Node* result = sampleRemaining(node->right, right_entry(),
+                                          position - left_weight - own_weight, children_scale,
+                                          removed)) {
+    return result;
+  }
+
+  // Floating point rounding can leave a small positive weight in a subtree with nothing left to
+  // sample. Fall back to the closest entry with remaining weight.
+  if (own_weight > 0)
+    return node;
+  if (position < left_weight)
+    return sampleRemaining(node->right, right_entry(), 0, children_scale, removed);
+  return sampleRemaining(node->left, left_entry, left_weight, children_scale, removed);
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+Weight SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::cumulativeWeight(
+    const Key& key) const noexcept {
+  return boundedWeight<true>(root_, key, Weight(1));
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+Weight SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::weightBetween(
+    const Key& key_lo, const Key& key_hi) const noexcept {
+  // Find the highest node in the range, then sum the two sides of its subtree.
+  Weight scale;
+  const Node* const split = findSplit(key_lo, &key_hi, scale);
+  if (!split)  // Empty range.
+    return 0;
+
+  const Weight children_scale = childrenScale(split, scale);
+  return scale * split->weight + boundedWeight<false>(split->left, key_lo, children_scale) +
+         boundedWeight<true>(split->right, key_hi, children_scale);
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::aggregate() const
+    -> aggregate_type {
+  static_assert(Node::augmented, "The aggregate requires an augmentation policy.");
+  return subtreeAggregate(root_, 1);
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::aggregate(
+    const Key& key_lo, const Key& key_hi) const -> aggregate_type {
+  static_assert(Node::augmented, "The aggregate requires an augmentation policy.");
+  Weight scale;
+  const Node* const split = findSplit(key_lo, &key_hi, scale);
+  if (!split)  // Empty range.
+    return Augmentation::identity();
+
+  const Weight children_scale = childrenScale(split, scale);
+  return Augmentation::combine(
+      Augmentation::combine(boundedAggregate<false>(split->left, key_lo, children_scale),
+                            ownAggregate(split, scale)),
+      boundedAggregate<true>(split->right, key_hi, children_scale));
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+template <bool below>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::boundedAggregate(
+    const Node* node, const Key& bound, Weight scale) const -> aggregate_type {
+  // The entries found deeper along the path are closer to the bound: they are prepended to the
+  // result on the lower boundary, and appended on the upper one.
+  aggregate_type result = Augmentation::identity();
+  while (node) {
+    statistics().countDescent();
+    statistics().countComparison();
+    const Weight children_scale = childrenScale(node, scale);
+    const bool in_range = (details::compare(get_key(node), bound) < 0) == below;
+
+    if (in_range) {  // The node and its subtree on the inner side are included.
+      if constexpr (below)
+        result = Augmentation::combine(
+            result, Augmentation::combine(subtreeAggregate(node->left, children_scale),
+                                          ownAggregate(node, scale)));
+      else
+        result = Augmentation::combine(
+            Augmentation::combine(ownAggregate(node, scale),
+                                  subtreeAggregate(node->right, children_scale)),
+            result);
+    }
+    node = in_range == below ? node->right : node->left;
+    scale = children_scale;
+  }
+  return result;
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+template <class Pred>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::findFirst(
+    Pred&& pred) -> iterator {
+  static_assert(Node::augmented, "The search requires an augmentation policy.");
+  aggregate_type acc = Augmentation::identity();
+  return iterator(findFirstIn(root_, nullptr, 1, acc, pred));
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+template <class Pred>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::findFirst(
+    Pred&& pred) const -> const_iterator {
+  return const_cast<SamplingMap&>(*this).findFirst(pred);
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+template <class Pred>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::findFirst(
+    const Key& key_lo, Pred&& pred) -> iterator {
+  static_assert(Node::augmented, "The search requires an augmentation policy.");
+  aggregate_type acc = Augmentation::identity();
+  return iterator(findFirstIn(root_, &key_lo, 1, acc, pred));
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+template <class Pred>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::findFirst(
+    const Key& key_lo, Pred&& pred) const -> const_iterator {
+  return const_cast<SamplingMap&>(*this).findFirst(key_lo, pred);
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+template <class Aggregate, class Pred>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::findFirstIn(
+    Node* node, const Key* key_lo, Weight scale, Aggregate& acc, Pred& pred) const -> Node* {
+  // Without a bound, a subtree is either skipped as a whole or contains the result.
+  if (!key_lo) {
+    const Aggregate whole = Augmentation::combine(acc, subtreeAggregate(node, scale));
+    if (!pred(whole)) {
+      acc = whole;
+      return nullptr;
+    }
+  }
+
+  while (node) {
+    statistics().countDescent();
+    const Weight children_scale = childrenScale(node, scale);
+
+    if (key_lo) {
+      statistics().countComparison();
+      if (details::compare(get_key(node), *key_lo) < 0) {  // The node and its left are skipped.
+        node = node->right;
+        scale = children_scale;
+        continue;
+      }
+      if (Node* const found = findFirstIn(node->left, key_lo, children_scale, acc, pred))
+        return found;
+    }
+    else if (node->left) {
+      const Aggregate with_left =
+          Augmentation::combine(acc, subtreeAggregate(node->left, children_scale));
+      if (pred(with_left)) {
+        node = node->left;
+        scale = children_scale;
+        continue;
+      }
+      acc = with_left;
+    }
+
+    acc = Augmentation::combine(acc, ownAggregate(node, scale));
+    if (pred(acc))
+      return node;
+    // The right subtree is entirely above the bound.
+    if (key_lo)
+      return findFirstIn(node->right, nullptr, children_scale, acc, pred);
+    node = node->right;
+    scale = children_scale;
+  }
+  return nullptr;
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+template <class Rng>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::sampleInRange(
+    Rng& rng, const Key& key_lo, const Key& key_hi) -> iterator {
+  const details::Trace trace(tracer_, Operation::SAMPLE);
+  return iterator(sampleBetween(rng, key_lo, &key_hi));
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+template <class Rng>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::sampleInRange(
+    Rng& rng, const Key& key_lo, const Key& key_hi) const -> const_iterator {
+  return const_cast<SamplingMap&>(*this).sampleInRange(rng, key_lo, key_hi);
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+template <class Rng>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::sampleInIndexRange(
+    Rng& rng, const std::size_t first, const std::size_t last) -> iterator {
+  static_assert(ranked, "Sampling by index requires a RankedSamplingMap.");
+  const details::Trace trace(tracer_, Operation::SAMPLE);
+  if (first > last || last > size_)
+    throw(std::out_of_range("Index range out of range"));
+  if (first == last)
+    return iterator(nullptr);
+
+  // The index range is the key range between the two boundary entries.
+  const Key& key_lo = get_key(nodeAtIndex(first));
+  const Key* key_hi = last < size_ ? &get_key(nodeAtIndex(last)) : nullptr;
+  return iterator(sampleBetween(rng, key_lo, key_hi));
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+template <class Rng>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::sampleInIndexRange(
+    Rng& rng, const std::size_t first, const std::size_t last) const -> const_iterator {
+  return const_cast<SamplingMap&>(*this).sampleInIndexRange(rng, first, last);
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::findByIndex(
+    const std::size_t index) -> iterator {
+  static_assert(ranked, "Access by index requires a RankedSamplingMap.");
+  const details::Trace trace(tracer_, Operation::FIND_BY_INDEX);
+  if (index >= size())
+    throw(std::out_of_range("Index out of range"));
+  return iterator(nodeAtIndex(index));
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::findByIndex(
+    const std::size_t index) const -> const_iterator {
+  return const_cast<SamplingMap&>(*this).findByIndex(index);
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::nodeAtIndex(
+    const std::size_t index) const -> Node* {
+  Node* node = root_;
+  std::size_t on_the_left = 0;
+  while (true) {
+    assert(node);
+    statistics().countDescent();
+
+    auto new_on_the_left = on_the_left;
+    if (node->left)
+      new_on_the_left += node->left->subtree_size;
+
+    if (new_on_the_left == index) {
+      return node;
+    }
+    else if (new_on_the_left > index) {  // go left
+      node = node->left;
+    }
+    else {  // go right
+      on_the_left = new_on_the_left + 1;
+      node = node->right;
+    }
+  }
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::findSplit(
+    const Key& key_lo, const Key* key_hi, Weight& scale) const noexcept -> Node* {
+  Node* split = root_;
+  scale = 1;
+  while (split) {
+    statistics().countDescent();
+    statistics().countComparison();
+    if (details::compare(get_key(split), key_lo) < 0)
+      split = split->right;
+    else if (key_hi && details::compare(get_key(split), *key_hi) >= 0)
+      split = split->left;
+    else
+      break;
+    if (split)
+      scale = childrenScale(split->parent, scale);
+  }
+  return split;
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+template <class Rng>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::sampleBetween(
+    Rng& rng, const Key& key_lo, const Key* key_hi) const -> Node* {
+  Weight scale;
+  Node* const split = findSplit(key_lo, key_hi, scale);
+  if (!split)
+    return nullptr;
+
+  // Weight in the range on the left of the split node, of the node itself, and on its right.
+  const Weight children_scale = childrenScale(split, scale);
+  const Weight left_weight = boundedWeight<false>(split->left, key_lo, children_scale);
+  const Weight own_weight = scale * split->weight;
+  Weight right_weight = 0;
+  if (key_hi)
+    right_weight = boundedWeight<true>(split->right, *key_hi, children_scale);
+  else if (split->right)
+    right_weight = children_scale * split->right->subtree_weight;
+
+  const Weight total = left_weight + own_weight + right_weight;
+  if (!(total > 0))
+    return nullptr;
+  const Weight position = details::randomPosition(rng, total);
+
+  // Due to rounding errors the boundary descents can fall off the range: fall back to the split
+  // node, or to the closest side with weight.
+  Node* result = nullptr;
+  if (position < left_weight)
+    result = findBoundedPosition<false>(split->left, key_lo, position, children_scale);
+  else if (position >= left_weight + own_weight && right_weight > 0)
+    result = key_hi ? findBoundedPosition<true>(split->right, *key_hi,
+                                                position - left_weight - own_weight, children_scale)
+                    : findPosition(split->right, position - left_weight - own_weight,
+                                   children_scale);
+  if (result)
+    return result;
+  if (own_weight > 0)
+    return split;
+  return left_weight > 0 ? findBoundedPosition<false>(split->left, key_lo, 0, children_scale)
+                         : findPosition(split->right, 0, children_scale);
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+template <bool below>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::findBoundedPosition(
+    Node* node, const Key& bound, Weight position, Weight scale) const -> Node* {
+  // Along the boundary path, a node in the range is followed by its subtree on the inner side.
+  // Positions are counted from the inner side, which is a valid ordering of the entries.
+  while (node) {
+    statistics().countDescent();
+    statistics().countComparison();
+    const Weight children_scale = childrenScale(node, scale);
+    const bool in_range = (details::compare(get_key(node), bound) < 0) == below;
+
+    if (in_range) {
+      Node* const inner = below ? node->left : node->right;
+      const Weight inner_weight = inner ? children_scale * inner->subtree_weight : 0;
+      const Weight own_weight = scale * node->weight;
+      if (position < inner_weight)
+        return findPosition(inner, position, children_scale);
+      if (position < inner_weight + own_weight)
+        return node;
+      position -= inner_weight + own_weight;
+    }
+    node = in_range == below ? node->right : node->left;
+    scale = children_scale;
+  }
+  return nullptr;
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+template <bool below>
+Weight SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::boundedWeight(
+    const Node* node, const Key& bound, Weight scale) const noexcept {
+  Weight result = 0;
+  while (node) {
+    statistics().countDescent();
+    statistics().countComparison();
+    const Weight children_scale = childrenScale(node, scale);
+    const bool in_range = (details::compare(get_key(node), bound) < 0) == below;
+
+    if (in_range) {  // The node and its subtree on the inner side are included.
+      const Node* inner = below ? node->left : node->right;
+      result += scale * node->weight;
+      if (inner)
+        result += children_scale * inner->subtree_weight;
+    }
+    node = in_range == below ? node->right : node->left;
+    scale = children_scale;
+  }
+  return result;
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::buildStaticSampler()
+    -> AliasSampler<iterator> {
+  return buildAliasSampler<iterator>();
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::buildStaticSampler()
+    const -> AliasSampler<const_iterator> {
+  return buildAliasSampler<const_iterator>();
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+template <class It>
+AliasSampler<It>
+SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::buildAliasSampler()
+    const {
+  std::vector<It> entries;
+  std::vector<Weight> weights;
+  entries.reserve(size_);
+  weights.reserve(size_);
+  forEachWeighted(root_, 1, [&](const Node* node, const Weight weight) {
+    entries.push_back(It(const_cast<Node*>(node)));
+    weights.push_back(weight);
+  });
+
+  return AliasSampler<It>(std::move(entries), weights);
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+void SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::save(
+    std::ostream& out) const {
+  const auto header = details::makeSnapshotHeader<Key, Value, Weight>(size());
+
+  std::vector<Key> keys;
+  std::vector<Value> values;
+  std::vector<Weight> weights;
+  keys.reserve(size());
+  values.reserve(size());
+  weights.reserve(size());
+
+  forEachWeighted(root_, 1, [&](const Node* node, const Weight weight) {
+    keys.push_back(node->data.first);
+    values.push_back(node->data.second);
+    weights.push_back(weight);
+  });
+
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  details::writeColumn(out, keys);
+  details::writeColumn(out, values);
+  details::writeColumn(out, weights);
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+void SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::load(
+    std::istream& in) {
+  const std::size_t n = details::readSnapshotHeader<Key, Value, Weight>(in);
+
+  const auto keys = details::readColumn<Key>(in, n);
+  const auto values = details::readColumn<Value>(in, n);
+  const auto weights = details::readColumn<Weight>(in, n);
+
+  for (std::size_t i = 1; i < n; ++i) {
+    if (!(keys[i - 1] < keys[i]))
+      throw(std::runtime_error("Snapshot keys are not sorted."));
+  }
+
+  SamplingMap loaded;
+  loaded.root_ = details::buildBalanced<Node>(n, [&](std::size_t i, Node* parent) {
+    return loaded.allocator_.create(keys[i], values[i], weights[i], parent);
+  });
+  loaded.size_ = n;
+
+  *this = std::move(loaded);
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+void SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::compact() {
+  FixedSizeAllocator<Node, chunk_size> new_allocator;
+  root_ = details::relocateBreadthFirst(root_, allocator_, new_allocator);
+  allocator_ = std::move(new_allocator);
+  statistics().clearPoolBaseline();
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+template <class InputIt>
+void SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::setWeights(
+    InputIt first, InputIt last) {
+  std::vector<std::pair<Node*, Weight>> updates;
+  for (; first != last; ++first) {
+    assert(first->first.node_);
+    updates.emplace_back(first->first.node_, first->second);
+  }
+
+  applyWeights(updates);
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+template <class InputIt>
+std::size_t
+SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::setWeightsByKey(
+    InputIt first, InputIt last) {
+  std::vector<std::pair<Node*, Weight>> updates;
+  for (; first != last; ++first) {
+    if (Node* const node = findByKey(first->first).node_)
+      updates.emplace_back(node, first->second);
+  }
+
+  applyWeights(updates);
+  return updates.size();
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+void SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::applyWeights(
+    const std::vector<std::pair<Node*, Weight>>& updates) {
+  std::size_t depth = 1;
+  while ((std::size_t(1) << depth) <= size_)
+    ++depth;
+
+  // The paths to the root overlap in the upper levels: when they cover most of the tree, a single
+  // post-order pass over all the nodes is cheaper than walking each path.
+  if (updates.size() * depth > 2 * size_) {
+    if (scaled_)
+      pushDownAll(root_);
+    setScaled(false);
+    for (const auto& [node, weight] : updates)
+      node->weight = weight;
+    updateAllSubtreeWeights(root_);
+  }
+  else {
+    for (const auto& [node, weight] : updates)
+      iterator(node).setWeight(weight);
+  }
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+void
+SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::updateAllSubtreeWeights(
+    Node* node) {
+  if (!node)
+    return;
+  updateAllSubtreeWeights(node->left);
+  updateAllSubtreeWeights(node->right);
+  node->updateSubtreeWeight();
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+void SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::pushDownAll(
+    Node* node) {
+  if (!node)
+    return;
+  node->pushDown();
+  pushDownAll(node->left);
+  pushDownAll(node->right);
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+void SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::setScaled(
+    const bool scaled) noexcept {
+  if constexpr (Node::scalable) {
+    if (scaled && !scaled_)
+      ++Node::scaled_trees;
+    else if (!scaled && scaled_)
+      --Node::scaled_trees;
+  }
+  scaled_ = scaled;
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+template <class F>
+void SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::forEachWeighted(
+    const Node* node, const Weight scale, F&& f) {
+  if (!node)
+    return;
+  const Weight children_scale = childrenScale(node, scale);
+  forEachWeighted(node->left, children_scale, f);
+  f(node, scale * node->weight);
+  forEachWeighted(node->right, children_scale, f);
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+void SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::scaleAll(
+    const Weight factor) {
+  static_assert(std::is_floating_point_v<Weight>, "Only floating point weights can be scaled.");
+  static_assert(details::allowsScaling<Augmentation, Weight>(),
+                "The augmentation does not support scaling.");
+  assert(factor >= 0);
+  if (root_)
+    root_->scaleSubtree(factor);
+  setScaled(true);
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+void SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::scaleRange(
+    const Key& key_lo, const Key& key_hi, const Weight factor) {
+  static_assert(std::is_floating_point_v<Weight>, "Only floating point weights can be scaled.");
+  static_assert(details::allowsScaling<Augmentation, Weight>(),
+                "The augmentation does not support scaling.");
+  assert(factor >= 0);
+  auto below = [&](const Node* node, const Key& bound) {
+    statistics().countComparison();
+    return details::compare(get_key(node), bound) < 0;
+  };
+
+  // Find the highest node in the range. The ranges of the two boundary paths below it are split.
+  Node* split = root_;
+  while (split) {
+    statistics().countDescent();
+    split->pushDown();
+    if (below(split, key_lo))
+      split = split->right;
+    else if (!below(split, key_hi))
+      split = split->left;
+    else
+      break;
+  }
+  if (!split)  // Empty range.
+    return;
+  split->weight *= factor;
+  setScaled(true);
+
+  // Scales the nodes in the range along a boundary path, with their whole subtree on the inner
+  // side, then recomputes the subtree weights from the bottom of the path up to `split`.
+  auto scale_boundary = [&](Node* node, auto in_range, auto inner_child, auto outer_child) {
+    Node* last = nullptr;
+    while (node) {
+      statistics().countDescent();
+      node->pushDown();
+      last = node;
+      if (in_range(node)) {
+        node->weight *= factor;
+        if (Node* inner = inner_child(node))
+          inner->scaleSubtree(factor);
+        node = outer_child(node);
+      }
+      else {
+        node = inner_child(node);
+      }
+    }
+    for (; last && last != split; last = last->parent)
+      last->updateSubtreeWeight();
+  };
+  auto left = [](Node* node) { return node->left; };
+  auto right = [](Node* node) { return node->right; };
+
+  scale_boundary(split->left, [&](const Node* node) { return !below(node, key_lo); }, right, left);
+  scale_boundary(split->right, [&](const Node* node) { return below(node, key_hi); }, left, right);
+
+  for (Node* node = split; node; node = node->parent)
+    node->updateSubtreeWeight();
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::findByKey(
+    const Key& key) noexcept -> iterator {
+  const details::Trace trace(tracer_, Operation::FIND);
   Node* node = root_;
   while (node) {
+    statistics().countDescent();
+    statistics().countComparison();
     const int comp = details::compare(key, get_key(node));
 
     if (comp == 0)
@@ -411,32 +1724,48 @@ auto SamplingMap<Key, Value, Weight, chunk_size>::findByKey(const Key& key) noex
   return iterator(nullptr);
 }
 
-template <class Key, class Value, class Weight, std::size_t chunk_size>
-auto SamplingMap<Key, Value, Weight, chunk_size>::findByKey(const Key& key) const noexcept
-    -> const_iterator {
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::findByKey(
+    const Key& key) const noexcept -> const_iterator {
   // Avoid code duplication with a cast to non-const (const iterator does not allow data modification).
   return const_iterator(const_cast<SamplingMap&>(*this).findByKey(key));
 }
 
-template <class Key, class Value, class Weight, std::size_t chunk_size>
-bool SamplingMap<Key, Value, Weight, chunk_size>::contains(const Key& key) const noexcept {
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+bool SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::contains(
+    const Key& key) const noexcept {
   return static_cast<bool>(findByKey(key));
 }
 
-template <class Key, class Value, class Weight, std::size_t chunk_size>
-std::vector<std::tuple<Key, Value, Weight>> SamplingMap<Key, Value, Weight, chunk_size>::linearize()
-    const noexcept {
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::linearize() const
+    noexcept -> std::vector<std::tuple<Key, Value, Weight>> {
   std::vector<std::tuple<Key, Value, Weight>> result;
   result.reserve(size());
 
-  for (auto it = begin(); it != end(); ++it)
-    result.emplace_back(it->first, it->second, it.getWeight());
+  forEachWeighted(root_, 1, [&](const Node* node, const Weight weight) {
+    result.emplace_back(node->data.first, node->data.second, weight);
+  });
 
   return result;
 }
 
-template <class Key, class Value, class Weight, std::size_t chunk_size>
-bool SamplingMap<Key, Value, Weight, chunk_size>::checkConsistency() const noexcept {
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+OperationCounters SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::stats()
+    const noexcept {
+  OperationCounters counters = statistics().counters();
+  counters.pool_allocations = statistics().poolsSinceReset(allocator_.poolCount());
+  return counters;
+}
+
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+bool SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::checkConsistency()
+    const noexcept {
   bool child_parent_violation = false;
   bool red_red_violation = false;
   bool black_count_violation = false;
@@ -446,7 +1775,11 @@ bool SamplingMap<Key, Value, Weight, chunk_size>::checkConsistency() const noexc
   std::function<Weight(const Node*)> subtree_weight = [&](const Node* node) -> Weight {
     if (!node)
       return 0;
-    return node->weight + subtree_weight(node->left) + subtree_weight(node->right);
+    const Weight children_weight = subtree_weight(node->left) + subtree_weight(node->right);
+    if constexpr (std::is_floating_point_v<Weight>)
+      return node->weight + node->scale * children_weight;
+    else
+      return node->weight + children_weight;
   };
 
   auto similar = [](Weight a, Weight b) {
@@ -472,6 +1805,11 @@ bool SamplingMap<Key, Value, Weight, chunk_size>::checkConsistency() const noexc
     // Check subtree size
     if (!similar(node->subtree_weight, subtree_weight(node)))
       subtree_weight_violation = true;
+    if constexpr (ranked) {
+      auto size = [](const Node* n) { return n ? n->subtree_size : 0; };
+      if (node->subtree_size != 1 + size(node->left) + size(node->right))
+        subtree_weight_violation = true;
+    }
 
     // Check double red
     auto color = [&](const Node* n) { return n ? n->color : BLACK; };
@@ -494,8 +1832,10 @@ bool SamplingMap<Key, Value, Weight, chunk_size>::checkConsistency() const noexc
          !subtree_weight_violation;
 }
 
-template <class Key, class Value, class Weight, std::size_t chunk_size>
-auto SamplingMap<Key, Value, Weight, chunk_size>::begin() noexcept -> iterator {
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::begin() noexcept
+    -> iterator {
   if (!root_)
     return iterator{nullptr};
 
@@ -506,18 +1846,24 @@ auto SamplingMap<Key, Value, Weight, chunk_size>::begin() noexcept -> iterator {
   return iterator(node);
 }
 
-template <class Key, class Value, class Weight, std::size_t chunk_size>
-auto SamplingMap<Key, Value, Weight, chunk_size>::end() noexcept -> iterator {
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::end() noexcept
+    -> iterator {
   return iterator{nullptr};
 }
 
-template <class Key, class Value, class Weight, std::size_t chunk_size>
-auto SamplingMap<Key, Value, Weight, chunk_size>::begin() const noexcept -> const_iterator {
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::begin() const
+    noexcept -> const_iterator {
   return const_cast<SamplingMap&>(*this).begin();
 }
 
-template <class Key, class Value, class Weight, std::size_t chunk_size>
-auto SamplingMap<Key, Value, Weight, chunk_size>::end() const noexcept -> const_iterator {
+template <class Key, class Value, class Weight, std::size_t chunk_size, bool ranked,
+          class Augmentation, class Stats>
+auto SamplingMap<Key, Value, Weight, chunk_size, ranked, Augmentation, Stats>::end() const noexcept
+    -> const_iterator {
   return iterator{nullptr};
 }
 
@@ -11,8 +11,10 @@
 #pragma once
 
 #include <functional>
+#include <stdexcept>
 
 #include "map_iterator.hpp"
+#include "details/node_operations.hpp"
 
 namespace maplib {
 
@@ -28,32 +30,89 @@ public:
   template <bool other_c>
   SamplingMapIterator(const SamplingMapIterator<Node, other_c>& rhs) : Base(rhs) {}
 
+  // Complexity: O(1), or O(log n) for floating point weights while some container has a pending
+  // scale, to apply the pending scales of the ancestors.
   Weight getWeight() const {
-    return Base::node_->weight;
+    return Base::node_->weight * Base::node_->ancestorsScale();
   }
 
   Weight getSubtreeWeight() const {
-    return Base::node_->subtree_weight;
+    return Base::node_->subtree_weight * Base::node_->ancestorsScale();
   }
 
+  // Returns the summed weight of the entries with a lower key, i.e. the lowest position sampling
+  // this entry. Complexity: O(log n).
+  // Throws std::logic_error if the iterator is null.
+  Weight cumulativeWeight() const;
+
   void setWeight(const Weight weight) {
+    if constexpr (Node::augmented)  // The aggregates are recomputed, not updated by a difference.
+      return setScaledWeight(weight);
+
     const Weight diff = weight - node_->weight;
-    if (diff) {
-      node_->weight = weight;
+    node_->weight = weight;
 
-      auto ancestor = node_;
-      while (ancestor) {
-        ancestor->subtree_weight += diff;
-        ancestor = ancestor->parent;
+    for (auto ancestor = node_; ancestor; ancestor = ancestor->parent) {
+      if constexpr (details::HasPendingScale<Node>::value) {
+        if (ancestor->parent && ancestor->parent->scale != 1)
+          return setScaledWeight(weight);
       }
+      ancestor->subtree_weight += diff;
     }
   }
 
-  template <class K, class V, class W, std::size_t s>
+  template <class K, class V, class W, std::size_t s, bool r, class A, class St>
   friend class SamplingMap;
+  template <class K, class V, class W>
+  friend class SharedSamplingMap;
 
 private:
   using Base::node_;
+
+  // Returns the pending scale of the descendants of `node`, if supported by the node type.
+  static Weight pendingScale(const Node* node) {
+    if constexpr (details::HasPendingScale<Node>::value)
+      return node->scale;
+    else
+      return 1;
+  }
+
+  // Slow path of setWeight, for a node below a pending scale or with an aggregate: applies the
+  // scales of the ancestors, then recomputes the subtree weights on the path to the root.
+  void setScaledWeight(const Weight weight) {
+    node_->pushDownFromRoot();
+    node_->weight = weight;
+    for (auto ancestor = node_; ancestor; ancestor = ancestor->parent)
+      ancestor->updateSubtreeWeight();
+  }
 };
 
+template <class Node, bool is_const>
+auto SamplingMapIterator<Node, is_const>::cumulativeWeight() const -> Weight {
+  if (!node_)
+    throw(std::logic_error("Null iterator has no cumulative weight."));
+
+  // The sum is expressed in units of the stored weights of the current node, and rescaled at each
+  // step up.
+  const Node* node = node_;
+  Weight result = 0;
+  if (node->left)
+    result += pendingScale(node) * node->left->subtree_weight;
+
+  const Node* parent;
+  while ((parent = node->parent)) {
+    // If the node is a right child, add the parent and its left subtree.
+    Weight left_weight = 0;
+    if (parent->right == node && parent->left)
+      left_weight = parent->left->subtree_weight;
+    result = pendingScale(parent) * (result + left_weight);
+    if (parent->right == node)
+      result += parent->weight;
+
+    node = parent;
+  }
+
+  return result;
+}
+
 }  // namespace maplib
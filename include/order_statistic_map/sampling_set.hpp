@@ -13,21 +13,26 @@
 
 #pragma once
 
+#include <iterator>
+#include <vector>
+
 #include "sampling_map.hpp"
 
 namespace maplib {
 
 // Precondition: elements of type Key have full order.
-template <class Key, class Weight, std::size_t chunk_size = 64>
+template <class Key, class Weight, std::size_t chunk_size = 64, class Stats = NoStatistics>
 class SamplingSet {
 private:
   struct Null {
     Null() = default;
   };
+  using Map = SamplingMap<Key, Null, Weight, chunk_size, false, void, Stats>;
 
 public:
   using Node = details::WeightedNode<Key, Null, Weight>;
   using const_iterator = SamplingMapIterator<Node, true>;
+  using statistics_type = Stats;
 
   SamplingSet() = default;
   SamplingSet(const std::initializer_list<std::pair<Key, Weight>>& list);
@@ -59,10 +64,36 @@ public:
     return insert(values.first, values.second);
   }
 
+  // Insert new key, or replace its weight if already present. Returns true if the key is inserted.
+  bool insertOrAssign(const Key& key, const Weight& weight) noexcept {
+    return map_.insertOrAssign(key, {}, weight).second;
+  }
+
   // Remove the node relative to key.
   // Returns: true if the key is found and removed. False if no operation is performed.
   bool erase(const Key& key) noexcept;
 
+  // Multiplies all the weights by `factor` in O(1). See SamplingMap::scaleAll.
+  void scaleAll(Weight factor) {
+    map_.scaleAll(factor);
+  }
+
+  // Multiplies the weights of the keys in [key_lo, key_hi) by `factor` in O(log n).
+  // See SamplingMap::scaleRange.
+  void scaleRange(const Key& key_lo, const Key& key_hi, Weight factor) {
+    map_.scaleRange(key_lo, key_hi, factor);
+  }
+
+  // Returns the summed weight of the keys lower than `key`. See SamplingMap::cumulativeWeight.
+  Weight cumulativeWeight(const Key& key) const noexcept {
+    return map_.cumulativeWeight(key);
+  }
+
+  // Returns the summed weight of the keys in [key_lo, key_hi). See SamplingMap::weightBetween.
+  Weight weightBetween(const Key& key_lo, const Key& key_hi) const noexcept {
+    return map_.weightBetween(key_lo, key_hi);
+  }
+
   // Returns true if a stored key compares equal to the argument.
   bool contains(const Key& key) const noexcept {
     return map_.contains(key);
@@ -82,6 +113,31 @@ public:
   // entry, otherwise it results in the null iterator.
   const Key& sample(Weight position) const;
 
+  // Returns a key in [key_lo, key_hi) sampled with probability proportional to its weight, in
+  // O(log n). Throws std::out_of_range if the range has no weight.
+  template <class Rng>
+  const Key& sampleInRange(Rng& rng, const Key& key_lo, const Key& key_hi) const;
+
+  // Writes the key sampled at each position in [first, last), in a single traversal.
+  // Precondition: the positions are sorted in ascending order.
+  // Throws std::out_of_range if a position is outside the set range.
+  template <class PositionIt, class OutputIt>
+  OutputIt sample(PositionIt first, PositionIt last, OutputIt out) const;
+
+  // Writes `k` keys sampled independently with probability proportional to their weight, in
+  // ascending order. See SamplingMap::sampleBatch.
+  template <class Rng, class OutputIt>
+  OutputIt sampleBatch(Rng& rng, std::size_t k, OutputIt out) const;
+
+  // Writes up to `k` distinct keys sampled proportionally to their weight, leaving the set
+  // unchanged. See SamplingMap::sampleWithoutReplacement.
+  template <class Rng, class OutputIt>
+  OutputIt sampleWithoutReplacement(Rng& rng, std::size_t k, OutputIt out) const;
+
+  // Returns an alias table over the current keys, sampling a key in O(1). The keys are copied, and
+  // the sampler is not updated by later changes to the set. See SamplingMap::buildStaticSampler.
+  AliasSampler<Key> buildStaticSampler() const;
+
   // Sample from a value scaled in [0, 1].
   const Key& sampleScaled(double position) const {
     return sample(position * totalWeight());
@@ -90,6 +146,32 @@ public:
   // Returns an array of ordered keys and value pairs.
   std::vector<std::pair<Key, Weight>> linearize() const noexcept;
 
+  // Binary snapshot of the content. See SamplingMap::save and SamplingMap::load.
+  void save(std::ostream& out) const {
+    map_.save(out);
+  }
+  void load(std::istream& in) {
+    map_.load(in);
+  }
+
+  // Relocates the keys in contiguous memory. See SamplingMap::compact.
+  void compact() {
+    map_.compact();
+  }
+
+  // Counters of the work performed. See SamplingMap::stats.
+  OperationCounters stats() const noexcept {
+    return map_.stats();
+  }
+  void resetStats() noexcept {
+    map_.resetStats();
+  }
+
+  // Records the latency of each operation. See SamplingMap::setTracer.
+  void setTracer(LatencyTracer* tracer) noexcept {
+    map_.setTracer(tracer);
+  }
+
   std::size_t size() const noexcept {
     return map_.size();
   }
@@ -104,59 +186,127 @@ public:
   }
 
 private:
-  SamplingMap<Key, Null, Weight> map_;
+  Map map_;
 };
 
-template <class Key, class Weight, std::size_t chunk_size>
-SamplingSet<Key, Weight, chunk_size>::SamplingSet(
+template <class Key, class Weight, std::size_t chunk_size, class Stats>
+SamplingSet<Key, Weight, chunk_size, Stats>::SamplingSet(
     const std::initializer_list<std::pair<Key, Weight>>& list) {
   for (const auto& elem : list)
     insert(elem);
 }
 
-template <class Key, class Weight, std::size_t chunk_size>
-SamplingSet<Key, Weight, chunk_size>::SamplingSet(const std::vector<std::pair<Key, Weight>>& linearized) {
+template <class Key, class Weight, std::size_t chunk_size, class Stats>
+SamplingSet<Key, Weight, chunk_size, Stats>::SamplingSet(
+    const std::vector<std::pair<Key, Weight>>& linearized) {
   for (const auto& elem : linearized)
     insert(elem);
 }
 
-template <class Key, class Weight, std::size_t chunk_size>
-bool SamplingSet<Key, Weight, chunk_size>::insert(const Key& key, const Weight& weight) noexcept {
+template <class Key, class Weight, std::size_t chunk_size, class Stats>
+bool SamplingSet<Key, Weight, chunk_size, Stats>::insert(const Key& key,
+                                                         const Weight& weight) noexcept {
   auto [it, inserted] = map_.insert(key, {}, weight);
   return inserted;
 }
 
-template <class Key, class Weight, std::size_t chunk_size>
-bool SamplingSet<Key, Weight, chunk_size>::erase(const Key& key) noexcept {
+template <class Key, class Weight, std::size_t chunk_size, class Stats>
+bool SamplingSet<Key, Weight, chunk_size, Stats>::erase(const Key& key) noexcept {
   return map_.erase(key);
 }
 
-template <class Key, class Weight, std::size_t chunk_size>
+template <class Key, class Weight, std::size_t chunk_size, class Stats>
 template <class Rng>
-const Key& SamplingSet<Key, Weight, chunk_size>::sample(Rng& rng) const {
+const Key& SamplingSet<Key, Weight, chunk_size, Stats>::sample(Rng& rng) const {
   auto it = map_.sample(rng);
   if (it == map_.end())
     throw(std::out_of_range("Sampling out of the set range."));
   return it->first;
 }
 
-template <class Key, class Weight, std::size_t chunk_size>
-const Key& SamplingSet<Key, Weight, chunk_size>::sample(const Weight position) const {
+template <class Key, class Weight, std::size_t chunk_size, class Stats>
+const Key& SamplingSet<Key, Weight, chunk_size, Stats>::sample(const Weight position) const {
   auto it = map_.sample(position);
   if (it == map_.end())
     throw(std::out_of_range("Sampling out of the set range."));
   return it->first;
 }
 
-template <class Key, class Weight, std::size_t chunk_size>
-std::vector<std::pair<Key, Weight>> SamplingSet<Key, Weight, chunk_size>::linearize() const noexcept {
+template <class Key, class Weight, std::size_t chunk_size, class Stats>
+template <class Rng>
+const Key& SamplingSet<Key, Weight, chunk_size, Stats>::sampleInRange(Rng& rng, const Key& key_lo,
+                                                               const Key& key_hi) const {
+  auto it = map_.sampleInRange(rng, key_lo, key_hi);
+  if (it == map_.end())
+    throw(std::out_of_range("Sampling out of the set range."));
+  return it->first;
+}
+
+template <class Key, class Weight, std::size_t chunk_size, class Stats>
+template <class PositionIt, class OutputIt>
+OutputIt SamplingSet<Key, Weight, chunk_size, Stats>::sample(PositionIt first, PositionIt last,
+                                                      OutputIt out) const {
+  std::vector<typename Map::const_iterator> samples;
+  map_.sample(first, last, std::back_inserter(samples));
+  for (const auto& it : samples) {
+    if (it == map_.end())
+      throw(std::out_of_range("Sampling out of the set range."));
+    *out++ = it->first;
+  }
+  return out;
+}
+
+template <class Key, class Weight, std::size_t chunk_size, class Stats>
+template <class Rng, class OutputIt>
+OutputIt SamplingSet<Key, Weight, chunk_size, Stats>::sampleBatch(Rng& rng, const std::size_t k,
+                                                           OutputIt out) const {
+  std::vector<typename Map::const_iterator> samples;
+  samples.reserve(k);
+  map_.sampleBatch(rng, k, std::back_inserter(samples));
+  for (const auto& it : samples) {
+    if (it == map_.end())
+      throw(std::out_of_range("Sampling out of the set range."));
+    *out++ = it->first;
+  }
+  return out;
+}
+
+template <class Key, class Weight, std::size_t chunk_size, class Stats>
+std::vector<std::pair<Key, Weight>> SamplingSet<Key, Weight, chunk_size, Stats>::linearize() const
+    noexcept {
   std::vector<std::pair<Key, Weight>> result;
   result.reserve(size());
 
-  for (auto it = begin(); it != end(); ++it)
-    result.emplace_back(it->first, it.getWeight());
+  for (const auto& [key, value, weight] : map_.linearize())
+    result.emplace_back(key, weight);
 
   return result;
 }
 
+template <class Key, class Weight, std::size_t chunk_size, class Stats>
+template <class Rng, class OutputIt>
+OutputIt SamplingSet<Key, Weight, chunk_size, Stats>::sampleWithoutReplacement(Rng& rng,
+                                                                        const std::size_t k,
+                                                                        OutputIt out) const {
+  std::vector<typename Map::const_iterator> samples;
+  map_.sampleWithoutReplacement(rng, k, std::back_inserter(samples));
+  for (const auto& it : samples)
+    *out++ = it->first;
+  return out;
+}
+
+template <class Key, class Weight, std::size_t chunk_size, class Stats>
+AliasSampler<Key> SamplingSet<Key, Weight, chunk_size, Stats>::buildStaticSampler() const {
+  std::vector<Key> keys;
+  std::vector<Weight> weights;
+  keys.reserve(size());
+  weights.reserve(size());
+  for (const auto& [key, value, weight] : map_.linearize()) {
+    keys.push_back(key);
+    weights.push_back(weight);
+  }
+
+  return AliasSampler<Key>(std::move(keys), weights);
+}
+
 }  // namespace maplib
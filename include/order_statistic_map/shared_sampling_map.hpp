@@ -0,0 +1,683 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Provides a SamplingMap stored in a POSIX shared memory segment, written by a single process and
+// read concurrently by any number of other processes without copies.
+// Nodes are linked through self-relative offsets, so that each process can map the segment at a
+// different address. Every modification is enclosed in a sequence lock: readers copy the result out
+// of the segment and retry if the writer was active in the meantime.
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "sampling_map_iterator.hpp"
+#include "details/compare.hpp"
+#include "details/mapped_storage.hpp"
+#include "details/node_operations.hpp"
+#include "details/offset_weighted_node.hpp"
+#include "details/random_position.hpp"
+
+namespace maplib {
+namespace details {
+
+template <class Node>
+struct SharedMapHeader {
+  static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+                "A process shared sequence lock requires lock free atomics.");
+
+  // Odd while the writer is modifying the tree.
+  std::atomic<std::uint64_t> sequence{0};
+  OffsetPtr<Node> root;
+};
+
+// Descents shared by the writer and the readers of a SharedSamplingMap. A reader racing with the
+// writer can follow a torn link: `valid(node)` guards every dereference, and the depth is bounded
+// by the maximum height of a red-black tree. They return false if the descent was aborted.
+constexpr int max_shared_tree_depth = 2 * 64;
+
+template <class Node, class Key, class Valid>
+bool findSharedNode(const Node* node, const Key& key, Valid&& valid, const Node*& result) {
+  result = nullptr;
+  for (int depth = 0; node; ++depth) {
+    if (!valid(node) || depth == max_shared_tree_depth)
+      return false;
+
+    const int comp = compare(key, get_key(node));
+    if (comp == 0)
+      break;
+    node = comp < 0 ? node->left.get() : node->right.get();
+  }
+
+  result = node;
+  return true;
+}
+
+template <class Node, class Valid>
+bool findSharedNodeByIndex(const Node* node, std::size_t index, Valid&& valid, const Node*& result) {
+  result = nullptr;
+  if (!node)
+    return true;
+  if (!valid(node))
+    return false;
+  if (index >= node->subtree_size)  // Out of range.
+    return true;
+
+  std::size_t on_the_left = 0;
+  for (int depth = 0; depth < max_shared_tree_depth; ++depth) {
+    if (!node || !valid(node))
+      return false;
+
+    const Node* left = node->left;
+    auto new_on_the_left = on_the_left;
+    if (left) {
+      if (!valid(left))
+        return false;
+      new_on_the_left += left->subtree_size;
+    }
+
+    if (new_on_the_left == index) {
+      result = node;
+      return true;
+    }
+    else if (new_on_the_left > index) {  // go left
+      node = left;
+    }
+    else {  // go right
+      on_the_left = new_on_the_left + 1;
+      node = node->right;
+    }
+  }
+
+  return false;
+}
+
+// See SamplingMap::sample(Weight position).
+template <class Node, class Weight, class Valid>
+bool sampleSharedNode(const Node* node, const Weight position, Valid&& valid, const Node*& result) {
+  result = nullptr;
+  if (!node)
+    return true;
+  if (!valid(node))
+    return false;
+
+  const Weight total = node->subtree_weight;
+  if (!total || position < 0 || position > total ||
+      (std::is_integral_v<Weight> && position == total)) {  // Out of range.
+    return true;
+  }
+
+  Weight on_the_left(0);
+  for (int depth = 0; depth < max_shared_tree_depth; ++depth) {
+    if (!node || !valid(node))
+      return false;
+
+    const Node* left = node->left;
+    auto new_on_the_left = on_the_left;
+    if (left) {
+      if (!valid(left))
+        return false;
+      new_on_the_left += left->subtree_weight;
+    }
+
+    if (position >= new_on_the_left && position < new_on_the_left + node->weight) {
+      result = node;
+      return true;
+    }
+    else if (position < new_on_the_left) {  // go left
+      node = left;
+    }
+    else {  // go right
+      if constexpr (std::is_floating_point_v<Weight>) {
+        if (!node->right) {  // Due to numerical issues the sample could be right at the edge.
+          result = node;
+          return true;
+        }
+      }
+
+      on_the_left = new_on_the_left + node->weight;
+      node = node->right;
+    }
+  }
+
+  return false;
+}
+
+inline int openSharedMemory(const std::string& name, int flags) {
+  const int fd = shm_open(name.c_str(), flags, 0600);
+  if (fd < 0)
+    throw(std::system_error(errno, std::generic_category(), "shm_open " + name));
+  return fd;
+}
+
+}  // namespace details
+
+// Writer side. Only one process at a time may modify a given segment.
+// Precondition: elements of type Key have full order. Key, Value and Weight are trivially copyable.
+template <class Key, class Value, class Weight>
+class SharedSamplingMap {
+public:
+  using Node = details::OffsetWeightedNode<Key, Value, Weight>;
+  using const_iterator = SamplingMapIterator<Node, true>;
+
+  // Creates the shared memory segment `name` (e.g. "/my_map") with room for `capacity` elements,
+  // or reopens it if it already exists. The capacity is fixed, as the readers map the segment once.
+  // Throws std::system_error if the segment can not be opened or mapped, and std::runtime_error
+  // if it contains a map of a different type.
+  SharedSamplingMap(const std::string& name, std::size_t capacity);
+
+  SharedSamplingMap(const SharedSamplingMap& rhs) = delete;
+  SharedSamplingMap& operator=(const SharedSamplingMap& rhs) = delete;
+
+  // Removes the segment name. Processes that mapped the segment keep their access to it.
+  static void remove(const std::string& name) {
+    shm_unlink(name.c_str());
+  }
+
+  auto begin() const noexcept -> const_iterator;
+  auto end() const noexcept -> const_iterator {
+    return const_iterator(nullptr);
+  }
+
+  // Insert new key, value pair if key is not already present, and returns an iterator to the node
+  // and true.
+  // If the key is already present, update the value and returns an iterator to the node and false.
+  // Throws std::length_error if the segment is full.
+  auto insert(const Key& key, const Value& value, const Weight& weight)
+      -> std::pair<const_iterator, bool>;
+
+  // Remove the node relative to key.
+  // Returns: true if the key is found and removed. False if no operation is performed.
+  bool erase(const Key& key) noexcept;
+
+  // Changes the weight associated with key. Returns false if the key is not present.
+  bool setWeight(const Key& key, Weight weight) noexcept;
+
+  // Read access. As the writer is the only process modifying the tree, no lock is needed.
+  auto findByKey(const Key& key) const noexcept -> const_iterator;
+  // Precondition: 0 <= index < size()
+  auto findByIndex(std::size_t index) const -> const_iterator;
+  template <class Rng>
+  auto sample(Rng& rng) const noexcept -> const_iterator {
+    return sample(details::randomPosition(rng, totalWeight()));
+  }
+  auto sample(Weight position) const noexcept -> const_iterator;
+
+  std::size_t size() const noexcept {
+    return root() ? root()->subtree_size : 0;
+  }
+  Weight totalWeight() const noexcept {
+    return root() ? root()->subtree_weight : 0;
+  }
+
+  // Returns an array of ordered keys, values and weights.
+  std::vector<std::tuple<Key, Value, Weight>> linearize() const noexcept;
+
+  // For testing purposes.
+  bool checkConsistency() const noexcept;
+
+private:
+  constexpr static auto BLACK = details::BLACK;
+  constexpr static auto RED = details::RED;
+
+  using Header = details::SharedMapHeader<Node>;
+
+  Node* root() const noexcept {
+    return const_cast<Header&>(storage_.header()).root;
+  }
+
+  // Marks the beginning and end of a modification for the readers.
+  void beginWrite() noexcept;
+  void endWrite() noexcept;
+
+  // Allocates the new leaf of an insertion below `parent`. If the segment is full, undoes the
+  // updates of the subtree weights and sizes from `parent` up, ends the write and throws.
+  Node* createLeaf(const Key& key, const Value& val, const Weight& weight, Node* parent);
+
+  // Members
+  details::MappedStorage<Node, Header> storage_;
+};
+
+// Reader side. Any number of readers, in any process, can run concurrently with the writer.
+// Results are returned by copy, as the tree can change as soon as the read is complete.
+// Precondition: the segment has been created by a SharedSamplingMap with the same template
+// arguments.
+template <class Key, class Value, class Weight>
+class SharedSamplingMapReader {
+public:
+  using Node = details::OffsetWeightedNode<Key, Value, Weight>;
+  using Entry = std::tuple<Key, Value, Weight>;
+
+  explicit SharedSamplingMapReader(const std::string& name);
+
+  // Returns an entry sampled with probability proportional to its weight, or nothing if the map
+  // is empty.
+  template <class Rng>
+  std::optional<Entry> sample(Rng& rng) const;
+
+  // See SamplingMap::sample(Weight position).
+  std::optional<Entry> sample(Weight position) const;
+
+  // Returns the entry associated with key, if present.
+  std::optional<Entry> findByKey(const Key& key) const;
+
+  // Returns the entry associated with the 'index'-th lowest key, if index < size().
+  std::optional<Entry> findByIndex(std::size_t index) const;
+
+  std::size_t size() const;
+  Weight totalWeight() const;
+
+private:
+  using Header = details::SharedMapHeader<Node>;
+
+  // Runs `attempt` until it succeeds while no modification takes place.
+  // `attempt` returns a pair of success flag and result.
+  template <class Attempt>
+  auto read(Attempt&& attempt) const;
+
+  // Copies the result of a descent out of the segment.
+  std::pair<bool, std::optional<Entry>> copy(bool success, const Node* node) const;
+
+  const Node* root() const noexcept {
+    return storage_.header().root;
+  }
+  bool valid(const Node* node) const noexcept {
+    return storage_.contains(node);
+  }
+
+  details::MappedStorage<Node, Header> storage_;
+};
+
+template <class Key, class Value, class Weight>
+SharedSamplingMap<Key, Value, Weight>::SharedSamplingMap(const std::string& name,
+                                                         std::size_t capacity)
+    : storage_(details::openSharedMemory(name, O_RDWR | O_CREAT), capacity, false) {
+  static_assert(std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<Value> &&
+                    std::is_trivially_copyable_v<Weight>,
+                "Only trivially copyable types can be shared.");
+}
+
+template <class Key, class Value, class Weight>
+void SharedSamplingMap<Key, Value, Weight>::beginWrite() noexcept {
+  auto& sequence = storage_.header().sequence;
+  sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+template <class Key, class Value, class Weight>
+void SharedSamplingMap<Key, Value, Weight>::endWrite() noexcept {
+  auto& sequence = storage_.header().sequence;
+  sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+template <class Key, class Value, class Weight>
+auto SharedSamplingMap<Key, Value, Weight>::insert(const Key& key, const Value& val,
+                                                   const Weight& weight)
+    -> std::pair<const_iterator, bool> {
+  // The segment is not growable: reserving never remaps it, and throws only if it is full.
+  Node* root = this->root();
+  if (!root) {
+    storage_.reserve(1);
+    beginWrite();
+    root = storage_.create(key, val, weight, nullptr);
+    root->color = BLACK;
+    storage_.header().root = root;
+    endWrite();
+    return {const_iterator(root), true};
+  }
+
+  beginWrite();
+  Node* node = root;
+  bool done = false;
+
+  while (!done) {
+    const int comp = details::compare(key, get_key(node));
+
+    if (comp == 0) {  // Key is already present. Undo changes and return.
+      node->data.second = val;
+      const_iterator return_it(node);
+
+      node = node->parent;
+      while (node) {
+        node->subtree_weight -= weight;
+        --node->subtree_size;
+        node = node->parent;
+      }
+
+      endWrite();
+      return {return_it, false};
+    }
+    node->subtree_weight += weight;
+    ++node->subtree_size;
+
+    if (comp < 0) {
+      if (node->left == nullptr) {
+        node->left = createLeaf(key, val, weight, node);
+        done = true;
+      }
+      node = node->left;
+    }
+    else {
+      if (node->right == nullptr) {
+        node->right = createLeaf(key, val, weight, node);
+        done = true;
+      }
+      node = node->right;
+    }
+  }
+
+  // Check colors
+  details::fixRedRed(node, root);
+  storage_.header().root = root;
+
+  endWrite();
+  return {const_iterator(node), true};
+}
+
+template <class Key, class Value, class Weight>
+auto SharedSamplingMap<Key, Value, Weight>::createLeaf(const Key& key, const Value& val,
+                                                       const Weight& weight, Node* parent)
+    -> Node* {
+  try {
+    storage_.reserve(1);
+  }
+  catch (...) {
+    for (Node* node = parent; node; node = node->parent) {
+      node->subtree_weight -= weight;
+      --node->subtree_size;
+    }
+    endWrite();
+    throw;
+  }
+
+  return storage_.create(key, val, weight, parent);
+}
+
+template <class Key, class Value, class Weight>
+bool SharedSamplingMap<Key, Value, Weight>::erase(const Key& key) noexcept {
+  Node* to_delete = const_cast<Node*>(findByKey(key).node_);
+  if (!to_delete)
+    return false;
+
+  beginWrite();
+  Node* root = this->root();
+
+  if (to_delete->left != nullptr && to_delete->right != nullptr) {  // to_delete has two children.
+    Node* const original = to_delete;
+    to_delete = to_delete->right;
+    while (to_delete->left) {
+      to_delete = to_delete->left;
+    }
+
+    details::swap(original, to_delete, root);
+    to_delete = original;
+  }
+
+  // Remove the node's contribution from itself and its ancestors, before the rotations visit them.
+  to_delete->weight = 0;
+  to_delete->updateSubtreeWeight();
+  --to_delete->subtree_size;
+  for (Node* ancestor = to_delete->parent; ancestor; ancestor = ancestor->parent)
+    ancestor->updateSubtreeWeight();
+
+  details::removeNoDoubleChild(to_delete, root);
+  storage_.header().root = root;
+  storage_.destroy(to_delete);
+
+  endWrite();
+  return true;
+}
+
+template <class Key, class Value, class Weight>
+bool SharedSamplingMap<Key, Value, Weight>::setWeight(const Key& key, const Weight weight) noexcept {
+  Node* node = const_cast<Node*>(findByKey(key).node_);
+  if (!node)
+    return false;
+
+  const Weight diff = weight - node->weight;
+  if (diff) {
+    beginWrite();
+    node->weight = weight;
+    for (Node* ancestor = node; ancestor; ancestor = ancestor->parent)
+      ancestor->subtree_weight += diff;
+    endWrite();
+  }
+
+  return true;
+}
+
+template <class Key, class Value, class Weight>
+auto SharedSamplingMap<Key, Value, Weight>::findByKey(const Key& key) const noexcept
+    -> const_iterator {
+  const Node* result = nullptr;
+  details::findSharedNode(root(), key, [](const Node*) { return true; }, result);
+  return const_iterator(result);
+}
+
+template <class Key, class Value, class Weight>
+auto SharedSamplingMap<Key, Value, Weight>::findByIndex(const std::size_t index) const
+    -> const_iterator {
+  if (index >= size())
+    throw(std::out_of_range("Index out of range"));
+
+  const Node* result = nullptr;
+  details::findSharedNodeByIndex(root(), index, [](const Node*) { return true; }, result);
+  return const_iterator(result);
+}
+
+template <class Key, class Value, class Weight>
+auto SharedSamplingMap<Key, Value, Weight>::sample(const Weight position) const noexcept
+    -> const_iterator {
+  const Node* result = nullptr;
+  details::sampleSharedNode(root(), position, [](const Node*) { return true; }, result);
+  return const_iterator(result);
+}
+
+template <class Key, class Value, class Weight>
+auto SharedSamplingMap<Key, Value, Weight>::begin() const noexcept -> const_iterator {
+  const Node* node = root();
+  if (!node)
+    return end();
+
+  while (node->left)
+    node = node->left;
+
+  return const_iterator(node);
+}
+
+template <class Key, class Value, class Weight>
+std::vector<std::tuple<Key, Value, Weight>> SharedSamplingMap<Key, Value, Weight>::linearize() const
+    noexcept {
+  std::vector<std::tuple<Key, Value, Weight>> result;
+  result.reserve(size());
+
+  for (auto it = begin(); it != end(); ++it)
+    result.emplace_back(it->first, it->second, it.getWeight());
+
+  return result;
+}
+
+template <class Key, class Value, class Weight>
+bool SharedSamplingMap<Key, Value, Weight>::checkConsistency() const noexcept {
+  bool child_parent_violation = false;
+  bool red_red_violation = false;
+  bool black_count_violation = false;
+  bool subtree_violation = false;
+
+  auto similar = [](Weight a, Weight b) {
+    if constexpr (std::is_floating_point_v<Weight>) {
+      return std::abs(a - b) <= std::numeric_limits<Weight>::epsilon() * 100 * std::abs(a);
+    }
+    else {
+      return a == b;
+    }
+  };
+
+  // Check node consistency and returns the number of black nodes in [node, leaves].
+  std::function<int(const Node*)> check = [&](const Node* node) {
+    if (node == nullptr)
+      return 1;
+
+    // Check parent-child relationship.
+    if (node->left && node->left->parent != node)
+      child_parent_violation = true;
+    if (node->right && node->right->parent != node)
+      child_parent_violation = true;
+
+    // Check subtree size and weight.
+    std::size_t size = 1;
+    Weight weight = node->weight;
+    for (const Node* child : {node->left.get(), node->right.get()}) {
+      if (child) {
+        size += child->subtree_size;
+        weight += child->subtree_weight;
+      }
+    }
+    if (size != node->subtree_size || !similar(weight, node->subtree_weight))
+      subtree_violation = true;
+
+    // Check double red
+    auto color = [&](const Node* n) { return n ? n->color : BLACK; };
+    if (node->color == RED && (color(node->left) == RED || color(node->right) == RED))
+      red_red_violation = true;
+
+    // Check black count
+    int count_left = check(node->left);
+    int count_right = check(node->right);
+
+    if (count_left != count_right)
+      black_count_violation = true;
+
+    return count_left + (node->color == BLACK ? 1 : 0);
+  };
+
+  check(root());
+
+  return !black_count_violation && !red_red_violation && !child_parent_violation &&
+         !subtree_violation;
+}
+
+template <class Key, class Value, class Weight>
+SharedSamplingMapReader<Key, Value, Weight>::SharedSamplingMapReader(const std::string& name)
+    : storage_(details::openSharedMemory(name, O_RDONLY), 0, false, true) {}
+
+template <class Key, class Value, class Weight>
+template <class Attempt>
+auto SharedSamplingMapReader<Key, Value, Weight>::read(Attempt&& attempt) const {
+  const auto& sequence = storage_.header().sequence;
+
+  while (true) {
+    const std::uint64_t start = sequence.load(std::memory_order_acquire);
+    if (!(start & 1)) {
+      auto [success, result] = attempt();
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (success && sequence.load(std::memory_order_relaxed) == start)
+        return result;
+    }
+    std::this_thread::yield();
+  }
+}
+
+template <class Key, class Value, class Weight>
+auto SharedSamplingMapReader<Key, Value, Weight>::copy(bool success, const Node* node) const
+    -> std::pair<bool, std::optional<Entry>> {
+  if (!success || !node)
+    return {success, std::nullopt};
+  return {true, Entry(node->data.first, node->data.second, node->weight)};
+}
+
+template <class Key, class Value, class Weight>
+template <class Rng>
+auto SharedSamplingMapReader<Key, Value, Weight>::sample(Rng& rng) const -> std::optional<Entry> {
+  return read([&] {
+    const Node* node = root();
+    if (node && !valid(node))
+      return copy(false, nullptr);
+
+    const Weight position = details::randomPosition(rng, node ? node->subtree_weight : Weight(0));
+    const bool success =
+        details::sampleSharedNode(node, position, [&](const Node* n) { return valid(n); }, node);
+    return copy(success, node);
+  });
+}
+
+template <class Key, class Value, class Weight>
+auto SharedSamplingMapReader<Key, Value, Weight>::sample(const Weight position) const
+    -> std::optional<Entry> {
+  return read([&] {
+    const Node* node;
+    const bool success =
+        details::sampleSharedNode(root(), position, [&](const Node* n) { return valid(n); }, node);
+    return copy(success, node);
+  });
+}
+
+template <class Key, class Value, class Weight>
+auto SharedSamplingMapReader<Key, Value, Weight>::findByKey(const Key& key) const
+    -> std::optional<Entry> {
+  return read([&] {
+    const Node* node;
+    const bool success =
+        details::findSharedNode(root(), key, [&](const Node* n) { return valid(n); }, node);
+    return copy(success, node);
+  });
+}
+
+template <class Key, class Value, class Weight>
+auto SharedSamplingMapReader<Key, Value, Weight>::findByIndex(const std::size_t index) const
+    -> std::optional<Entry> {
+  return read([&] {
+    const Node* node;
+    const bool success =
+        details::findSharedNodeByIndex(root(), index, [&](const Node* n) { return valid(n); }, node);
+    return copy(success, node);
+  });
+}
+
+template <class Key, class Value, class Weight>
+std::size_t SharedSamplingMapReader<Key, Value, Weight>::size() const {
+  return read([&] {
+    const Node* node = root();
+    if (!node)
+      return std::make_pair(true, std::size_t(0));
+    if (!valid(node))
+      return std::make_pair(false, std::size_t(0));
+    return std::make_pair(true, node->subtree_size);
+  });
+}
+
+template <class Key, class Value, class Weight>
+Weight SharedSamplingMapReader<Key, Value, Weight>::totalWeight() const {
+  return read([&] {
+    const Node* node = root();
+    if (!node)
+      return std::make_pair(true, Weight(0));
+    if (!valid(node))
+      return std::make_pair(false, Weight(0));
+    return std::make_pair(true, node->subtree_weight);
+  });
+}
+
+}  // namespace maplib
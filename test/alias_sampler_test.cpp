@@ -0,0 +1,112 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Test for the AliasSampler class and the static samplers of the sampling containers.
+
+#include "order_statistic_map/alias_sampler.hpp"
+
+#include <cmath>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "order_statistic_map/sampling_map.hpp"
+#include "order_statistic_map/sampling_set.hpp"
+
+#include "gtest/gtest.h"
+
+TEST(AliasSamplerTest, Distribution) {
+  std::mt19937_64 rng(0);
+  std::uniform_real_distribution<double> distro(0, 1);
+
+  std::vector<int> entries;
+  std::vector<double> weights;
+  double total = 0;
+  for (int i = 0; i < 100; ++i) {
+    entries.push_back(i);
+    weights.push_back(i % 5 ? distro(rng) : 0.);
+    total += weights.back();
+  }
+
+  const maplib::AliasSampler<int> sampler(entries, weights);
+  EXPECT_EQ(80, sampler.size());
+
+  const int n_samples = 1000000;
+  std::vector<int> counts(entries.size(), 0);
+  for (int i = 0; i < n_samples; ++i)
+    ++counts[sampler.sample(rng)];
+
+  for (std::size_t i = 0; i < entries.size(); ++i) {
+    const double expected = n_samples * weights[i] / total;
+    EXPECT_NEAR(counts[i], expected, 5 * std::sqrt(expected) + 1e-9);
+  }
+}
+
+TEST(AliasSamplerTest, InvalidInput) {
+  using Sampler = maplib::AliasSampler<std::string>;
+  EXPECT_THROW(Sampler({"a", "b"}, std::vector<int>{1}), std::invalid_argument);
+  EXPECT_THROW(Sampler({"a", "b"}, std::vector<int>{1, -1}), std::invalid_argument);
+
+  EXPECT_TRUE(Sampler().empty());
+  EXPECT_TRUE(Sampler({"a"}, std::vector<int>{0}).empty());
+
+  const Sampler single({"a", "b"}, std::vector<int>{0, 3});
+  std::ranlux24_base rng(0);
+  for (int i = 0; i < 10; ++i)
+    EXPECT_EQ("b", single.sample(rng));
+}
+
+TEST(AliasSamplerTest, SamplingContainers) {
+  maplib::SamplingMap<int, std::string, unsigned> map{{0, "a", 1}, {1, "b", 0}, {2, "c", 3}};
+  auto sampler = map.buildStaticSampler();
+  const auto const_sampler = std::as_const(map).buildStaticSampler();
+  EXPECT_EQ(2, sampler.size());
+
+  std::ranlux24_base rng(0);
+  std::map<int, int> counts;
+  for (int i = 0; i < 40000; ++i) {
+    auto it = sampler.sample(rng);
+    ++counts[it->first];
+    EXPECT_EQ(it.getWeight(), map.findByKey(it->first).getWeight());
+    EXPECT_TRUE(const_sampler.sample(rng)->first != 1);
+  }
+  EXPECT_EQ(0, counts[1]);
+  EXPECT_NEAR(counts[2] / 40000., 0.75, 0.01);
+
+  // Iterators returned by the sampler give access to the map entries.
+  auto sampled = sampler.sample(rng);
+  sampled->second = "d";
+  EXPECT_TRUE(map.findByKey(0)->second == "d" || map.findByKey(2)->second == "d");
+
+  maplib::SamplingSet<std::string, double> set{{"a", 1.}, {"b", 1.}};
+  const auto set_sampler = set.buildStaticSampler();
+  set.erase("a");  // The sampler holds a copy of the keys.
+  int n_a = 0;
+  for (int i = 0; i < 1000; ++i)
+    n_a += set_sampler.sample(rng) == "a";
+  EXPECT_NEAR(n_a, 500, 80);
+}
+
+TEST(AliasSamplerTest, ScaledMap) {
+  // The sampler uses the weights with the pending scales applied.
+  maplib::SamplingMap<int, int, double> map;
+  for (int i = 0; i < 64; ++i)
+    map.insert(i, i, 1.);
+  map.scaleRange(0, 32, 3.);
+  const auto sampler = map.buildStaticSampler();
+  EXPECT_EQ(64, sampler.size());
+
+  std::ranlux24_base rng(0);
+  int n_low = 0;
+  for (int i = 0; i < 40000; ++i)
+    n_low += sampler.sample(rng)->first < 32;
+  EXPECT_NEAR(n_low / 40000., 0.75, 0.01);
+}
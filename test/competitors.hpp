@@ -0,0 +1,201 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Alternative implementations of an order statistic map, used as a reference in the perftests:
+// - PbdsMap: the GNU policy based red-black tree with tree_order_statistics_node_update.
+// - SortedVectorMap: a std::vector of pairs kept sorted, searched with binary search.
+// - SortedVectorSamplingMap: sorted keys with the inclusive prefix sums of the weights, sampled with
+//   binary search. Insertion and removal are O(n).
+// - TwoTreesSamplingMap: an OrderStatisticMap and a SamplingMap over the same keys, providing both
+//   ranks and weights as a RankedSamplingMap does.
+// keyByIndex and positionOf provide rank queries with the same syntax for every container.
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <ext/pb_ds/assoc_container.hpp>
+#include <ext/pb_ds/tree_policy.hpp>
+
+#include "order_statistic_map/order_statistic_map.hpp"
+#include "order_statistic_map/sampling_map.hpp"
+
+namespace perftest {
+
+template <class Key, class Value>
+class PbdsMap {
+public:
+  void insert(const std::pair<Key, Value>& pair) {
+    tree_.insert(pair);
+  }
+  void erase(const Key& key) {
+    tree_.erase(key);
+  }
+  bool count(const Key& key) const {
+    return tree_.find(key) != tree_.end();
+  }
+  std::size_t size() const {
+    return tree_.size();
+  }
+
+  const Key& keyByIndex(std::size_t index) const {
+    return tree_.find_by_order(index)->first;
+  }
+  std::size_t position(const Key& key) const {
+    return tree_.order_of_key(key);
+  }
+
+private:
+  __gnu_pbds::tree<Key, Value, std::less<Key>, __gnu_pbds::rb_tree_tag,
+                   __gnu_pbds::tree_order_statistics_node_update>
+      tree_;
+};
+
+template <class Key, class Value>
+class SortedVectorMap {
+public:
+  void insert(const std::pair<Key, Value>& pair) {
+    auto it = lowerBound(pair.first);
+    if (it != data_.end() && it->first == pair.first)
+      it->second = pair.second;
+    else
+      data_.insert(it, pair);
+  }
+  void erase(const Key& key) {
+    auto it = lowerBound(key);
+    if (it != data_.end() && it->first == key)
+      data_.erase(it);
+  }
+  bool count(const Key& key) const {
+    auto it = const_cast<SortedVectorMap&>(*this).lowerBound(key);
+    return it != data_.end() && it->first == key;
+  }
+  std::size_t size() const {
+    return data_.size();
+  }
+
+  const Key& keyByIndex(std::size_t index) const {
+    return data_[index].first;
+  }
+  std::size_t position(const Key& key) const {
+    return const_cast<SortedVectorMap&>(*this).lowerBound(key) - data_.begin();
+  }
+
+private:
+  auto lowerBound(const Key& key) {
+    return std::lower_bound(data_.begin(), data_.end(), key,
+                            [](const auto& elem, const Key& k) { return elem.first < k; });
+  }
+
+  std::vector<std::pair<Key, Value>> data_;
+};
+
+template <class Key, class Value, class Weight>
+class SortedVectorSamplingMap {
+public:
+  void insert(const Key& key, const Value& value, Weight weight) {
+    const std::size_t idx = lowerBound(key);
+    if (idx < keys_.size() && keys_[idx] == key) {
+      values_[idx] = value;
+      return;
+    }
+
+    keys_.insert(keys_.begin() + idx, key);
+    values_.insert(values_.begin() + idx, value);
+    const Weight left = idx ? cumulative_weights_[idx - 1] : Weight(0);
+    cumulative_weights_.insert(cumulative_weights_.begin() + idx, left);
+    for (std::size_t i = idx; i < cumulative_weights_.size(); ++i)
+      cumulative_weights_[i] += weight;
+  }
+
+  void erase(const Key& key) {
+    const std::size_t idx = lowerBound(key);
+    if (idx == keys_.size() || keys_[idx] != key)
+      return;
+
+    const Weight weight =
+        cumulative_weights_[idx] - (idx ? cumulative_weights_[idx - 1] : Weight(0));
+    keys_.erase(keys_.begin() + idx);
+    values_.erase(values_.begin() + idx);
+    cumulative_weights_.erase(cumulative_weights_.begin() + idx);
+    for (std::size_t i = idx; i < cumulative_weights_.size(); ++i)
+      cumulative_weights_[i] -= weight;
+  }
+
+  // Returns the index of the sampled key.
+  template <class Rng>
+  std::size_t sample(Rng& rng) const {
+    const Weight position =
+        std::uniform_real_distribution<Weight>(0, cumulative_weights_.back())(rng);
+    const auto it =
+        std::upper_bound(cumulative_weights_.begin(), cumulative_weights_.end(), position);
+    return std::min<std::size_t>(it - cumulative_weights_.begin(), keys_.size() - 1);
+  }
+
+  std::size_t size() const {
+    return keys_.size();
+  }
+
+private:
+  std::size_t lowerBound(const Key& key) const {
+    return std::lower_bound(keys_.begin(), keys_.end(), key) - keys_.begin();
+  }
+
+  std::vector<Key> keys_;
+  std::vector<Value> values_;
+  std::vector<Weight> cumulative_weights_;
+};
+
+template <class Key, class Value, class Weight>
+class TwoTreesSamplingMap {
+public:
+  void insert(const Key& key, const Value& value, Weight weight) {
+    ranks_.insert({key, value});
+    weights_.insert(key, value, weight);
+  }
+
+  void erase(const Key& key) {
+    ranks_.erase(key);
+    weights_.erase(key);
+  }
+
+  template <class Rng>
+  auto sample(Rng& rng) const {
+    return weights_.sample(rng);
+  }
+
+private:
+  maplib::OrderStatisticMap<Key, Value> ranks_;
+  maplib::SamplingMap<Key, Value, Weight> weights_;
+};
+
+template <class Map, class Key>
+std::size_t positionOf(const Map& map, const Key& key) {
+  return map.position(key);
+}
+template <class Key, class Value, std::size_t chunk_size, class Stats>
+std::size_t positionOf(const maplib::OrderStatisticMap<Key, Value, chunk_size, Stats>& map,
+                       const Key& key) {
+  return map.findByKey(key).position();
+}
+
+template <class Map>
+decltype(auto) keyByIndex(const Map& map, std::size_t index) {
+  return map.keyByIndex(index);
+}
+template <class Key, class Value, std::size_t chunk_size, class Stats>
+const Key& keyByIndex(const maplib::OrderStatisticMap<Key, Value, chunk_size, Stats>& map,
+                      std::size_t index) {
+  return map.findByIndex(index)->first;
+}
+
+}  // namespace perftest
@@ -0,0 +1,169 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Test for the DynamicSamplingSet class.
+
+#include "order_statistic_map/dynamic_sampling_set.hpp"
+
+#include <cmath>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+TEST(DynamicSamplingSetTest, InsertEraseSetWeight) {
+  maplib::DynamicSamplingSet<std::string, double> set;
+  EXPECT_FALSE(set.erase("foo"));
+  EXPECT_FALSE(set.setWeight("foo", 1.));
+
+  EXPECT_TRUE(set.insert("foo", 1.5));
+  EXPECT_TRUE(set.insert("bar", 0.));
+  EXPECT_TRUE(set.insert({"baz", 10.}));
+  EXPECT_FALSE(set.insert("foo", 3.));
+  EXPECT_EQ(3, set.size());
+  EXPECT_EQ(11.5, set.totalWeight());
+  EXPECT_EQ(1.5, set.getWeight("foo"));
+  EXPECT_TRUE(set.contains("bar"));
+  EXPECT_FALSE(set.contains("qux"));
+
+  // Same and different magnitude.
+  EXPECT_TRUE(set.setWeight("foo", 1.25));
+  EXPECT_TRUE(set.setWeight("baz", 0.25));
+  EXPECT_TRUE(set.setWeight("bar", 1024.));
+  EXPECT_EQ(1.25, set.getWeight("foo"));
+  EXPECT_EQ(0.25, set.getWeight("baz"));
+  EXPECT_DOUBLE_EQ(1025.5, set.totalWeight());
+  EXPECT_TRUE(set.checkConsistency());
+
+  EXPECT_TRUE(set.erase("bar"));
+  EXPECT_TRUE(set.erase("foo"));
+  EXPECT_TRUE(set.checkConsistency());
+  EXPECT_EQ(1, set.size());
+  EXPECT_TRUE(set.erase("baz"));
+  EXPECT_EQ(0, set.totalWeight());
+
+  EXPECT_THROW(set.insert("neg", -1.), std::invalid_argument);
+  EXPECT_THROW(set.getWeight("foo"), std::out_of_range);
+}
+
+TEST(DynamicSamplingSetTest, Sampling) {
+  maplib::DynamicSamplingSet<int, double> set;
+  std::mt19937_64 rng(0);
+  std::uniform_real_distribution<double> exponent(-10, 10);
+
+  // Weights spread over many magnitudes, with some zeros.
+  std::vector<double> weights;
+  double total = 0;
+  for (int i = 0; i < 100; ++i) {
+    weights.push_back(i % 10 ? std::exp2(exponent(rng)) : 0.);
+    set.insert(i, weights.back());
+  }
+
+  // Change some weights across and within buckets.
+  for (int i = 0; i < 100; i += 3) {
+    weights[i] = i % 2 ? weights[i] * 1.1 : std::exp2(exponent(rng));
+    set.setWeight(i, weights[i]);
+  }
+  for (double w : weights)
+    total += w;
+  EXPECT_NEAR(total, set.totalWeight(), 1e-9 * total);
+  EXPECT_TRUE(set.checkConsistency());
+
+  const int n_samples = 1000000;
+  std::vector<int> counts(weights.size(), 0);
+  for (int i = 0; i < n_samples; ++i)
+    ++counts[set.sample(rng)];
+
+  for (std::size_t i = 0; i < weights.size(); ++i) {
+    const double expected = n_samples * weights[i] / total;
+    EXPECT_NEAR(counts[i], expected, 5 * std::sqrt(expected) + 1e-9);
+  }
+
+  maplib::DynamicSamplingSet<int, double> empty{{1, 0.}};
+  EXPECT_THROW(empty.sample(rng), std::out_of_range);
+}
+
+TEST(DynamicSamplingSetTest, IntegerWeights) {
+  maplib::DynamicSamplingSet<int, unsigned> set{{0, 1}, {1, 2}, {2, 0}, {3, 5}};
+  EXPECT_EQ(8, set.totalWeight());
+
+  std::mt19937 rng(0);
+  std::map<int, int> counts;
+  for (int i = 0; i < 80000; ++i)
+    ++counts[set.sample(rng)];
+  EXPECT_EQ(0, counts[2]);
+  EXPECT_NEAR(counts[0] / 80000., 1. / 8, 0.01);
+  EXPECT_NEAR(counts[3] / 80000., 5. / 8, 0.01);
+
+  set.setWeight(3, 4);
+  set.setWeight(1, 3);
+  EXPECT_EQ(8, set.totalWeight());
+  EXPECT_TRUE(set.checkConsistency());
+}
+
+TEST(DynamicSamplingSetTest, ZeroAndExtremeWeights) {
+  maplib::DynamicSamplingSet<int, double> set;
+  std::mt19937_64 rng(0);
+
+  // The total keeps a rounding error after the removals, but no bucket can be sampled.
+  set.insert(1, 0.1);
+  set.insert(2, 0.2);
+  set.setWeight(1, 0);
+  set.setWeight(2, 0);
+  EXPECT_EQ(0, set.totalWeight());
+  EXPECT_THROW(set.sample(rng), std::out_of_range);
+  EXPECT_TRUE(set.checkConsistency());
+
+  // The upper bound of the bucket of 2^1023 is not representable.
+  set.setWeight(1, 1.5 * std::ldexp(1., 1023));
+  EXPECT_EQ(1, set.sample(rng));
+
+  // Buckets emptied by a weight drifting across many exponents are reused.
+  for (int e = -500; e < 500; ++e) {
+    set.setWeight(2, std::ldexp(1., e));
+    ASSERT_TRUE(set.checkConsistency());
+  }
+  EXPECT_EQ(std::ldexp(1., 499), set.getWeight(2));
+  EXPECT_TRUE(set.erase(1));
+  for (int i = 0; i < 100; ++i)
+    EXPECT_EQ(2, set.sample(rng));
+}
+
+// Perform the test with a number of randomly inserted and removed values.
+TEST(DynamicSamplingSetTest, InsertRemoveConsistency) {
+  maplib::DynamicSamplingSet<int, float> set;
+  std::map<int, float> reference;
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> key_distro(0, 500);
+  std::uniform_real_distribution<float> weight_distro(0, 100);
+
+  for (int i = 0; i < 20000; ++i) {
+    const int key = key_distro(rng);
+    const float weight = weight_distro(rng);
+    switch (i % 3) {
+      case 0:
+        EXPECT_EQ(reference.insert({key, weight}).second, set.insert(key, weight));
+        break;
+      case 1:
+        EXPECT_EQ(reference.erase(key) == 1, set.erase(key));
+        break;
+      case 2:
+        if (reference.count(key))
+          reference[key] = weight;
+        EXPECT_EQ(reference.count(key) == 1, set.setWeight(key, weight));
+    }
+  }
+
+  EXPECT_EQ(reference.size(), set.size());
+  for (const auto& [key, weight] : reference)
+    EXPECT_EQ(weight, set.getWeight(key));
+  EXPECT_TRUE(set.checkConsistency());
+}
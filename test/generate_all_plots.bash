@@ -7,8 +7,38 @@ mapfilter=""
 
 ./order_statistic_map_big_data_perftest "--benchmark_format=csv" "--benchmark_filter=${mapfilter}Erase" | python3 ./plot.py --logx --title "Large data insertion-erasure" --ylabel "time [ns]" --xlabel "size" --save insert_erase_big.svg
 
-./order_statistic_map_small_data_perftest "--benchmark_format=csv" "--benchmark_filter=${mapfilter}Find" | python3 ./plot.py --logx --title "Find integer key" --ylabel "time [ns]" --xlabel "size" --save find_integer.svg
+./order_statistic_map_small_data_perftest "--benchmark_format=csv" "--benchmark_filter=${mapfilter}Find/" | python3 ./plot.py --logx --title "Find integer key" --ylabel "time [ns]" --xlabel "size" --save find_integer.svg
 
-./order_statistic_map_string_perftest "--benchmark_format=csv" "--benchmark_filter=${mapfilter}Find" | python3 ./plot.py --logx --title "Find string key" --ylabel "time [ns]" --xlabel "size" --save find_string.svg
+./order_statistic_map_string_perftest "--benchmark_format=csv" "--benchmark_filter=${mapfilter}Find/" | python3 ./plot.py --logx --title "Find string key" --ylabel "time [ns]" --xlabel "size" --save find_string.svg
 
-./order_statistic_map_big_data_perftest "--benchmark_format=csv" "--benchmark_filter=${mapfilter}Find" | python3 ./plot.py --logx --title "Find large data" --ylabel "time [ns]" --xlabel "size" --save find_big.svg
+./order_statistic_map_big_data_perftest "--benchmark_format=csv" "--benchmark_filter=${mapfilter}Find/" | python3 ./plot.py --logx --title "Find large data" --ylabel "time [ns]" --xlabel "size" --save find_big.svg
+
+./order_statistic_map_small_data_perftest "--benchmark_format=csv" "--benchmark_filter=${mapfilter}FindByIndex" | python3 ./plot.py --logx --title "Find integer key by index" --ylabel "time [ns]" --xlabel "size" --save find_by_index_integer.svg
+
+./order_statistic_map_string_perftest "--benchmark_format=csv" "--benchmark_filter=${mapfilter}FindByIndex" | python3 ./plot.py --logx --title "Find string key by index" --ylabel "time [ns]" --xlabel "size" --save find_by_index_string.svg
+
+./order_statistic_map_small_data_perftest "--benchmark_format=csv" "--benchmark_filter=${mapfilter}Position" | python3 ./plot.py --logx --title "Position of integer key" --ylabel "time [ns]" --xlabel "size" --save position_integer.svg
+
+./order_statistic_map_string_perftest "--benchmark_format=csv" "--benchmark_filter=${mapfilter}Position" | python3 ./plot.py --logx --title "Position of string key" --ylabel "time [ns]" --xlabel "size" --save position_string.svg
+
+./sampling_map_perftest "--benchmark_format=csv" "--benchmark_filter=${mapfilter}Erase" | python3 ./plot.py --logx --title "Weighted insertion-erasure" --ylabel "time [ns]" --xlabel "size" --save insert_erase_sampling.svg
+
+./sampling_map_perftest "--benchmark_format=csv" "--benchmark_filter=${mapfilter}Sample/" | python3 ./plot.py --logx --title "Weighted sampling" --ylabel "time [ns]" --xlabel "size" --save sample.svg
+
+./sampling_map_perftest "--benchmark_format=csv" "--benchmark_filter=${mapfilter}Draw/.*/1$" | python3 ./plot.py --logx --title "Weighted sampling, log-uniform weights" --ylabel "time [ns]" --xlabel "size" --save sample_dynamic.svg
+
+./sampling_map_perftest "--benchmark_format=csv" "--benchmark_filter=${mapfilter}Reweight/.*/1$" | python3 ./plot.py --logx --title "Weight update, log-uniform weights" --ylabel "time [ns]" --xlabel "size" --save reweight_dynamic.svg
+
+# Each mix is plotted with its default parameters.
+for workload in "Zipf/.*/990/100$" "SlidingWindow" "MonteCarlo/.*/500/500$" "ReadHeavy/.*/10$"; do
+  name=${workload%%/*}
+  ./workload_perftest "--benchmark_format=csv" "--benchmark_filter=${mapfilter}${workload}" | python3 ./plot.py --logx --title "${name} workload" --ylabel "time per step [ns]" --xlabel "size" --save workload_${name}.svg
+done
+
+for type in Int String Big; do
+  ./memory_perftest "--benchmark_format=csv" "--benchmark_filter=${mapfilter}Map${type}Memory" | python3 ./plot.py -m bytes_per_element --logx --title "Memory usage, ${type} map" --ylabel "bytes per element" --xlabel "size" --save memory_map_${type}.svg
+done
+
+for type in Int String; do
+  ./memory_perftest "--benchmark_format=csv" "--benchmark_filter=${mapfilter}Set${type}Memory" | python3 ./plot.py -m bytes_per_element --logx --title "Memory usage, ${type} set" --ylabel "bytes per element" --xlabel "size" --save memory_set_${type}.svg
+done
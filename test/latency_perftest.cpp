@@ -0,0 +1,142 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Tail latency of the single operations. Each benchmark reports the p50, p99, p99.9 and maximum
+// latency of one operation type, in time stamp counter ticks, as user counters.
+// The container holds a sliding window of random keys: each step inserts a new key and erases the
+// oldest one, so that rebalancing and pool allocations are part of the measurement.
+
+#define MAPLIB_ENABLE_TRACING
+
+#include "order_statistic_map/order_statistic_map.hpp"
+#include "order_statistic_map/sampling_map.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#define ARGS RangeMultiplier(8)->Range(64, 1 << 20)
+
+const unsigned n_max = 1 << 20;
+const unsigned n_window_slack = 4096;
+
+using Key = int;
+using Value = int;
+
+using maplib::Operation;
+
+std::vector<Key> keys;
+
+void init() {
+  static bool initialized = false;
+  if (initialized)
+    return;
+  initialized = true;
+
+  keys.resize(n_max + n_window_slack);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(0));
+}
+
+void reportPercentiles(benchmark::State& state, const maplib::LatencyHistogram& histogram) {
+  state.counters["p50"] = histogram.percentile(0.5);
+  state.counters["p99"] = histogram.percentile(0.99);
+  state.counters["p99.9"] = histogram.percentile(0.999);
+  state.counters["max"] = histogram.max();
+}
+
+template <class Map, class Insert>
+void performLatencyTest(benchmark::State& state, Operation op, Insert&& insert) {
+  init();
+  Map map;
+  const std::size_t size = state.range(0);
+  const std::size_t window = size + n_window_slack;
+  for (std::size_t i = 0; i < size; ++i)
+    insert(map, keys[i]);
+
+  maplib::LatencyTracer tracer;
+  map.setTracer(&tracer);
+  std::mt19937 rng(0);
+  std::size_t oldest = 0;
+  constexpr bool is_sampling_map = std::is_same_v<Map, maplib::SamplingMap<Key, Value, double>>;
+
+  for (auto _ : state) {
+    switch (op) {
+      case Operation::INSERT:
+      case Operation::ERASE:
+        insert(map, keys[(oldest + size) % window]);
+        map.erase(keys[oldest]);
+        oldest = (oldest + 1) % window;
+        break;
+      case Operation::FIND:
+        benchmark::DoNotOptimize(map.findByKey(keys[(oldest + rng() % size) % window]));
+        break;
+      case Operation::FIND_BY_INDEX:
+        if constexpr (!is_sampling_map)
+          benchmark::DoNotOptimize(map.findByIndex(rng() % size));
+        break;
+      case Operation::SAMPLE:
+        if constexpr (is_sampling_map)
+          benchmark::DoNotOptimize(map.sample(rng));
+        break;
+      default:
+        break;
+    }
+  }
+
+  reportPercentiles(state, tracer.histogram(op));
+}
+
+void performMyMapLatencyTest(benchmark::State& state, Operation op) {
+  performLatencyTest<maplib::OrderStatisticMap<Key, Value>>(
+      state, op, [](auto& map, Key key) { map.insert(key, key); });
+}
+
+void performSamplingMapLatencyTest(benchmark::State& state, Operation op) {
+  performLatencyTest<maplib::SamplingMap<Key, Value, double>>(
+      state, op, [](auto& map, Key key) { map.insert(key, key, 1. + key % 7); });
+}
+
+static void BM_MyMapInsertLatency(benchmark::State& state) {
+  performMyMapLatencyTest(state, Operation::INSERT);
+}
+BENCHMARK(BM_MyMapInsertLatency)->ARGS;
+
+static void BM_MyMapEraseLatency(benchmark::State& state) {
+  performMyMapLatencyTest(state, Operation::ERASE);
+}
+BENCHMARK(BM_MyMapEraseLatency)->ARGS;
+
+static void BM_MyMapFindLatency(benchmark::State& state) {
+  performMyMapLatencyTest(state, Operation::FIND);
+}
+BENCHMARK(BM_MyMapFindLatency)->ARGS;
+
+static void BM_MyMapFindByIndexLatency(benchmark::State& state) {
+  performMyMapLatencyTest(state, Operation::FIND_BY_INDEX);
+}
+BENCHMARK(BM_MyMapFindByIndexLatency)->ARGS;
+
+static void BM_SamplingMapInsertLatency(benchmark::State& state) {
+  performSamplingMapLatencyTest(state, Operation::INSERT);
+}
+BENCHMARK(BM_SamplingMapInsertLatency)->ARGS;
+
+static void BM_SamplingMapEraseLatency(benchmark::State& state) {
+  performSamplingMapLatencyTest(state, Operation::ERASE);
+}
+BENCHMARK(BM_SamplingMapEraseLatency)->ARGS;
+
+static void BM_SamplingMapSampleLatency(benchmark::State& state) {
+  performSamplingMapLatencyTest(state, Operation::SAMPLE);
+}
+BENCHMARK(BM_SamplingMapSampleLatency)->ARGS;
@@ -0,0 +1,90 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Test for the latency histograms and the tracing hook.
+
+#define MAPLIB_ENABLE_TRACING
+
+#include "order_statistic_map/order_statistic_map.hpp"
+#include "order_statistic_map/sampling_map.hpp"
+
+#include <random>
+
+#include "gtest/gtest.h"
+
+TEST(LatencyTracerTest, Histogram) {
+  maplib::LatencyHistogram histogram;
+  EXPECT_EQ(0, histogram.percentile(0.5));
+
+  for (std::uint64_t i = 1; i <= 1000; ++i)
+    histogram.record(i);
+  histogram.record(1000000);
+
+  EXPECT_EQ(1001, histogram.count());
+  EXPECT_EQ(1000000, histogram.max());
+  EXPECT_EQ(1000000, histogram.percentile(1.));
+
+  // Buckets have a relative width of at most 25%.
+  for (double q : {0.01, 0.5, 0.9, 0.99}) {
+    const double exact = q * 1001;
+    EXPECT_GE(histogram.percentile(q), exact - 1);
+    EXPECT_LE(histogram.percentile(q), exact * 1.25 + 1);
+  }
+
+  // Exact values in the linear range.
+  maplib::LatencyHistogram small;
+  for (std::uint64_t i = 0; i < 10; ++i)
+    small.record(i);
+  EXPECT_EQ(4, small.percentile(0.5));
+
+  histogram.reset();
+  EXPECT_EQ(0, histogram.count());
+  EXPECT_EQ(0, histogram.max());
+}
+
+TEST(LatencyTracerTest, Hook) {
+  using maplib::Operation;
+  maplib::LatencyTracer tracer;
+
+  maplib::OrderStatisticMap<int, int> map;
+  map.insert(-1, 0);  // Not traced.
+
+  map.setTracer(&tracer);
+  for (int i = 0; i < 100; ++i)
+    map.insert(i, i);
+  for (int i = 0; i < 10; ++i)
+    map.erase(i);
+  map.erase(map.findByKey(50));
+  map.contains(20);
+  map.findByIndex(3);
+
+  EXPECT_EQ(100, tracer.histogram(Operation::INSERT).count());
+  EXPECT_EQ(11, tracer.histogram(Operation::ERASE).count());
+  EXPECT_EQ(2, tracer.histogram(Operation::FIND).count());
+  EXPECT_EQ(1, tracer.histogram(Operation::FIND_BY_INDEX).count());
+
+  map.setTracer(nullptr);
+  map.insert(1000, 0);
+  EXPECT_EQ(100, tracer.histogram(Operation::INSERT).count());
+
+  tracer.reset();
+  maplib::SamplingMap<int, int, double> sampling_map;
+  sampling_map.setTracer(&tracer);
+  for (int i = 0; i < 10; ++i)
+    sampling_map.insert(i, i, 1.);
+  sampling_map.erase(3);
+  sampling_map.erase(sampling_map.findByKey(4));
+
+  std::mt19937 rng(0);
+  sampling_map.sample(rng);
+
+  EXPECT_EQ(10, tracer.histogram(Operation::INSERT).count());
+  EXPECT_EQ(2, tracer.histogram(Operation::ERASE).count());
+  EXPECT_EQ(1, tracer.histogram(Operation::FIND).count());
+  EXPECT_EQ(1, tracer.histogram(Operation::SAMPLE).count());
+}
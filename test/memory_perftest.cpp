@@ -0,0 +1,217 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Memory footprint of the containers, reported as user counters:
+// - bytes_per_element: heap memory held by the container, including the malloc rounding.
+// - slack_per_element: bytes_per_element minus the size of a node, i.e. unused pool slots, pool
+//   bookkeeping, and allocator overhead.
+// - peak_bytes_per_element: highest heap usage during the construction.
+// - peak_rss_MB: high-water mark of the resident set size of the whole process so far.
+// Plot a quantity with `plot.py -m <counter>`.
+
+#include "order_statistic_map/order_statistic_map.hpp"
+#include "order_statistic_map/order_statistic_set.hpp"
+#include "order_statistic_map/sampling_map.hpp"
+#include "order_statistic_map/sampling_set.hpp"
+
+#include <array>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <new>
+#include <set>
+#include <string>
+#include <type_traits>
+
+#include <malloc.h>
+#include <sys/resource.h>
+
+#include <benchmark/benchmark.h>
+
+#define ARGS RangeMultiplier(8)->Range(64, 1 << 21)->Iterations(1)
+
+namespace {
+std::size_t live_bytes = 0;
+std::size_t peak_bytes = 0;
+}  // namespace
+
+// The replacement operators below pair malloc with free by design, but GCC sees the free of a
+// pointer returned by operator new once they are inlined into each other.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t size) {
+  void* ptr = std::malloc(size ? size : 1);
+  if (!ptr)
+    throw(std::bad_alloc());
+  live_bytes += malloc_usable_size(ptr);
+  peak_bytes = std::max(peak_bytes, live_bytes);
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+  if (ptr)
+    live_bytes -= malloc_usable_size(ptr);
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+  operator delete(ptr);
+}
+
+template <class Key>
+Key makeKey(int i) {
+  if constexpr (std::is_same_v<Key, std::string>)
+    return "key " + std::to_string(i);
+  else
+    return Key(i);
+}
+
+using BigValue = std::array<int, 16>;
+
+template <class Container, class = void>
+struct NodeBytes {  // libstdc++ red-black tree node.
+  constexpr static std::size_t value = sizeof(std::_Rb_tree_node<typename Container::value_type>);
+};
+template <class Container>
+struct NodeBytes<Container, std::void_t<typename Container::Node>> {
+  constexpr static std::size_t value = sizeof(typename Container::Node);
+};
+
+// Builds the container with `insert(container, i)` and reports its footprint.
+template <class Container, class Insert>
+void performMemoryTest(benchmark::State& state, Insert&& insert) {
+  const std::size_t n = state.range(0);
+
+  for (auto _ : state) {
+    const std::size_t bytes_before = live_bytes;
+    peak_bytes = live_bytes;
+
+    auto container = std::make_unique<Container>();
+    for (std::size_t i = 0; i < n; ++i)
+      insert(*container, i);
+
+    const double bytes = live_bytes - bytes_before;
+    state.counters["bytes_per_element"] = bytes / n;
+    state.counters["slack_per_element"] = bytes / n - NodeBytes<Container>::value;
+    state.counters["peak_bytes_per_element"] = double(peak_bytes - bytes_before) / n;
+
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    state.counters["peak_rss_MB"] = usage.ru_maxrss / 1024.;
+  }
+}
+
+template <class Map, class Key>
+void performMapMemoryTest(benchmark::State& state) {
+  performMemoryTest<Map>(state, [](auto& map, int i) {
+    map.insert({makeKey<Key>(i), {}});
+  });
+}
+
+template <class Map, class Key>
+void performSamplingMapMemoryTest(benchmark::State& state) {
+  performMemoryTest<Map>(state, [](auto& map, int i) {
+    map.insert(makeKey<Key>(i), {}, 1.);
+  });
+}
+
+template <class Set, class Key>
+void performSetMemoryTest(benchmark::State& state) {
+  performMemoryTest<Set>(state, [](auto& set, int i) {
+    set.insert(makeKey<Key>(i));
+  });
+}
+
+template <class Set, class Key>
+void performSamplingSetMemoryTest(benchmark::State& state) {
+  performMemoryTest<Set>(state, [](auto& set, int i) {
+    set.insert(makeKey<Key>(i), 1.);
+  });
+}
+
+static void BM_StdMapIntMemory(benchmark::State& state) {
+  performMapMemoryTest<std::map<int, int>, int>(state);
+}
+BENCHMARK(BM_StdMapIntMemory)->ARGS;
+
+static void BM_MyMapIntMemory(benchmark::State& state) {
+  performMapMemoryTest<maplib::OrderStatisticMap<int, int>, int>(state);
+}
+BENCHMARK(BM_MyMapIntMemory)->ARGS;
+
+static void BM_SamplingMapIntMemory(benchmark::State& state) {
+  performSamplingMapMemoryTest<maplib::SamplingMap<int, int, double>, int>(state);
+}
+BENCHMARK(BM_SamplingMapIntMemory)->ARGS;
+
+static void BM_RankedSamplingMapIntMemory(benchmark::State& state) {
+  performSamplingMapMemoryTest<maplib::RankedSamplingMap<int, int, double>, int>(state);
+}
+BENCHMARK(BM_RankedSamplingMapIntMemory)->ARGS;
+
+static void BM_StdMapStringMemory(benchmark::State& state) {
+  performMapMemoryTest<std::map<std::string, std::string>, std::string>(state);
+}
+BENCHMARK(BM_StdMapStringMemory)->ARGS;
+
+static void BM_MyMapStringMemory(benchmark::State& state) {
+  performMapMemoryTest<maplib::OrderStatisticMap<std::string, std::string>, std::string>(state);
+}
+BENCHMARK(BM_MyMapStringMemory)->ARGS;
+
+static void BM_SamplingMapStringMemory(benchmark::State& state) {
+  performSamplingMapMemoryTest<maplib::SamplingMap<std::string, std::string, double>, std::string>(state);
+}
+BENCHMARK(BM_SamplingMapStringMemory)->ARGS;
+
+static void BM_StdMapBigMemory(benchmark::State& state) {
+  performMapMemoryTest<std::map<std::size_t, BigValue>, std::size_t>(state);
+}
+BENCHMARK(BM_StdMapBigMemory)->ARGS;
+
+static void BM_MyMapBigMemory(benchmark::State& state) {
+  performMapMemoryTest<maplib::OrderStatisticMap<std::size_t, BigValue>, std::size_t>(state);
+}
+BENCHMARK(BM_MyMapBigMemory)->ARGS;
+
+static void BM_SamplingMapBigMemory(benchmark::State& state) {
+  performSamplingMapMemoryTest<maplib::SamplingMap<std::size_t, BigValue, double>, std::size_t>(state);
+}
+BENCHMARK(BM_SamplingMapBigMemory)->ARGS;
+
+static void BM_StdSetIntMemory(benchmark::State& state) {
+  performSetMemoryTest<std::set<int>, int>(state);
+}
+BENCHMARK(BM_StdSetIntMemory)->ARGS;
+
+static void BM_MySetIntMemory(benchmark::State& state) {
+  performSetMemoryTest<maplib::OrderStatisticSet<int>, int>(state);
+}
+BENCHMARK(BM_MySetIntMemory)->ARGS;
+
+static void BM_SamplingSetIntMemory(benchmark::State& state) {
+  performSamplingSetMemoryTest<maplib::SamplingSet<int, double>, int>(state);
+}
+BENCHMARK(BM_SamplingSetIntMemory)->ARGS;
+
+static void BM_StdSetStringMemory(benchmark::State& state) {
+  performSetMemoryTest<std::set<std::string>, std::string>(state);
+}
+BENCHMARK(BM_StdSetStringMemory)->ARGS;
+
+static void BM_MySetStringMemory(benchmark::State& state) {
+  performSetMemoryTest<maplib::OrderStatisticSet<std::string>, std::string>(state);
+}
+BENCHMARK(BM_MySetStringMemory)->ARGS;
+
+static void BM_SamplingSetStringMemory(benchmark::State& state) {
+  performSamplingSetMemoryTest<maplib::SamplingSet<std::string, double>, std::string>(state);
+}
+BENCHMARK(BM_SamplingSetStringMemory)->ARGS;
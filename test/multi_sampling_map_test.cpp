@@ -0,0 +1,178 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Test for the MultiSamplingMap class.
+
+#include "order_statistic_map/multi_sampling_map.hpp"
+
+#include <array>
+#include <cmath>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "order_statistic_map/sampling_map.hpp"
+
+TEST(MultiSamplingMapTest, SamplingPerChannel) {
+  // Channels: by weight, uniform, and only "c".
+  maplib::MultiSamplingMap<std::string, int, unsigned, 3> map{
+      {"a", 0, {1, 1, 0}}, {"b", 1, {2, 1, 0}}, {"c", 2, {1, 1, 5}}};
+  EXPECT_EQ(3, map.size());
+  EXPECT_EQ(4, map.totalWeight(0));
+  EXPECT_EQ(3, map.totalWeight(1));
+  EXPECT_EQ(5, map.totalWeight(2));
+  EXPECT_EQ((std::array<unsigned, 3>{4, 3, 5}), map.totalWeights());
+
+  const std::vector<std::string> by_weight{"a", "b", "b", "c"};
+  for (unsigned position = 0; position < 4; ++position)
+    EXPECT_EQ(by_weight[position], map.sample(position, 0)->first);
+  EXPECT_EQ("b", map.sample(1, 1)->first);
+  EXPECT_EQ("c", map.sample(0, 2)->first);
+  EXPECT_EQ("c", map.sampleScaled(0.5, 2)->first);
+
+  // Out of range.
+  EXPECT_FALSE(map.sample(4, 0));
+  EXPECT_FALSE(map.sample(3, 1));
+
+  std::mt19937_64 rng(0);
+  for (int i = 0; i < 20; ++i)
+    EXPECT_EQ("c", map.sample(rng, 2)->first);
+
+  // Update a single channel, or all of them.
+  auto it = map.findByKey("a");
+  it.setWeight(2, 3);
+  EXPECT_EQ(3, it.getWeight(2));
+  EXPECT_EQ(8, map.totalWeight(2));
+  EXPECT_EQ(4, map.totalWeight(0));
+  EXPECT_EQ("a", map.sample(2, 2)->first);
+
+  map.findByKey("c").setWeights({0, 0, 0});
+  EXPECT_EQ((std::array<unsigned, 3>{3, 2, 3}), map.totalWeights());
+  EXPECT_TRUE(map.checkConsistency());
+
+  // Insertion of a present key changes only the value.
+  const auto [b_it, inserted] = map.insert("b", 42, {7, 7, 7});
+  EXPECT_FALSE(inserted);
+  EXPECT_EQ(42, b_it->second);
+  EXPECT_EQ(2, b_it.getWeight(0));
+
+  EXPECT_TRUE(map.erase("a"));
+  EXPECT_FALSE(map.erase("a"));
+  EXPECT_EQ((std::array<unsigned, 3>{2, 1, 0}), map.totalWeights());
+  EXPECT_FALSE(map.sample(rng, 2));
+}
+
+TEST(MultiSamplingMapTest, MatchesSamplingMaps) {
+  // Each channel must sample as a SamplingMap holding the same weights.
+  constexpr std::size_t channels = 4;
+  using Map = maplib::MultiSamplingMap<int, int, double, channels>;
+  Map map;
+  std::array<maplib::SamplingMap<int, int, double>, channels> references;
+  std::map<int, int> std_map;
+
+  std::mt19937_64 rng(0);
+  std::uniform_int_distribution<int> key_distro(0, 200);
+  std::uniform_real_distribution<double> weight_distro(0, 10);
+  auto random_weights = [&] {
+    Map::Weights weights;
+    for (auto& w : weights)
+      w = weight_distro(rng);
+    return weights;
+  };
+
+  for (int step = 0; step < 2000; ++step) {
+    const int key = key_distro(rng);
+    const int action = rng() % 4;
+
+    if (action == 0) {  // Insert.
+      const auto weights = random_weights();
+      const bool inserted = map.insert(key, step, weights).second;
+      EXPECT_EQ(!std_map.count(key), inserted);
+      std_map[key] = step;
+      for (std::size_t c = 0; c < channels; ++c)
+        references[c].insert(key, step, weights[c]);
+    }
+    else if (action == 1) {  // Erase by key.
+      EXPECT_EQ(std_map.erase(key), map.erase(key));
+      for (auto& reference : references)
+        reference.erase(key);
+    }
+    else if (action == 2) {  // Change one channel.
+      auto it = map.findByKey(key);
+      ASSERT_EQ(std_map.count(key), static_cast<bool>(it));
+      if (it) {
+        const std::size_t channel = rng() % channels;
+        const double weight = weight_distro(rng);
+        it.setWeight(channel, weight);
+        references[channel].findByKey(key).setWeight(weight);
+      }
+    }
+    else {  // Change all channels, then erase by iterator.
+      auto it = map.findByKey(key);
+      if (it) {
+        const auto weights = random_weights();
+        it.setWeights(weights);
+        for (std::size_t c = 0; c < channels; ++c)
+          references[c].findByKey(key).setWeight(weights[c]);
+        if (rng() % 2) {
+          map.erase(it);
+          std_map.erase(key);
+          for (auto& reference : references)
+            reference.erase(key);
+        }
+      }
+    }
+
+    ASSERT_EQ(std_map.size(), map.size());
+    if (step % 50 == 0) {
+      ASSERT_TRUE(map.checkConsistency());
+    }
+  }
+  ASSERT_TRUE(map.checkConsistency());
+
+  auto std_it = std_map.begin();
+  for (auto it = map.begin(); it != map.end(); ++it, ++std_it) {
+    EXPECT_EQ(std_it->first, it->first);
+    EXPECT_EQ(std_it->second, it->second);
+  }
+
+  std::uniform_real_distribution<double> uniform(0, 1);
+  for (std::size_t c = 0; c < channels; ++c) {
+    EXPECT_NEAR(references[c].totalWeight(), map.totalWeight(c), 1e-9);
+    for (int i = 0; i < 100; ++i) {
+      // Avoid the edges of the intervals, where rounding errors differ.
+      const double position = uniform(rng) * references[c].totalWeight();
+      const auto expected = references[c].sample(position);
+      const auto sampled = map.sample(position, c);
+      ASSERT_TRUE(sampled);
+      if (std::abs(expected.cumulativeWeight() - position) > 1e-9 &&
+          std::abs(expected.cumulativeWeight() + expected.getWeight() - position) > 1e-9) {
+        EXPECT_EQ(expected->first, sampled->first);
+      }
+    }
+  }
+}
+
+TEST(MultiSamplingMapTest, Assignment) {
+  using Map = maplib::MultiSamplingMap<int, double, int, 2>;
+  Map map1{{1, 0.5, {1, 0}}, {-1, 3.14, {2, 3}}, {42, -273.15, {1, 1}}};
+
+  Map map2;
+  map2 = map1;
+  Map map3(std::move(map1));
+
+  for (const Map* map : {&map2, &map3}) {
+    EXPECT_EQ(3, map->size());
+    EXPECT_EQ((std::array<int, 2>{4, 4}), map->totalWeights());
+    EXPECT_EQ(3, map->findByKey(-1).getWeight(1));
+    EXPECT_TRUE(map->checkConsistency());
+  }
+}
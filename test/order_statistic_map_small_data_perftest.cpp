@@ -10,6 +10,8 @@
 
 #include "order_statistic_map/order_statistic_map.hpp"
 
+#include <algorithm>
+#include <numeric>
 #include <vector>
 #include <random>
 #include <string>
@@ -17,6 +19,9 @@
 
 #include <benchmark/benchmark.h>
 
+#include "competitors.hpp"
+#include "perftest_statistics.hpp"
+
 #define ARGS RangeMultiplier(4)->Range(64, 8 << 12)
 
 const unsigned n_init = 50000;
@@ -53,12 +58,14 @@ static void performInsertRemoveTest(benchmark::State& state) {
   for (int i = 0; i < state.range(0); ++i)
     map.insert({keys[i], vals[i]});
 
+  perftest::resetStatistics(map);
   for (auto _ : state) {
     for (int i = n_init; i < n_init + n_test; ++i)
       map.insert({keys[i], vals[i]});
     for (int i = n_init; i < n_init + n_test; ++i)
       map.erase(keys[i]);
   }
+  perftest::reportStatistics(state, map);
 }
 
 static void BM_StdMapInsertErase(benchmark::State& state) {
@@ -72,10 +79,20 @@ static void BM_PooledStdMapInsertErase(benchmark::State& state) {
 BENCHMARK(BM_PooledStdMapInsertErase)->ARGS;
 
 static void BM_MyMapInsertErase(benchmark::State& state) {
-  performInsertRemoveTest<maplib::OrderStatisticMap>(state);
+  performInsertRemoveTest<perftest::OrderStatisticMap>(state);
 }
 BENCHMARK(BM_MyMapInsertErase)->ARGS;
 
+static void BM_PbdsMapInsertErase(benchmark::State& state) {
+  performInsertRemoveTest<perftest::PbdsMap>(state);
+}
+BENCHMARK(BM_PbdsMapInsertErase)->ARGS;
+
+static void BM_SortedVectorInsertErase(benchmark::State& state) {
+  performInsertRemoveTest<perftest::SortedVectorMap>(state);
+}
+BENCHMARK(BM_SortedVectorInsertErase)->ARGS;
+
 template <template <class, class> class Map>
 static void performFindTest(benchmark::State& state) {
   init();
@@ -83,10 +100,12 @@ static void performFindTest(benchmark::State& state) {
   for (int i = 0; i < state.range(0); ++i)
     map.insert({keys[i], vals[i]});
 
+  perftest::resetStatistics(map);
   for (auto _ : state) {
     for (int i = 0; i < n_test; ++i)
       benchmark::DoNotOptimize(map.count(keys[i]));
   }
+  perftest::reportStatistics(state, map);
 }
 
 static void BM_StdMapFind(benchmark::State& state) {
@@ -100,6 +119,128 @@ static void BM_PooledStdMapFind(benchmark::State& state) {
 BENCHMARK(BM_PooledStdMapFind)->ARGS;
 
 static void BM_MyMapFind(benchmark::State& state) {
-  performFindTest<maplib::OrderStatisticMap>(state);
+  performFindTest<perftest::OrderStatisticMap>(state);
 }
 BENCHMARK(BM_MyMapFind)->ARGS;
+
+static void BM_PbdsMapFind(benchmark::State& state) {
+  performFindTest<perftest::PbdsMap>(state);
+}
+BENCHMARK(BM_PbdsMapFind)->ARGS;
+
+static void BM_SortedVectorFind(benchmark::State& state) {
+  performFindTest<perftest::SortedVectorMap>(state);
+}
+BENCHMARK(BM_SortedVectorFind)->ARGS;
+
+// Access the i-th key, and compute the position of a key, for different ranks at each iteration.
+template <template <class, class> class Map>
+static void performFindByIndexTest(benchmark::State& state) {
+  init();
+  Map<Key, Value> map;
+  for (int i = 0; i < state.range(0); ++i)
+    map.insert({keys[i], vals[i]});
+
+  int idx = 0;
+  perftest::resetStatistics(map);
+  for (auto _ : state) {
+    for (int i = 0; i < n_test; ++i) {
+      benchmark::DoNotOptimize(perftest::keyByIndex(map, idx));
+      idx = (idx + 7919) % state.range(0);
+    }
+  }
+  perftest::reportStatistics(state, map);
+}
+
+template <template <class, class> class Map>
+static void performPositionTest(benchmark::State& state) {
+  init();
+  Map<Key, Value> map;
+  for (int i = 0; i < state.range(0); ++i)
+    map.insert({keys[i], vals[i]});
+
+  perftest::resetStatistics(map);
+  for (auto _ : state) {
+    for (int i = 0; i < n_test; ++i)
+      benchmark::DoNotOptimize(perftest::positionOf(map, keys[i]));
+  }
+  perftest::reportStatistics(state, map);
+}
+
+static void BM_MyMapFindByIndex(benchmark::State& state) {
+  performFindByIndexTest<perftest::OrderStatisticMap>(state);
+}
+BENCHMARK(BM_MyMapFindByIndex)->ARGS;
+
+static void BM_PbdsMapFindByIndex(benchmark::State& state) {
+  performFindByIndexTest<perftest::PbdsMap>(state);
+}
+BENCHMARK(BM_PbdsMapFindByIndex)->ARGS;
+
+static void BM_SortedVectorFindByIndex(benchmark::State& state) {
+  performFindByIndexTest<perftest::SortedVectorMap>(state);
+}
+BENCHMARK(BM_SortedVectorFindByIndex)->ARGS;
+
+static void BM_MyMapPosition(benchmark::State& state) {
+  performPositionTest<perftest::OrderStatisticMap>(state);
+}
+BENCHMARK(BM_MyMapPosition)->ARGS;
+
+static void BM_PbdsMapPosition(benchmark::State& state) {
+  performPositionTest<perftest::PbdsMap>(state);
+}
+BENCHMARK(BM_PbdsMapPosition)->ARGS;
+
+static void BM_SortedVectorPosition(benchmark::State& state) {
+  performPositionTest<perftest::SortedVectorMap>(state);
+}
+BENCHMARK(BM_SortedVectorPosition)->ARGS;
+
+// Search different keys at each iteration in a container aged by many insertions and removals in
+// random order, with or without a following compaction.
+static void performAgedLookupTest(benchmark::State& state, bool compact) {
+  init();
+  perftest::OrderStatisticMap<Key, Value> map;
+  const int size = state.range(0);
+  for (int i = 0; i < size; ++i)
+    map.insert(keys[i], vals[i]);
+
+  std::vector<int> order(size);
+  std::iota(order.begin(), order.end(), 0);
+  std::mt19937 rng(0);
+  for (int round = 0; round < 16; ++round) {
+    std::shuffle(order.begin(), order.end(), rng);
+    for (int i = 0; i < size; i += 64) {
+      const int batch_end = std::min(i + 64, size);
+      for (int j = i; j < batch_end; ++j)
+        map.erase(keys[order[j]]);
+      std::shuffle(order.begin() + i, order.begin() + batch_end, rng);
+      for (int j = i; j < batch_end; ++j)
+        map.insert(keys[order[j]], vals[order[j]]);
+    }
+  }
+
+  if (compact)
+    map.compact();
+
+  int idx = 0;
+  perftest::resetStatistics(map);
+  for (auto _ : state) {
+    for (int i = 0; i < n_test; ++i) {
+      benchmark::DoNotOptimize(map.count(keys[order[idx]]));
+      idx = (idx + 1) % size;
+    }
+  }
+  perftest::reportStatistics(state, map);
+}
+
+static void BM_AgedMyMapLookup(benchmark::State& state) {
+  performAgedLookupTest(state, false);
+}
+BENCHMARK(BM_AgedMyMapLookup)->ARGS;
+
+static void BM_CompactedMyMapLookup(benchmark::State& state) {
+  performAgedLookupTest(state, true);
+}
+BENCHMARK(BM_CompactedMyMapLookup)->ARGS;
@@ -17,6 +17,9 @@
 
 #include <benchmark/benchmark.h>
 
+#include "competitors.hpp"
+#include "perftest_statistics.hpp"
+
 const unsigned n_init = 50000;
 const unsigned n_test = 10;
 
@@ -53,12 +56,14 @@ static void performInsertRemoveTest(benchmark::State& state) {
     for (int i = 0; i < state.range(0); ++i)
         map.insert({keys[i], vals[i]});
 
+    perftest::resetStatistics(map);
     for (auto _ : state) {
         for (int i = n_init; i < n_init + n_test; ++i)
             map.insert({keys[i], vals[i]});
         for (int i = n_init; i < n_init + n_test; ++i)
             map.erase(keys[i]);
     }
+    perftest::reportStatistics(state, map);
 }
 
 static void BM_StdMapInsertErase(benchmark::State& state) {
@@ -72,10 +77,20 @@ static void BM_PooledStdMapInsertErase(benchmark::State& state) {
 BENCHMARK(BM_PooledStdMapInsertErase)->ARGS;
 
 static void BM_MyMapInsertErase(benchmark::State& state) {
-    performInsertRemoveTest<maplib::OrderStatisticMap>(state);
+    performInsertRemoveTest<perftest::OrderStatisticMap>(state);
 }
 BENCHMARK(BM_MyMapInsertErase)->ARGS;
 
+static void BM_PbdsMapInsertErase(benchmark::State& state) {
+    performInsertRemoveTest<perftest::PbdsMap>(state);
+}
+BENCHMARK(BM_PbdsMapInsertErase)->ARGS;
+
+static void BM_SortedVectorInsertErase(benchmark::State& state) {
+    performInsertRemoveTest<perftest::SortedVectorMap>(state);
+}
+BENCHMARK(BM_SortedVectorInsertErase)->ARGS;
+
 template <template <class, class> class Map>
 static void performFindTest(benchmark::State& state) {
     init();
@@ -83,10 +98,12 @@ static void performFindTest(benchmark::State& state) {
     for (int i = 0; i < state.range(0); ++i)
         map.insert({keys[i], vals[i]});
 
+    perftest::resetStatistics(map);
     for (auto _ : state) {
         for (int i = 0; i < n_test; ++i)
             benchmark::DoNotOptimize(map.count(keys[i]));
     }
+    perftest::reportStatistics(state, map);
 }
 
 static void BM_StdMapFind(benchmark::State& state) {
@@ -100,6 +117,80 @@ static void BM_PooledStdMapFind(benchmark::State& state) {
 BENCHMARK(BM_PooledStdMapFind)->ARGS;
 
 static void BM_MyMapFind(benchmark::State& state) {
-    performFindTest<maplib::OrderStatisticMap>(state);
+    performFindTest<perftest::OrderStatisticMap>(state);
 }
 BENCHMARK(BM_MyMapFind)->ARGS;
+
+static void BM_PbdsMapFind(benchmark::State& state) {
+    performFindTest<perftest::PbdsMap>(state);
+}
+BENCHMARK(BM_PbdsMapFind)->ARGS;
+
+static void BM_SortedVectorFind(benchmark::State& state) {
+    performFindTest<perftest::SortedVectorMap>(state);
+}
+BENCHMARK(BM_SortedVectorFind)->ARGS;
+
+// Access the i-th key, and compute the position of a key, for different ranks at each iteration.
+template <template <class, class> class Map>
+static void performFindByIndexTest(benchmark::State& state) {
+    init();
+    Map<Key, Value> map;
+    for (int i = 0; i < state.range(0); ++i)
+        map.insert({keys[i], vals[i]});
+
+    int idx = 0;
+    perftest::resetStatistics(map);
+    for (auto _ : state) {
+        for (int i = 0; i < n_test; ++i) {
+            benchmark::DoNotOptimize(perftest::keyByIndex(map, idx));
+            idx = (idx + 7919) % state.range(0);
+        }
+    }
+    perftest::reportStatistics(state, map);
+}
+
+template <template <class, class> class Map>
+static void performPositionTest(benchmark::State& state) {
+    init();
+    Map<Key, Value> map;
+    for (int i = 0; i < state.range(0); ++i)
+        map.insert({keys[i], vals[i]});
+
+    perftest::resetStatistics(map);
+    for (auto _ : state) {
+        for (int i = 0; i < n_test; ++i)
+            benchmark::DoNotOptimize(perftest::positionOf(map, keys[i]));
+    }
+    perftest::reportStatistics(state, map);
+}
+
+static void BM_MyMapFindByIndex(benchmark::State& state) {
+    performFindByIndexTest<perftest::OrderStatisticMap>(state);
+}
+BENCHMARK(BM_MyMapFindByIndex)->ARGS;
+
+static void BM_PbdsMapFindByIndex(benchmark::State& state) {
+    performFindByIndexTest<perftest::PbdsMap>(state);
+}
+BENCHMARK(BM_PbdsMapFindByIndex)->ARGS;
+
+static void BM_SortedVectorFindByIndex(benchmark::State& state) {
+    performFindByIndexTest<perftest::SortedVectorMap>(state);
+}
+BENCHMARK(BM_SortedVectorFindByIndex)->ARGS;
+
+static void BM_MyMapPosition(benchmark::State& state) {
+    performPositionTest<perftest::OrderStatisticMap>(state);
+}
+BENCHMARK(BM_MyMapPosition)->ARGS;
+
+static void BM_PbdsMapPosition(benchmark::State& state) {
+    performPositionTest<perftest::PbdsMap>(state);
+}
+BENCHMARK(BM_PbdsMapPosition)->ARGS;
+
+static void BM_SortedVectorPosition(benchmark::State& state) {
+    performPositionTest<perftest::SortedVectorMap>(state);
+}
+BENCHMARK(BM_SortedVectorPosition)->ARGS;
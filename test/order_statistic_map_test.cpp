@@ -147,3 +147,87 @@ TEST(OrderStatisticMapTest, IteratorValidity) {
   EXPECT_EQ(it, map.findByKey(4));
   EXPECT_EQ(4, it->second);
 }
+
+TEST(OrderStatisticMapTest, Compact) {
+  maplib::OrderStatisticMap<int, std::string> map;
+  std::map<int, std::string> std_map;
+
+  // Age the container with interleaved insertions and removals.
+  std::mt19937_64 rng(0);
+  std::uniform_int_distribution<int> distro(0, 200);
+  for (int i = 0; i < 1000; ++i) {
+    const int key = distro(rng);
+    if (i % 3 == 2) {
+      map.erase(key);
+      std_map.erase(key);
+    }
+    else {
+      map.insert(key, std::to_string(key));
+      std_map[key] = std::to_string(key);
+    }
+  }
+
+  map.compact();
+  ASSERT_TRUE(map.checkConsistency());
+  ASSERT_EQ(std_map.size(), map.size());
+
+  std::size_t idx = 0;
+  for (const auto& [key, val] : std_map) {
+    EXPECT_EQ(key, map.findByIndex(idx)->first);
+    EXPECT_EQ(val, map.findByKey(key)->second);
+    ++idx;
+  }
+
+  // The container stays usable.
+  map.insert(-1, "-1");
+  EXPECT_EQ(0, map.findByKey(-1).position());
+  EXPECT_TRUE(map.checkConsistency());
+
+  maplib::OrderStatisticMap<int, int> empty;
+  empty.compact();
+  EXPECT_EQ(0, empty.size());
+}
+
+TEST(OrderStatisticMapTest, EraseByIterator) {
+  maplib::OrderStatisticMap<int, int> map;
+  for (int i = 0; i < 200; ++i)
+    map.insert((i * 37) % 211, i);
+
+  for (int i = 0; i < 150; ++i) {
+    map.erase(map.findByIndex((i * 13) % map.size()));
+    ASSERT_TRUE(map.checkConsistency());
+    ASSERT_EQ(200 - i - 1, map.size());
+    ASSERT_EQ(map.size() - 1, map.findByIndex(map.size() - 1).position());
+  }
+}
+
+TEST(OrderStatisticMapTest, ExpectHint) {
+  maplib::OrderStatisticMap<int, int> map;
+  std::map<int, int> reference;
+  std::mt19937 rng(0);
+  std::uniform_int_distribution<int> key_distro(0, 300);
+
+  for (int i = 0; i < 3000; ++i) {
+    const int key = key_distro(rng);
+    const auto expect = i % 4 < 2 ? maplib::Expect::CHANGE : maplib::Expect::NO_CHANGE;
+    if (i % 2) {
+      EXPECT_EQ(reference.erase(key), map.erase(key, expect));
+    }
+    else {
+      const bool inserted = !reference.count(key);
+      reference[key] = i;
+      const auto [it, success] = map.insert(key, i, expect);
+      EXPECT_EQ(inserted, success);
+      EXPECT_EQ(i, it->second);
+    }
+    ASSERT_EQ(reference.size(), map.size());
+  }
+  ASSERT_TRUE(map.checkConsistency());
+
+  std::size_t index = 0;
+  for (const auto& [key, value] : reference) {
+    const auto it = map.findByIndex(index++);
+    EXPECT_EQ(key, it->first);
+    EXPECT_EQ(value, it->second);
+  }
+}
@@ -0,0 +1,120 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Test for the counter based generator and the parallel sampling of SamplingMap.
+
+#include "order_statistic_map/sampling_map.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+TEST(ParallelSampleTest, PhiloxKnownAnswers) {
+  // Reference values from the Random123 library.
+  using maplib::details::philox4x32;
+  using Counter = maplib::details::PhiloxCounter;
+
+  EXPECT_EQ(Counter({0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}),
+            philox4x32({0, 0, 0, 0}, {0, 0}));
+  EXPECT_EQ(Counter({0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}),
+            philox4x32({0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}, {0xffffffff, 0xffffffff}));
+  EXPECT_EQ(Counter({0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}),
+            philox4x32({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0}));
+
+  double mean = 0;
+  for (std::uint64_t i = 0; i < 10000; ++i) {
+    const double u = maplib::details::philoxUniform(42, i);
+    ASSERT_TRUE(u >= 0 && u < 1);
+    mean += u / 10000;
+  }
+  EXPECT_NEAR(0.5, mean, 0.01);
+}
+
+TEST(ParallelSampleTest, IndependentOfThreads) {
+  maplib::SamplingMap<int, int, double> map;
+  std::mt19937_64 rng(0);
+  std::uniform_real_distribution<double> distro(0, 1);
+  std::vector<double> weights;
+  for (int i = 0; i < 300; ++i) {
+    weights.push_back(i % 4 ? distro(rng) : 0.);
+    map.insert(i, i, weights.back());
+  }
+  const double total = map.totalWeight();
+
+  const std::size_t k = 100000;
+  std::vector<decltype(map)::const_iterator> reference;
+  std::as_const(map).parallelSample(k, 7, std::back_inserter(reference), 1);
+  ASSERT_EQ(k, reference.size());
+
+  for (unsigned n_threads : {2u, 3u, 8u, 64u}) {
+    std::vector<decltype(map)::iterator> samples;
+    map.parallelSample(k, 7, std::back_inserter(samples), n_threads);
+    ASSERT_EQ(k, samples.size());
+    for (std::size_t i = 0; i < k; ++i)
+      ASSERT_EQ(reference[i], samples[i]);
+  }
+
+  // Another seed gives another sequence.
+  std::vector<decltype(map)::const_iterator> other;
+  map.parallelSample(10, 8, std::back_inserter(other), 2);
+  EXPECT_NE(std::vector<decltype(map)::const_iterator>(reference.begin(), reference.begin() + 10),
+            other);
+
+  // Each sample follows the weights.
+  std::vector<int> counts(weights.size(), 0);
+  for (auto it : reference)
+    ++counts[it->first];
+  for (std::size_t i = 0; i < weights.size(); ++i) {
+    const double expected = k * weights[i] / total;
+    EXPECT_NEAR(counts[i], expected, 5 * std::sqrt(expected) + 1e-9);
+  }
+
+  // Integer weights and empty map.
+  maplib::SamplingMap<int, int, unsigned> map_int{{0, 0, 1}, {1, 0, 0}, {2, 0, 3}};
+  std::vector<decltype(map_int)::iterator> int_samples;
+  map_int.parallelSample(1000, 1, std::back_inserter(int_samples), 4);
+  for (auto it : int_samples)
+    EXPECT_TRUE(it && it->first != 1);
+
+  maplib::SamplingMap<int, int, double> empty;
+  std::vector<decltype(empty)::iterator> empty_samples;
+  empty.parallelSample(2, 1, std::back_inserter(empty_samples));
+  EXPECT_EQ(2, empty_samples.size());
+  EXPECT_FALSE(empty_samples[1]);
+}
+
+TEST(ParallelSampleTest, ThreadPool) {
+  maplib::details::ThreadPool pool;
+  std::vector<int> ran(8, 0);
+  pool.run(8, [&](const unsigned id) { ++ran[id]; });
+  EXPECT_EQ(std::vector<int>(8, 1), ran);
+  EXPECT_EQ(7, pool.size());
+
+  // Workers are reused.
+  pool.run(4, [&](const unsigned id) { ++ran[id]; });
+  EXPECT_EQ(7, pool.size());
+  EXPECT_EQ(2, ran[3]);
+  EXPECT_EQ(1, ran[4]);
+
+  // Exceptions of the workers reach the caller, after every task is complete.
+  std::atomic<int> completed(0);
+  EXPECT_THROW(pool.run(8,
+                        [&](const unsigned id) {
+                          if (id == 5)
+                            throw(std::runtime_error("Task failed."));
+                          ++completed;
+                        }),
+               std::runtime_error);
+  EXPECT_EQ(7, completed);
+}
@@ -0,0 +1,172 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Hardware performance counters of the calling thread, read with perf_event_open (Linux only).
+// The counts include the threads started by the calling thread after the counters are opened, once
+// they have been joined. When the kernel multiplexes more events than the hardware can count at
+// once, each count is extrapolated from the fraction of the time it was running.
+// Counters that can not be opened, because of the hardware, the virtualization layer or the
+// perf_event_paranoid setting, are silently skipped. Setting the environment variable
+// MAPLIB_PERF_COUNTERS=0 disables all of them.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace perftest {
+
+constexpr std::uint64_t cacheConfig(std::uint64_t cache, std::uint64_t op, std::uint64_t result) {
+  return cache | (op << 8) | (result << 16);
+}
+
+class PerfCounters {
+public:
+  PerfCounters();
+  ~PerfCounters();
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  // Resets and starts all the available counters.
+  void start() noexcept;
+
+  // Stops the counters and adds them to the benchmark, averaged over its iterations.
+  void report(benchmark::State& state) noexcept;
+
+  // Returns true if at least one counter is available.
+  bool available() const noexcept;
+
+  // Process wide instance used by resetStatistics and reportStatistics.
+  static PerfCounters& instance() {
+    static PerfCounters counters;
+    return counters;
+  }
+
+private:
+  struct Event {
+    const char* name;
+    std::uint32_t type;
+    std::uint64_t config;
+  };
+
+#ifdef __linux__
+  constexpr static std::array<Event, 5> events_{{
+      {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+      {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+      {"L1D_misses", PERF_TYPE_HW_CACHE,
+       cacheConfig(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ,
+                   PERF_COUNT_HW_CACHE_RESULT_MISS)},
+      {"LLC_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+      {"dTLB_misses", PERF_TYPE_HW_CACHE,
+       cacheConfig(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ,
+                   PERF_COUNT_HW_CACHE_RESULT_MISS)},
+  }};
+#else
+  constexpr static std::array<Event, 0> events_{};
+#endif
+
+  std::array<int, events_.size()> fds_;
+};
+
+#ifdef __linux__
+
+inline PerfCounters::PerfCounters() {
+  fds_.fill(-1);
+
+  const char* const env = std::getenv("MAPLIB_PERF_COUNTERS");
+  if (env && std::string(env) == "0")
+    return;
+
+  for (std::size_t i = 0; i < events_.size(); ++i) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = events_[i].type;
+    attr.config = events_[i].config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // Count the worker threads, e.g. of parallelSample. Excludes grouping the events.
+    attr.inherit = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    // Measure the calling thread on any cpu.
+    fds_[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+}
+
+inline PerfCounters::~PerfCounters() {
+  for (int fd : fds_) {
+    if (fd >= 0)
+      close(fd);
+  }
+}
+
+inline void PerfCounters::start() noexcept {
+  for (int fd : fds_) {
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+inline void PerfCounters::report(benchmark::State& state) noexcept {
+  for (int fd : fds_) {
+    if (fd >= 0)
+      ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+  }
+
+  for (std::size_t i = 0; i < events_.size(); ++i) {
+    struct {
+      std::uint64_t value;
+      std::uint64_t time_enabled;
+      std::uint64_t time_running;
+    } sample;
+    if (fds_[i] < 0 || read(fds_[i], &sample, sizeof(sample)) != sizeof(sample))
+      continue;
+    if (!sample.time_running)  // Never scheduled on the hardware: no estimate.
+      continue;
+
+    const double value =
+        static_cast<double>(sample.value) * sample.time_enabled / sample.time_running;
+    state.counters[events_[i].name] = benchmark::Counter(value, benchmark::Counter::kAvgIterations);
+  }
+}
+
+#else
+
+inline PerfCounters::PerfCounters() {}
+inline PerfCounters::~PerfCounters() {}
+inline void PerfCounters::start() noexcept {}
+inline void PerfCounters::report(benchmark::State&) noexcept {}
+
+#endif  // __linux__
+
+inline bool PerfCounters::available() const noexcept {
+  for (int fd : fds_) {
+    if (fd >= 0)
+      return true;
+  }
+  return false;
+}
+
+}  // namespace perftest
@@ -0,0 +1,174 @@
+#!/usr/bin/env python3
+"""Runs the perftests, stores a baseline, and reports statistically significant changes.
+
+Every perftest is run with repetitions and JSON output. The real time of each repetition is
+compared against the baseline with a two-sided Mann-Whitney U test, as done by google benchmark's
+compare.py. A benchmark regresses if the test is significant and the median slows down by more
+than the threshold. Only the python standard library is required.
+"""
+from __future__ import print_function
+import argparse
+import json
+import math
+import os
+import subprocess
+import sys
+
+
+def parse_args():
+    """Parse commandline arguments"""
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument(
+        '--perftests', nargs='+', required=True, help='perftest executables to run')
+    parser.add_argument(
+        '--baseline-dir', required=True, help='directory storing the baseline JSON files')
+    parser.add_argument(
+        '--output-dir', default='.', help='directory storing the JSON files of the new run')
+    parser.add_argument(
+        '--update-baseline', action='store_true',
+        help='store the new run as baseline instead of comparing')
+    parser.add_argument(
+        '--repetitions', type=int, default=10, help='repetitions of each benchmark')
+    parser.add_argument(
+        '--filter', default='', help='regular expression selecting the benchmarks to run')
+    parser.add_argument(
+        '--alpha', type=float, default=0.05, help='significance level of the U test')
+    parser.add_argument(
+        '--threshold', type=float, default=0.05,
+        help='relative change of the median below which differences are ignored')
+    return parser.parse_args()
+
+
+def run_perftest(executable, output, args):
+    """Run one perftest and return its JSON result"""
+    command = [executable, '--benchmark_format=json',
+               '--benchmark_repetitions=%d' % args.repetitions,
+               '--benchmark_out_format=json', '--benchmark_out=' + output]
+    if args.filter:
+        command.append('--benchmark_filter=' + args.filter)
+    print('Running', os.path.basename(executable), file=sys.stderr)
+    subprocess.run(command, check=True, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+
+    # Nothing is written if the filter does not match any benchmark.
+    if os.path.exists(output) and os.path.getsize(output):
+        with open(output) as file:
+            return json.load(file)
+    if os.path.exists(output):
+        os.remove(output)
+    return {'benchmarks': []}
+
+
+def collect_times(result):
+    """Map each benchmark name to the real time of its repetitions, in ns"""
+    scale = {'ns': 1., 'us': 1e3, 'ms': 1e6, 's': 1e9}
+    times = {}
+    for bench in result['benchmarks']:
+        if bench.get('run_type', 'iteration') != 'iteration':
+            continue  # mean, median and stddev aggregates.
+        name = bench.get('run_name', bench['name'])
+        times.setdefault(name, []).append(bench['real_time'] * scale[bench['time_unit']])
+    return times
+
+
+def median(values):
+    values = sorted(values)
+    mid = len(values) // 2
+    return values[mid] if len(values) % 2 else 0.5 * (values[mid - 1] + values[mid])
+
+
+def mann_whitney_p_value(x, y):
+    """Two-sided p-value of the U test, with normal approximation and tie correction"""
+    n1, n2 = len(x), len(y)
+    if n1 < 2 or n2 < 2:
+        return 1.
+    pooled = sorted([(v, 0) for v in x] + [(v, 1) for v in y])
+
+    # Average ranks of tied values.
+    ranks = [0.] * len(pooled)
+    tie_term = 0.
+    i = 0
+    while i < len(pooled):
+        j = i
+        while j + 1 < len(pooled) and pooled[j + 1][0] == pooled[i][0]:
+            j += 1
+        for k in range(i, j + 1):
+            ranks[k] = 0.5 * (i + j) + 1
+        tie_term += (j - i + 1) ** 3 - (j - i + 1)
+        i = j + 1
+
+    rank_sum = sum(r for r, (_, group) in zip(ranks, pooled) if group == 0)
+    u = rank_sum - n1 * (n1 + 1) / 2.
+    n = n1 + n2
+    variance = n1 * n2 / 12. * ((n + 1) - tie_term / (n * (n - 1)))
+    if variance <= 0:
+        return 1.
+    z = (abs(u - n1 * n2 / 2.) - 0.5) / math.sqrt(variance)
+    return math.erfc(max(z, 0.) / math.sqrt(2))
+
+
+def compare(baseline, current, args):
+    """Print the summary table and return the number of regressions"""
+    rows = []
+    regressions = 0
+    for name in sorted(set(baseline) & set(current)):
+        old, new = baseline[name], current[name]
+        old_median, new_median = median(old), median(new)
+        change = new_median / old_median - 1. if old_median > 0 else 0.
+        p_value = mann_whitney_p_value(old, new)
+
+        status = ''
+        if p_value < args.alpha and abs(change) > args.threshold:
+            status = 'REGRESSION' if change > 0 else 'improvement'
+            regressions += change > 0
+        rows.append((name, '%.1f' % old_median, '%.1f' % new_median, '%+.1f%%' % (100 * change),
+                     '%.4f' % p_value, status))
+
+    header = ('benchmark', 'baseline [ns]', 'new [ns]', 'change', 'p-value', '')
+    widths = [max(len(row[i]) for row in rows + [header]) for i in range(len(header))]
+    line = '  '.join('%-' + str(w) + 's' for w in widths)
+    print(line % header)
+    print('  '.join('-' * w for w in widths))
+    for row in rows:
+        print(line % row)
+
+    missing = sorted(set(baseline) ^ set(current))
+    if missing:
+        print('\nBenchmarks present in only one of the runs: ' + ', '.join(missing))
+    print('\n%d regressions out of %d benchmarks (alpha = %g, threshold = %g%%).'
+          % (regressions, len(rows), args.alpha, 100 * args.threshold))
+    return regressions
+
+
+def main():
+    """Entry point of the program"""
+    args = parse_args()
+    target_dir = args.baseline_dir if args.update_baseline else args.output_dir
+    os.makedirs(target_dir, exist_ok=True)
+    os.makedirs(args.baseline_dir, exist_ok=True)
+
+    baseline, current = {}, {}
+    for executable in args.perftests:
+        filename = os.path.basename(executable) + '.json'
+        baseline_file = os.path.join(args.baseline_dir, filename)
+
+        if not args.update_baseline and not os.path.exists(baseline_file):
+            print('No baseline for %s: storing this run as baseline.' % filename, file=sys.stderr)
+            run_perftest(executable, baseline_file, args)
+            continue
+
+        result = run_perftest(executable, os.path.join(target_dir, filename), args)
+        if args.update_baseline or not result['benchmarks']:
+            continue
+        current.update(collect_times(result))
+        with open(baseline_file) as file:
+            baseline.update(collect_times(json.load(file)))
+
+    if args.update_baseline or not current:
+        print('Baseline stored in ' + args.baseline_dir, file=sys.stderr)
+        return 0
+
+    return 1 if compare(baseline, current, args) else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,93 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Reports the operation counters of the maplib containers as google benchmark user counters.
+// The containers below count the work only if the perftests are compiled with
+// MAPLIB_ENABLE_STATISTICS. Counters are ignored for containers that do not count them, such as
+// std::map.
+// The available hardware counters are reported for every container.
+
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include <benchmark/benchmark.h>
+
+#include "order_statistic_map/multi_sampling_map.hpp"
+#include "order_statistic_map/order_statistic_map.hpp"
+#include "order_statistic_map/sampling_map.hpp"
+#include "order_statistic_map/sampling_set.hpp"
+#include "perf_counters.hpp"
+
+namespace perftest {
+
+#ifdef MAPLIB_ENABLE_STATISTICS
+using Stats = maplib::CountingStatistics;
+#else
+using Stats = maplib::NoStatistics;
+#endif
+
+// Containers under test, with the statistics policy selected above.
+template <class Key, class Value>
+using OrderStatisticMap = maplib::OrderStatisticMap<Key, Value, 64, Stats>;
+template <class Key, class Value, class Weight>
+using SamplingMap = maplib::SamplingMap<Key, Value, Weight, 64, false, void, Stats>;
+template <class Key, class Value, class Weight>
+using RankedSamplingMap = maplib::RankedSamplingMap<Key, Value, Weight, 64, Stats>;
+template <class Key, class Value, class Weight, class Augmentation>
+using AugmentedSamplingMap =
+    maplib::AugmentedSamplingMap<Key, Value, Weight, Augmentation, 64, Stats>;
+template <class Key, class Value, class Weight, std::size_t channels>
+using MultiSamplingMap = maplib::MultiSamplingMap<Key, Value, Weight, channels, 64, Stats>;
+template <class Key, class Weight>
+using SamplingSet = maplib::SamplingSet<Key, Weight, 64, Stats>;
+
+template <class Map, class = void>
+struct HasStatistics : std::false_type {};
+template <class Map>
+struct HasStatistics<Map, std::void_t<decltype(std::declval<const Map&>().stats())>>
+    : std::true_type {};
+
+template <class Map, class = void>
+struct CountsStatistics : std::false_type {};
+template <class Map>
+struct CountsStatistics<Map, std::void_t<typename Map::statistics_type>>
+    : std::bool_constant<Map::statistics_type::enabled> {};
+
+// Discards the work performed while filling the container. Call before the benchmark loop.
+template <class Map>
+void resetStatistics(Map& map) {
+  if constexpr (HasStatistics<Map>::value)
+    map.resetStats();
+  PerfCounters::instance().start();
+}
+
+// Adds the counters, averaged over the benchmark iterations. Call after the benchmark loop.
+template <class Map>
+void reportStatistics(benchmark::State& state, const Map& map) {
+  PerfCounters::instance().report(state);
+
+  if constexpr (CountsStatistics<Map>::value) {
+    const auto counters = map.stats();
+    const auto average = [](std::size_t value) {
+      return benchmark::Counter(value, benchmark::Counter::kAvgIterations);
+    };
+
+    state.counters["comparisons"] = average(counters.comparisons);
+    state.counters["descended_nodes"] = average(counters.descended_nodes);
+    state.counters["rotations"] = average(counters.rotations);
+    state.counters["undone_insertions"] = average(counters.undone_insertions);
+    state.counters["undone_erasures"] = average(counters.undone_erasures);
+    state.counters["max_fix_depth"] = counters.max_fix_depth;
+    state.counters["pools"] = counters.pool_allocations;
+  }
+}
+
+}  // namespace perftest
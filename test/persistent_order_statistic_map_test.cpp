@@ -0,0 +1,100 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Test for the PersistentOrderStatisticMap class.
+
+#include "order_statistic_map/persistent_order_statistic_map.hpp"
+
+#include <cstdio>
+#include <map>
+#include <random>
+
+#include "gtest/gtest.h"
+
+class PersistentOrderStatisticMapTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    std::remove(filename_.c_str());
+  }
+  void TearDown() override {
+    std::remove(filename_.c_str());
+  }
+
+  const std::string filename_ = "persistent_order_statistic_map_test.bin";
+};
+
+TEST_F(PersistentOrderStatisticMapTest, InsertFindErase) {
+  maplib::PersistentOrderStatisticMap<int, double> map(filename_);
+  EXPECT_EQ(0, map.size());
+  EXPECT_FALSE(map.erase(1));
+
+  map.insert(2, 0.5);
+  map.insert(1, 1.5);
+  EXPECT_EQ(2, map.size());
+
+  EXPECT_EQ(1.5, map.findByKey(1)->second);
+  EXPECT_EQ(2, map.findByIndex(1)->first);
+  EXPECT_THROW(map.findByIndex(2), std::out_of_range);
+
+  auto [it, inserted] = map.insert(2, 3.);
+  EXPECT_FALSE(inserted);
+  EXPECT_EQ(3., it->second);
+  EXPECT_EQ(1, it.position());
+
+  map.erase(map.findByKey(1));
+  EXPECT_TRUE(map.erase(2));
+  EXPECT_EQ(0, map.size());
+}
+
+TEST_F(PersistentOrderStatisticMapTest, Reopen) {
+  std::map<int, int> std_map;
+  std::mt19937_64 rng(0);
+  std::uniform_int_distribution<int> distro(0, 500);
+
+  {
+    // A small initial capacity forces the file to grow and be remapped.
+    maplib::PersistentOrderStatisticMap<int, int> map(filename_, 4);
+    for (int i = 0; i < 1000; ++i) {
+      const int key = distro(rng);
+      if (i % 4 == 3) {
+        EXPECT_EQ(std_map.erase(key), map.erase(key));
+      }
+      else {
+        map.insert(key, i);
+        std_map[key] = i;
+      }
+    }
+    ASSERT_TRUE(map.checkConsistency());
+    map.sync();
+  }
+
+  maplib::PersistentOrderStatisticMap<int, int> reopened(filename_);
+  ASSERT_TRUE(reopened.checkConsistency());
+  ASSERT_EQ(std_map.size(), reopened.size());
+
+  std::size_t idx = 0;
+  for (const auto& [key, val] : std_map) {
+    EXPECT_EQ(key, reopened.findByIndex(idx)->first);
+    EXPECT_EQ(val, reopened.findByKey(key)->second);
+    ++idx;
+  }
+
+  // The reopened map can be modified.
+  reopened.insert(-1, -1);
+  EXPECT_EQ(0, reopened.findByKey(-1).position());
+  EXPECT_TRUE(reopened.checkConsistency());
+}
+
+TEST_F(PersistentOrderStatisticMapTest, WrongType) {
+  {
+    maplib::PersistentOrderStatisticMap<int, int> map(filename_);
+    map.insert(1, 1);
+  }
+  using OtherMap = maplib::PersistentOrderStatisticMap<int, double>;
+  EXPECT_THROW(OtherMap map(filename_), std::runtime_error);
+}
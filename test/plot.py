@@ -36,8 +36,9 @@ def parse_args():
         '-f', metavar='FILE', type=argparse.FileType('r'), default=sys.stdin,
         dest='file', help='path to file containing the csv benchmark data')
     parser.add_argument(
-        '-m', metavar='METRIC', choices=METRICS, default=METRICS[0], dest='metric',
-        help='metric to plot on the y-axis, valid choices are: %s' % ', '.join(METRICS))
+        '-m', metavar='METRIC', default=METRICS[0], dest='metric',
+        help='metric to plot on the y-axis: one of %s, or the name of any user counter, '
+        'e.g. instructions or L1D_misses' % ', '.join(METRICS))
     parser.add_argument(
         '-t', metavar='TRANSFORM', choices=TRANSFORMS.keys(), default='',
         help='transform to apply to the chosen metric, valid choices are: %s'
@@ -74,11 +75,19 @@ def parse_input_size(name):
 def read_data(args):
     """Read and process dataframe using commandline args"""
     try:
-        data = pd.read_csv(args.file, usecols=['name', args.metric])
+        data = pd.read_csv(args.file)
     except ValueError:
+        data = None
+    if data is None or 'name' not in data.columns:
         msg = 'Could not parse the benchmark data. Did you forget "--benchmark_format=csv"?'
         logging.error(msg)
         exit(1)
+    if args.metric not in data.columns:
+        msg = 'Metric %s is not present in the benchmark output. Available: %s'
+        logging.error(msg, args.metric, ', '.join(data.columns[1:]))
+        exit(1)
+    # Benchmarks that do not report a counter are left out of its plot.
+    data = data[['name', args.metric]].dropna()
 
     scale = 1.
 
@@ -96,6 +105,19 @@ def plot_groups(label_groups, args):
         elif label.find("Pooled") >= 0  : label = "pooled std::map"
         elif label.find("StdMap") >= 0  : label = "std::map"
         elif label.find("StdUnorderedMap") >= 0  : label = "std::unordered_map"
+        elif label.find("DynamicSamplingSet") >= 0  : label = "DynamicSamplingSet"
+        elif label.find("RankedSamplingMap") >= 0  : label = "RankedSamplingMap"
+        elif label.find("AugmentedSamplingMap") >= 0  : label = "AugmentedSamplingMap"
+        elif label.find("MultiSamplingMap") >= 0  : label = "MultiSamplingMap"
+        elif label.find("PerChannel") >= 0  : label = "SamplingMap per channel"
+        elif label.find("TwoTrees") >= 0  : label = "OrderStatisticMap + SamplingMap"
+        elif label.find("SamplingMap") >= 0  : label = "SamplingMap"
+        elif label.find("SamplingSet") >= 0  : label = "SamplingSet"
+        elif label.find("MySet") >= 0  : label = "OrderStatisticSet"
+        elif label.find("StdSet") >= 0  : label = "std::set"
+        elif label.find("Pbds") >= 0  : label = "__gnu_pbds::tree"
+        elif label.find("SortedVector") >= 0  : label = "sorted std::vector"
+        elif label.find("AliasSampler") >= 0  : label = "alias table"
 
         plt.plot(group['input'], group[args.metric], '--o', label=label)
     if args.logx:
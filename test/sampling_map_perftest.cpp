@@ -8,13 +8,23 @@
 //
 // OrderStatisticMap performance test
 
+#include "order_statistic_map/multi_sampling_map.hpp"
 #include "order_statistic_map/sampling_map.hpp"
+#include "order_statistic_map/sampling_set.hpp"
+#include "order_statistic_map/dynamic_sampling_set.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iterator>
 #include <vector>
 #include <random>
 
 #include <benchmark/benchmark.h>
 
+#include "competitors.hpp"
+#include "perftest_statistics.hpp"
+
 const unsigned n_init = 10000;
 const unsigned n_test = 10;
 
@@ -42,33 +52,582 @@ void init() {
   std::random_shuffle(weights.begin(), weights.end());
 }
 
-static void BM_SamplingMapInsertErase(benchmark::State& state) {
+template <class Map>
+static void performInsertEraseTest(benchmark::State& state) {
   init();
-  maplib::SamplingMap<Key, Value, float> map;
+  Map map;
   for (int i = 0; i < state.range(0); ++i)
     map.insert(keys[i], vals[i], weights[i]);
 
+  perftest::resetStatistics(map);
   for (auto _ : state) {
     for (int i = n_init; i < n_init + n_test; ++i)
       map.insert(keys[i], vals[i], weights[i]);
     for (int i = n_init; i < n_init + n_test; ++i)
       map.erase(keys[i]);
   }
+  perftest::reportStatistics(state, map);
+}
+
+static void BM_SamplingMapInsertErase(benchmark::State& state) {
+  performInsertEraseTest<perftest::SamplingMap<Key, Value, float>>(state);
 }
 BENCHMARK(BM_SamplingMapInsertErase)->Arg(100)->Arg(1000)->Arg(n_init);
 
-static void BM_SamplingMapSample(benchmark::State& state) {
+static void BM_RankedSamplingMapInsertErase(benchmark::State& state) {
+  performInsertEraseTest<perftest::RankedSamplingMap<Key, Value, float>>(state);
+}
+BENCHMARK(BM_RankedSamplingMapInsertErase)->Arg(100)->Arg(1000)->Arg(n_init);
+
+static void BM_AugmentedSamplingMapInsertErase(benchmark::State& state) {
+  using Augmentation = maplib::augmentation::MaxWeight<float>;
+  performInsertEraseTest<perftest::AugmentedSamplingMap<Key, Value, float, Augmentation>>(state);
+}
+BENCHMARK(BM_AugmentedSamplingMapInsertErase)->Arg(100)->Arg(1000)->Arg(n_init);
+
+static void BM_TwoTreesInsertErase(benchmark::State& state) {
+  performInsertEraseTest<perftest::TwoTreesSamplingMap<Key, Value, float>>(state);
+}
+BENCHMARK(BM_TwoTreesInsertErase)->Arg(100)->Arg(1000)->Arg(n_init);
+
+static void BM_SortedVectorInsertErase(benchmark::State& state) {
+  performInsertEraseTest<perftest::SortedVectorSamplingMap<Key, Value, float>>(state);
+}
+BENCHMARK(BM_SortedVectorInsertErase)->Arg(100)->Arg(1000)->Arg(n_init);
+
+template <class Map>
+static void performSampleTest(benchmark::State& state) {
   init();
-  maplib::SamplingMap<Key, Value, float> map;
+  Map map;
   for (int i = 0; i < state.range(0); ++i)
     map.insert(keys[i], vals[i], weights[i]);
 
-  std::vector<maplib::SamplingMap<Key, Value, float>::iterator> findings(n_test);
+  std::vector<decltype(map.sample(std::declval<std::ranlux24_base&>()))> findings(n_test);
   std::ranlux24_base rng(0);
 
+  perftest::resetStatistics(map);
   for (auto _ : state) {
     for (int i = 0; i < n_test; ++i)
       findings[i] = map.sample(rng);
   }
+  perftest::reportStatistics(state, map);
+}
+
+static void BM_SamplingMapSample(benchmark::State& state) {
+  performSampleTest<perftest::SamplingMap<Key, Value, float>>(state);
 }
 BENCHMARK(BM_SamplingMapSample)->Arg(100)->Arg(1000)->Arg(n_init);
+
+static void BM_SortedVectorSample(benchmark::State& state) {
+  performSampleTest<perftest::SortedVectorSamplingMap<Key, Value, float>>(state);
+}
+BENCHMARK(BM_SortedVectorSample)->Arg(100)->Arg(1000)->Arg(n_init);
+
+// Draws state.range(1) samples per iteration, either one at a time or as a single batch.
+template <bool batch>
+static void performBatchSampleTest(benchmark::State& state) {
+  init();
+  perftest::SamplingMap<Key, Value, float> map;
+  for (int i = 0; i < state.range(0); ++i)
+    map.insert(keys[i], vals[i], weights[i]);
+
+  const std::size_t k = state.range(1);
+  std::vector<decltype(map)::iterator> findings;
+  findings.reserve(k);
+  std::ranlux24_base rng(0);
+
+  perftest::resetStatistics(map);
+  for (auto _ : state) {
+    findings.clear();
+    if constexpr (batch) {
+      map.sampleBatch(rng, k, std::back_inserter(findings));
+    }
+    else {
+      for (std::size_t i = 0; i < k; ++i)
+        findings.push_back(map.sample(rng));
+    }
+    benchmark::DoNotOptimize(findings.data());
+  }
+  perftest::reportStatistics(state, map);
+  state.SetItemsProcessed(state.iterations() * k);
+}
+
+static void BM_SamplingMapSampleLoop(benchmark::State& state) {
+  performBatchSampleTest<false>(state);
+}
+BENCHMARK(BM_SamplingMapSampleLoop)->ArgsProduct({{1000, n_init}, {10, 1000, 100000}});
+
+static void BM_SamplingMapSampleBatch(benchmark::State& state) {
+  performBatchSampleTest<true>(state);
+}
+BENCHMARK(BM_SamplingMapSampleBatch)->ArgsProduct({{1000, n_init}, {10, 1000, 100000}});
+
+// Draws state.range(1) distinct samples per iteration, either with the side table of removed
+// weights, or by zeroing the weight of each sample and restoring it afterwards.
+template <bool side_table>
+static void performDistinctSampleTest(benchmark::State& state) {
+  init();
+  perftest::SamplingMap<Key, Value, float> map;
+  for (int i = 0; i < state.range(0); ++i)
+    map.insert(keys[i], vals[i], weights[i]);
+
+  const std::size_t k = state.range(1);
+  std::vector<decltype(map)::iterator> findings;
+  std::vector<float> old_weights;
+  findings.reserve(k);
+  std::ranlux24_base rng(0);
+
+  perftest::resetStatistics(map);
+  for (auto _ : state) {
+    findings.clear();
+    if constexpr (side_table) {
+      map.sampleWithoutReplacement(rng, k, std::back_inserter(findings));
+    }
+    else {
+      old_weights.clear();
+      for (std::size_t i = 0; i < k; ++i) {
+        findings.push_back(map.sample(rng));
+        old_weights.push_back(findings.back().getWeight());
+        findings.back().setWeight(0);
+      }
+      for (std::size_t i = 0; i < k; ++i)
+        findings[i].setWeight(old_weights[i]);
+    }
+    benchmark::DoNotOptimize(findings.data());
+  }
+  perftest::reportStatistics(state, map);
+}
+
+static void BM_SamplingMapDistinctSetWeight(benchmark::State& state) {
+  performDistinctSampleTest<false>(state);
+}
+BENCHMARK(BM_SamplingMapDistinctSetWeight)->ArgsProduct({{1000, n_init}, {10, 100}});
+
+static void BM_SamplingMapDistinctSideTable(benchmark::State& state) {
+  performDistinctSampleTest<true>(state);
+}
+BENCHMARK(BM_SamplingMapDistinctSideTable)->ArgsProduct({{1000, n_init}, {10, 100}});
+
+static void BM_AliasSamplerSample(benchmark::State& state) {
+  init();
+  perftest::SamplingMap<Key, Value, float> map;
+  for (int i = 0; i < state.range(0); ++i)
+    map.insert(keys[i], vals[i], weights[i]);
+  const auto sampler = map.buildStaticSampler();
+
+  std::vector<decltype(map)::iterator> findings(n_test);
+  std::ranlux24_base rng(0);
+
+  perftest::resetStatistics(map);
+  for (auto _ : state) {
+    for (int i = 0; i < n_test; ++i)
+      findings[i] = sampler.sample(rng);
+  }
+  perftest::reportStatistics(state, map);
+}
+BENCHMARK(BM_AliasSamplerSample)->Arg(100)->Arg(1000)->Arg(n_init);
+
+static void BM_AliasSamplerBuild(benchmark::State& state) {
+  init();
+  perftest::SamplingMap<Key, Value, float> map;
+  for (int i = 0; i < state.range(0); ++i)
+    map.insert(keys[i], vals[i], weights[i]);
+
+  for (auto _ : state)
+    benchmark::DoNotOptimize(map.buildStaticSampler());
+}
+BENCHMARK(BM_AliasSamplerBuild)->Arg(100)->Arg(1000)->Arg(n_init);
+
+// Weighted sets of state.range(0) keys, with weights uniform in [0, 1) if state.range(1) == 0, or
+// log-uniform over 2^[-20, 20) otherwise.
+std::vector<float> makeWeights(std::size_t n, bool log_uniform, std::mt19937& rng) {
+  std::uniform_real_distribution<float> distro(log_uniform ? -20 : 0, log_uniform ? 20 : 1);
+  std::vector<float> result(n);
+  for (auto& w : result)
+    w = log_uniform ? std::exp2(distro(rng)) : distro(rng);
+  return result;
+}
+
+template <class Set>
+static void performSetSampleTest(benchmark::State& state) {
+  std::mt19937 rng(0);
+  const auto set_weights = makeWeights(state.range(0), state.range(1), rng);
+  Set set;
+  for (int i = 0; i < state.range(0); ++i)
+    set.insert(i, set_weights[i]);
+
+  std::vector<int> findings(n_test);
+  for (auto _ : state) {
+    for (int i = 0; i < n_test; ++i)
+      findings[i] = set.sample(rng);
+    benchmark::DoNotOptimize(findings.data());
+  }
+}
+
+// Changes the weight of n_test random keys with an erasure and an insertion.
+template <class Set>
+static void performSetUpdateTest(benchmark::State& state) {
+  std::mt19937 rng(0);
+  const int n = state.range(0);
+  const auto set_weights = makeWeights(n, state.range(1), rng);
+  Set set;
+  for (int i = 0; i < n; ++i)
+    set.insert(i, set_weights[i]);
+
+  std::uniform_int_distribution<int> key_distro(0, n - 1);
+  std::vector<int> updated(n_test);
+  for (auto _ : state) {
+    for (auto& key : updated) {
+      key = key_distro(rng);
+      set.erase(key);
+    }
+    for (int i = 0; i < n_test; ++i)
+      set.insert(updated[i], set_weights[(updated[i] + 1) % n]);
+  }
+}
+
+#define SET_ARGS ArgsProduct({benchmark::CreateRange(1 << 10, 1 << 20, 32), {0, 1}})
+
+static void BM_SamplingSetDraw(benchmark::State& state) {
+  performSetSampleTest<perftest::SamplingSet<int, float>>(state);
+}
+BENCHMARK(BM_SamplingSetDraw)->SET_ARGS;
+
+static void BM_DynamicSamplingSetDraw(benchmark::State& state) {
+  performSetSampleTest<maplib::DynamicSamplingSet<int, float>>(state);
+}
+BENCHMARK(BM_DynamicSamplingSetDraw)->SET_ARGS;
+
+static void BM_SamplingSetReweight(benchmark::State& state) {
+  performSetUpdateTest<perftest::SamplingSet<int, float>>(state);
+}
+BENCHMARK(BM_SamplingSetReweight)->SET_ARGS;
+
+static void BM_DynamicSamplingSetReweight(benchmark::State& state) {
+  performSetUpdateTest<maplib::DynamicSamplingSet<int, float>>(state);
+}
+BENCHMARK(BM_DynamicSamplingSetReweight)->SET_ARGS;
+
+// Draws 10^6 samples with state.range(0) threads. The output does not depend on the thread count.
+static void BM_SamplingMapParallelSample(benchmark::State& state) {
+  init();
+  perftest::SamplingMap<Key, Value, float> map;
+  for (int i = 0; i < n_init; ++i)
+    map.insert(keys[i], vals[i], weights[i]);
+
+  const std::size_t k = 1000000;
+  std::vector<decltype(map)::const_iterator> findings(k);
+  std::uint64_t seed = 0;
+
+  perftest::resetStatistics(map);
+  for (auto _ : state) {
+    map.parallelSample(k, seed++, findings.begin(), state.range(0));
+    benchmark::DoNotOptimize(findings.data());
+  }
+  perftest::reportStatistics(state, map);
+  state.SetItemsProcessed(state.iterations() * k);
+}
+BENCHMARK(BM_SamplingMapParallelSample)->RangeMultiplier(2)->Range(1, 64)->UseRealTime();
+
+// Changes the weight of state.range(0) random entries out of n_init, one at a time or in a batch.
+// With state.range(0) == n_init the whole population is reweighted.
+template <bool batch>
+static void performReweightTest(benchmark::State& state) {
+  init();
+  perftest::SamplingMap<Key, Value, float> map;
+  for (int i = 0; i < n_init; ++i)
+    map.insert(keys[i], vals[i], weights[i]);
+
+  // Alternate between two sets of weights, so that every update changes the weight.
+  std::vector<std::pair<decltype(map)::iterator, float>> update_sets[2];
+  for (int i = 0; i < state.range(0); ++i) {
+    update_sets[0].emplace_back(map.findByKey(keys[i]), weights[(i + 1) % n_init]);
+    update_sets[1].emplace_back(map.findByKey(keys[i]), weights[i]);
+  }
+
+  int parity = 0;
+  perftest::resetStatistics(map);
+  for (auto _ : state) {
+    const auto& updates = update_sets[parity];
+    parity = !parity;
+    if constexpr (batch) {
+      map.setWeights(updates.begin(), updates.end());
+    }
+    else {
+      for (auto [it, weight] : updates)
+        it.setWeight(weight);
+    }
+  }
+  perftest::reportStatistics(state, map);
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_SamplingMapSetWeightLoop(benchmark::State& state) {
+  performReweightTest<false>(state);
+}
+BENCHMARK(BM_SamplingMapSetWeightLoop)->Arg(10)->Arg(100)->Arg(1000)->Arg(n_init);
+
+static void BM_SamplingMapSetWeights(benchmark::State& state) {
+  performReweightTest<true>(state);
+}
+BENCHMARK(BM_SamplingMapSetWeights)->Arg(10)->Arg(100)->Arg(1000)->Arg(n_init);
+
+// Multiplies the weights of the keys in [0, state.range(0)) by a factor, one entry at a time or
+// lazily with scaleRange. The factor alternates between 2 and 0.5 to keep the weights bounded.
+template <bool lazy>
+static void performScaleTest(benchmark::State& state) {
+  init();
+  perftest::SamplingMap<Key, Value, float> map;
+  for (int i = 0; i < n_init; ++i)
+    map.insert(keys[i], vals[i], weights[i]);
+
+  std::vector<decltype(map)::iterator> in_range;
+  for (int key = 0; key < state.range(0); ++key) {
+    if (auto it = map.findByKey(key))
+      in_range.push_back(it);
+  }
+
+  float factor = 2;
+  perftest::resetStatistics(map);
+  for (auto _ : state) {
+    if constexpr (lazy) {
+      map.scaleRange(0, state.range(0), factor);
+    }
+    else {
+      for (auto it : in_range)
+        it.setWeight(it.getWeight() * factor);
+    }
+    factor = 1 / factor;
+  }
+  perftest::reportStatistics(state, map);
+  state.SetItemsProcessed(state.iterations() * in_range.size());
+}
+
+static void BM_SamplingMapScaleLoop(benchmark::State& state) {
+  performScaleTest<false>(state);
+}
+BENCHMARK(BM_SamplingMapScaleLoop)->Arg(10)->Arg(100)->Arg(1000)->Arg(n_init);
+
+static void BM_SamplingMapScaleRange(benchmark::State& state) {
+  performScaleTest<true>(state);
+}
+BENCHMARK(BM_SamplingMapScaleRange)->Arg(10)->Arg(100)->Arg(1000)->Arg(n_init);
+
+// Computes the weight of the keys below n_test random keys, with a linear scan or in O(log n).
+template <bool scan>
+static void performCumulativeWeightTest(benchmark::State& state) {
+  init();
+  perftest::SamplingMap<Key, Value, float> map;
+  for (int i = 0; i < state.range(0); ++i)
+    map.insert(keys[i], vals[i], weights[i]);
+
+  float result = 0;
+  perftest::resetStatistics(map);
+  for (auto _ : state) {
+    for (int i = 0; i < n_test; ++i) {
+      const Key bound = keys[i];
+      if constexpr (scan) {
+        float prefix = 0;
+        for (auto it = map.begin(); it != map.end() && it->first < bound; ++it)
+          prefix += it.getWeight();
+        result += prefix;
+      }
+      else {
+        result += map.cumulativeWeight(bound);
+      }
+    }
+  }
+  benchmark::DoNotOptimize(result);
+  perftest::reportStatistics(state, map);
+}
+
+static void BM_SamplingMapCumulativeWeightScan(benchmark::State& state) {
+  performCumulativeWeightTest<true>(state);
+}
+BENCHMARK(BM_SamplingMapCumulativeWeightScan)->Arg(100)->Arg(1000)->Arg(n_init);
+
+static void BM_SamplingMapCumulativeWeight(benchmark::State& state) {
+  performCumulativeWeightTest<false>(state);
+}
+BENCHMARK(BM_SamplingMapCumulativeWeight)->Arg(100)->Arg(1000)->Arg(n_init);
+
+// Largest weight in a range of keys.
+template <bool scan>
+static void performRangeMaxTest(benchmark::State& state) {
+  init();
+  perftest::AugmentedSamplingMap<Key, Value, float, maplib::augmentation::MaxWeight<float>> map;
+  for (int i = 0; i < state.range(0); ++i)
+    map.insert(keys[i], vals[i], weights[i]);
+
+  float result = 0;
+  perftest::resetStatistics(map);
+  for (auto _ : state) {
+    for (int i = 0; i < n_test; ++i) {
+      const Key lo = std::min(keys[i], keys[i + 1]);
+      const Key hi = std::max(keys[i], keys[i + 1]);
+      if constexpr (scan) {
+        float max = 0;
+        for (auto it = map.begin(); it != map.end() && it->first < hi; ++it) {
+          if (it->first >= lo)
+            max = std::max(max, it.getWeight());
+        }
+        result += max;
+      }
+      else {
+        result += map.aggregate(lo, hi);
+      }
+    }
+  }
+  benchmark::DoNotOptimize(result);
+  perftest::reportStatistics(state, map);
+}
+
+static void BM_SamplingMapRangeMaxScan(benchmark::State& state) {
+  performRangeMaxTest<true>(state);
+}
+BENCHMARK(BM_SamplingMapRangeMaxScan)->Arg(100)->Arg(1000)->Arg(n_init);
+
+static void BM_SamplingMapRangeMax(benchmark::State& state) {
+  performRangeMaxTest<false>(state);
+}
+BENCHMARK(BM_SamplingMapRangeMax)->Arg(100)->Arg(1000)->Arg(n_init);
+
+// Sampling among the keys in a window of a tenth of the map.
+template <bool rebuild>
+static void performSampleInRangeTest(benchmark::State& state) {
+  init();
+  perftest::SamplingMap<Key, Value, float> map;
+  for (int i = 0; i < state.range(0); ++i)
+    map.insert(keys[i], vals[i], weights[i]);
+  const Key width = state.range(0) / 10;
+
+  std::ranlux24_base rng(0);
+  Key result = 0;
+  perftest::resetStatistics(map);
+  for (auto _ : state) {
+    for (int i = 0; i < n_test; ++i) {
+      const Key lo = keys[i];
+      if constexpr (rebuild) {
+        perftest::SamplingMap<Key, Value, float> window;
+        for (auto it = map.begin(); it != map.end() && it->first < lo + width; ++it) {
+          if (it->first >= lo)
+            window.insert(it->first, it->second, it.getWeight());
+        }
+        const auto it = window.sample(rng);
+        result += it ? it->first : 0;
+      }
+      else {
+        const auto it = map.sampleInRange(rng, lo, lo + width);
+        result += it ? it->first : 0;
+      }
+    }
+  }
+  benchmark::DoNotOptimize(result);
+  perftest::reportStatistics(state, map);
+}
+
+static void BM_SamplingMapSampleInRangeRebuild(benchmark::State& state) {
+  performSampleInRangeTest<true>(state);
+}
+BENCHMARK(BM_SamplingMapSampleInRangeRebuild)->Arg(100)->Arg(1000)->Arg(n_init);
+
+static void BM_SamplingMapSampleInRange(benchmark::State& state) {
+  performSampleInRangeTest<false>(state);
+}
+BENCHMARK(BM_SamplingMapSampleInRange)->Arg(100)->Arg(1000)->Arg(n_init);
+
+// Stream of upserts on keys already present, e.g. refreshing the value and weight of an entry.
+template <bool upsert>
+static void performUpsertTest(benchmark::State& state) {
+  init();
+  perftest::SamplingMap<Key, Value, float> map;
+  for (int i = 0; i < state.range(0); ++i)
+    map.insert(keys[i], vals[i], weights[i]);
+
+  perftest::resetStatistics(map);
+  for (auto _ : state) {
+    for (int i = 0; i < n_test; ++i) {
+      if constexpr (upsert) {
+        map.insertOrAssign(keys[i], vals[i], weights[i + 1]);
+      }
+      else {  // Insert, then update the weight if the key is present.
+        if (!map.insert(keys[i], vals[i], weights[i + 1]).second)
+          map.findByKey(keys[i]).setWeight(weights[i + 1]);
+      }
+    }
+  }
+  perftest::reportStatistics(state, map);
+}
+
+static void BM_SamplingMapInsertSetWeight(benchmark::State& state) {
+  performUpsertTest<false>(state);
+}
+BENCHMARK(BM_SamplingMapInsertSetWeight)->Arg(100)->Arg(1000)->Arg(n_init);
+
+static void BM_SamplingMapInsertOrAssign(benchmark::State& state) {
+  performUpsertTest<true>(state);
+}
+BENCHMARK(BM_SamplingMapInsertOrAssign)->Arg(100)->Arg(1000)->Arg(n_init);
+
+// Several distributions over the same keys: each step inserts and erases a key, reweights a present
+// key in every channel, and samples from one channel. Compares a MultiSamplingMap with one
+// SamplingMap per channel.
+constexpr std::size_t n_channels = 4;
+
+template <bool multi>
+static void performChannelsTest(benchmark::State& state) {
+  init();
+  using Weights = std::array<float, n_channels>;
+  auto channel_weights = [](int i) {
+    Weights result;
+    for (std::size_t c = 0; c < n_channels; ++c)
+      result[c] = weights[(i + c) % weights.size()];
+    return result;
+  };
+
+  perftest::MultiSamplingMap<Key, Value, float, n_channels> multi_map;
+  std::array<perftest::SamplingMap<Key, Value, float>, n_channels> maps;
+  for (int i = 0; i < state.range(0); ++i) {
+    const auto w = channel_weights(i);
+    if constexpr (multi) {
+      multi_map.insert(keys[i], vals[i], w);
+    }
+    else {
+      for (std::size_t c = 0; c < n_channels; ++c)
+        maps[c].insert(keys[i], vals[i], w[c]);
+    }
+  }
+
+  std::mt19937_64 rng(0);
+  for (auto _ : state) {
+    for (int i = 0; i < n_test; ++i) {
+      const Key new_key = keys[n_init + i];
+      const auto w = channel_weights(i + 1);
+      const std::size_t channel = i % n_channels;
+      if constexpr (multi) {
+        multi_map.insert(new_key, vals[i], w);
+        multi_map.erase(new_key);
+        multi_map.findByKey(keys[i]).setWeights(w);
+        benchmark::DoNotOptimize(multi_map.sample(rng, channel));
+      }
+      else {
+        for (std::size_t c = 0; c < n_channels; ++c) {
+          maps[c].insert(new_key, vals[i], w[c]);
+          maps[c].erase(new_key);
+          maps[c].findByKey(keys[i]).setWeight(w[c]);
+        }
+        benchmark::DoNotOptimize(maps[channel].sample(rng));
+      }
+    }
+  }
+}
+
+static void BM_SamplingMapPerChannel(benchmark::State& state) {
+  performChannelsTest<false>(state);
+}
+BENCHMARK(BM_SamplingMapPerChannel)->Arg(100)->Arg(1000)->Arg(n_init);
+
+static void BM_MultiSamplingMap(benchmark::State& state) {
+  performChannelsTest<true>(state);
+}
+BENCHMARK(BM_MultiSamplingMap)->Arg(100)->Arg(1000)->Arg(n_init);
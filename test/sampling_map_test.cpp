@@ -10,9 +10,20 @@
 
 #include "order_statistic_map/sampling_map.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
 #include <map>
 #include <random>
+#include <sstream>
 #include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -80,6 +91,666 @@ TEST(OrderStatisticMapTest, SamplingFloat) {
   EXPECT_FALSE(empty.sample(rng1));
 }
 
+TEST(OrderStatisticMapTest, SampleBatch) {
+  maplib::SamplingMap<int, int, double> map;
+  std::vector<double> weights;
+  std::mt19937_64 rng(0);
+  std::uniform_real_distribution<double> distro(0, 1);
+  for (int i = 0; i < 200; ++i) {
+    weights.push_back(i % 7 ? distro(rng) : 0.);
+    map.insert(i, i, weights.back());
+  }
+
+  // Sorted positions, including out of range values and both edges.
+  const double total = map.totalWeight();
+  std::vector<double> positions{-1., 0.};
+  for (int i = 0; i < 500; ++i)
+    positions.push_back(distro(rng) * total);
+  positions.push_back(total);
+  positions.push_back(total * 1.01);
+  std::sort(positions.begin(), positions.end());
+
+  std::vector<decltype(map)::iterator> samples;
+  map.sample(positions.begin(), positions.end(), std::back_inserter(samples));
+  ASSERT_EQ(positions.size(), samples.size());
+  for (std::size_t i = 0; i < positions.size(); ++i)
+    EXPECT_EQ(map.sample(positions[i]), samples[i]);
+
+  // Random batch: samples are in key order and follow the weights.
+  const std::size_t k = 200000;
+  std::vector<decltype(map)::const_iterator> batch;
+  std::as_const(map).sampleBatch(rng, k, std::back_inserter(batch));
+  ASSERT_EQ(k, batch.size());
+
+  std::vector<int> counts(weights.size(), 0);
+  for (std::size_t i = 0; i < k; ++i) {
+    ASSERT_TRUE(batch[i]);
+    if (i) {
+      EXPECT_LE(batch[i - 1]->first, batch[i]->first);
+    }
+    ++counts[batch[i]->first];
+  }
+  for (std::size_t i = 0; i < weights.size(); ++i) {
+    const double expected = k * weights[i] / total;
+    EXPECT_NEAR(counts[i], expected, 5 * std::sqrt(expected) + 1e-9);
+  }
+
+  // Integer weights and empty map.
+  maplib::SamplingMap<int, int, unsigned> map_int{{0, 0, 1}, {1, 0, 0}, {2, 0, 3}};
+  std::vector<decltype(map_int)::iterator> int_batch;
+  map_int.sampleBatch(rng, 1000, std::back_inserter(int_batch));
+  ASSERT_EQ(1000, int_batch.size());
+  for (auto it : int_batch)
+    EXPECT_TRUE(it && it->first != 1);
+
+  maplib::SamplingMap<int, int, double> empty;
+  std::vector<decltype(empty)::iterator> empty_batch;
+  empty.sampleBatch(rng, 3, std::back_inserter(empty_batch));
+  EXPECT_EQ(3, empty_batch.size());
+  EXPECT_FALSE(empty_batch[0]);
+}
+
+TEST(OrderStatisticMapTest, SampleWithoutReplacement) {
+  maplib::SamplingMap<int, int, double> map{{0, 0, 1.}, {1, 0, 2.}, {2, 0, 0.}, {3, 0, 3.}};
+  const double total = map.totalWeight();
+  std::mt19937_64 rng(0);
+
+  // Probability of each ordered pair: w_a / total * w_b / (total - w_a).
+  const int n_trials = 60000;
+  std::map<std::pair<int, int>, int> pair_counts;
+  std::vector<decltype(map)::const_iterator> samples;
+  for (int trial = 0; trial < n_trials; ++trial) {
+    samples.clear();
+    std::as_const(map).sampleWithoutReplacement(rng, 2, std::back_inserter(samples));
+    ASSERT_EQ(2, samples.size());
+    ++pair_counts[{samples[0]->first, samples[1]->first}];
+  }
+
+  const std::vector<double> weights{1., 2., 0., 3.};
+  for (int a = 0; a < 4; ++a) {
+    for (int b = 0; b < 4; ++b) {
+      const double p = a == b ? 0 : weights[a] / total * weights[b] / (total - weights[a]);
+      const double expected = n_trials * p;
+      EXPECT_NEAR((pair_counts[{a, b}]), expected, 5 * std::sqrt(expected) + 1e-9);
+    }
+  }
+
+  // Only the entries with non-zero weight are returned, and the map is unchanged.
+  std::vector<decltype(map)::iterator> all;
+  map.sampleWithoutReplacement(rng, 10, std::back_inserter(all));
+  ASSERT_EQ(3, all.size());
+  std::vector<int> keys;
+  for (auto it : all)
+    keys.push_back(it->first);
+  std::sort(keys.begin(), keys.end());
+  EXPECT_EQ(std::vector<int>({0, 1, 3}), keys);
+  EXPECT_EQ(total, map.totalWeight());
+  EXPECT_EQ(2., map.findByKey(1).getWeight());
+  EXPECT_TRUE(map.checkConsistency());
+
+  // Many entries with floating point weights.
+  maplib::SamplingMap<int, int, float> big_map;
+  std::uniform_real_distribution<float> distro(0, 1);
+  for (int i = 0; i < 1000; ++i)
+    big_map.insert(i, i, i % 3 ? distro(rng) : 0.f);
+  std::vector<decltype(big_map)::iterator> distinct;
+  big_map.sampleWithoutReplacement(rng, 1000, std::back_inserter(distinct));
+  EXPECT_LE(distinct.size(), 666);
+  EXPECT_GE(distinct.size(), 600);
+  keys.clear();
+  for (auto it : distinct)
+    keys.push_back(it->first);
+  std::sort(keys.begin(), keys.end());
+  EXPECT_EQ(keys.end(), std::adjacent_find(keys.begin(), keys.end()));
+}
+
+TEST(OrderStatisticMapTest, SetWeights) {
+  maplib::SamplingMap<int, int, unsigned> map;
+  std::map<int, unsigned> reference;
+  std::mt19937 rng(0);
+  std::uniform_int_distribution<unsigned> weight_distro(0, 100);
+  for (int i = 0; i < 1000; ++i) {
+    reference[i] = weight_distro(rng);
+    map.insert(i, i, reference[i]);
+  }
+
+  // Few updates, including a repeated key, and many updates.
+  for (int n_updates : {10, 900}) {
+    std::uniform_int_distribution<int> key_distro(0, 999);
+    std::vector<std::pair<decltype(map)::iterator, unsigned>> updates;
+    for (int i = 0; i < n_updates; ++i) {
+      const int key = i == 1 ? updates[0].first->first : key_distro(rng);
+      updates.emplace_back(map.findByKey(key), weight_distro(rng));
+      reference[key] = updates.back().second;
+    }
+
+    map.setWeights(updates.begin(), updates.end());
+    ASSERT_TRUE(map.checkConsistency());
+    unsigned total = 0;
+    for (const auto& [key, weight] : reference) {
+      EXPECT_EQ(weight, map.findByKey(key).getWeight());
+      total += weight;
+    }
+    EXPECT_EQ(total, map.totalWeight());
+  }
+
+  // By key, ignoring missing keys.
+  const std::vector<std::pair<int, unsigned>> key_updates{{3, 7}, {-1, 5}, {500, 0}, {2000, 1}};
+  EXPECT_EQ(2, map.setWeightsByKey(key_updates.begin(), key_updates.end()));
+  EXPECT_EQ(7, map.findByKey(3).getWeight());
+  EXPECT_EQ(0, map.findByKey(500).getWeight());
+  EXPECT_FALSE(map.contains(-1));
+  EXPECT_TRUE(map.checkConsistency());
+}
+
+TEST(OrderStatisticMapTest, ScaleRange) {
+  maplib::SamplingMap<int, int, double> map;
+  std::map<int, double> reference;
+  std::mt19937 rng(0);
+  std::uniform_int_distribution<int> key_distro(0, 500);
+  std::uniform_int_distribution<int> weight_distro(0, 100);
+  // Powers of two keep the arithmetic exact.
+  const std::vector<double> factors{0.25, 0.5, 2, 4};
+  std::uniform_int_distribution<std::size_t> factor_distro(0, factors.size() - 1);
+
+  auto check = [&] {
+    ASSERT_TRUE(map.checkConsistency());
+    ASSERT_EQ(reference.size(), map.size());
+    double total = 0;
+    for (const auto& [key, weight] : reference) {
+      ASSERT_EQ(weight, map.findByKey(key).getWeight());
+      total += weight;
+    }
+    ASSERT_EQ(total, map.totalWeight());
+
+    // Sample at the lower edge of the interval of each key.
+    double on_the_left = 0;
+    for (const auto& [key, weight] : reference) {
+      if (weight > 0) {
+        ASSERT_EQ(key, map.sample(on_the_left)->first);
+      }
+      on_the_left += weight;
+    }
+  };
+
+  for (int i = 0; i < 2000; ++i) {
+    const int key = key_distro(rng);
+    switch (i % 5) {
+      case 0:
+      case 1:
+        if (map.insert(key, i, weight_distro(rng)).second)
+          reference[key] = map.findByKey(key).getWeight();
+        break;
+      case 2:
+        map.erase(key);
+        reference.erase(key);
+        break;
+      case 3: {
+        const int key_hi = key + key_distro(rng) / 4;
+        const double factor = factors[factor_distro(rng)];
+        map.scaleRange(key, key_hi, factor);
+        for (auto it = reference.lower_bound(key); it != reference.lower_bound(key_hi); ++it)
+          it->second *= factor;
+        break;
+      }
+      case 4:
+        if (map.contains(key)) {
+          reference[key] = weight_distro(rng);
+          map.findByKey(key).setWeight(reference[key]);
+        }
+    }
+    if (i % 100 == 0)
+      check();
+  }
+  check();
+
+  map.scaleAll(0.5);
+  for (auto& [key, weight] : reference)
+    weight *= 0.5;
+  check();
+
+  // Samples taken in a single descent or without replacement apply the pending scales.
+  std::vector<double> positions;
+  double on_the_left = 0;
+  for (const auto& [key, weight] : reference) {
+    if (weight > 0)
+      positions.push_back(on_the_left);
+    on_the_left += weight;
+  }
+  std::vector<decltype(map)::iterator> samples;
+  map.sample(positions.begin(), positions.end(), std::back_inserter(samples));
+  auto expected = reference.begin();
+  for (auto it : samples) {
+    while (expected->second == 0)
+      ++expected;
+    EXPECT_EQ(expected++->first, it->first);
+  }
+
+  samples.clear();
+  map.sampleWithoutReplacement(rng, map.size(), std::back_inserter(samples));
+  EXPECT_EQ(positions.size(), samples.size());
+
+  // Batched updates of most of the entries recompute the whole tree.
+  map.scaleRange(0, 250, 2);
+  std::vector<std::pair<int, double>> updates;
+  for (auto& [key, weight] : reference) {
+    if (key < 250)
+      weight *= 2;
+    if (key % 4) {
+      weight = key % 7;
+      updates.emplace_back(key, weight);
+    }
+  }
+  map.setWeightsByKey(updates.begin(), updates.end());
+  check();
+
+  // A zero factor, then an update inside the range.
+  map.scaleRange(100, 200, 0);
+  for (auto it = reference.lower_bound(100); it != reference.lower_bound(200); ++it)
+    it->second = 0;
+  if (map.contains(150)) {
+    map.findByKey(150).setWeight(3);
+    reference[150] = 3;
+  }
+  check();
+}
+
+TEST(OrderStatisticMapTest, CumulativeWeight) {
+  maplib::SamplingMap<int, int, double> map;
+  std::map<int, double> reference;
+  std::mt19937 rng(0);
+  std::uniform_int_distribution<int> key_distro(0, 300);
+  for (int i = 0; i < 200; ++i) {
+    const int key = key_distro(rng);
+    if (map.insert(key, i, key % 10).second)
+      reference[key] = key % 10;
+  }
+  // Pending scales are accounted for.
+  map.scaleRange(50, 150, 0.5);
+  map.scaleAll(4);
+  for (auto& [key, weight] : reference)
+    weight *= key >= 50 && key < 150 ? 2 : 4;
+
+  auto prefix = [&](int bound) {
+    double result = 0;
+    for (auto it = reference.begin(); it != reference.lower_bound(bound); ++it)
+      result += it->second;
+    return result;
+  };
+
+  for (int key = -1; key <= 302; ++key) {
+    EXPECT_EQ(prefix(key), map.cumulativeWeight(key));
+    if (const auto it = map.findByKey(key)) {
+      EXPECT_EQ(prefix(key), it.cumulativeWeight());
+    }
+  }
+  EXPECT_EQ(map.totalWeight(), map.cumulativeWeight(map.end()));
+  EXPECT_THROW(map.end().cumulativeWeight(), std::logic_error);
+
+  for (int i = 0; i < 200; ++i) {
+    const int lo = key_distro(rng) - 1;
+    const int hi = key_distro(rng) + 1;
+    EXPECT_EQ(lo < hi ? prefix(hi) - prefix(lo) : 0, map.weightBetween(lo, hi));
+  }
+
+  // Inverse of sample.
+  for (auto it = map.begin(); it != map.end(); ++it) {
+    if (it.getWeight() > 0) {
+      EXPECT_EQ(it, map.sample(map.cumulativeWeight(it)));
+    }
+  }
+}
+
+TEST(OrderStatisticMapTest, SampleInRange) {
+  maplib::SamplingMap<int, int, double> map;
+  std::map<int, double> reference;
+  std::mt19937 rng(0);
+  std::uniform_int_distribution<int> key_distro(0, 1000);
+
+  for (int i = 0; i < 300; ++i) {
+    const int key = key_distro(rng);
+    map.insert(key, i, key % 7);
+    reference[key] = key % 7;
+  }
+  map.scaleRange(200, 600, 3);
+  for (auto it = reference.lower_bound(200); it != reference.lower_bound(600); ++it)
+    it->second *= 3;
+
+  for (auto [lo, hi] : {std::pair<int, int>{0, 1001}, {100, 150}, {550, 650}, {-10, 30}}) {
+    double range_weight = 0;
+    for (auto it = reference.lower_bound(lo); it != reference.lower_bound(hi); ++it)
+      range_weight += it->second;
+
+    std::map<int, int> counts;
+    const int n_samples = 20000;
+    for (int i = 0; i < n_samples; ++i) {
+      const auto it = map.sampleInRange(rng, lo, hi);
+      ASSERT_TRUE(it);
+      ASSERT_GE(it->first, lo);
+      ASSERT_LT(it->first, hi);
+      ++counts[it->first];
+    }
+
+    for (auto it = reference.lower_bound(lo); it != reference.lower_bound(hi); ++it) {
+      const double p = it->second / range_weight;
+      EXPECT_NEAR(p * n_samples, counts[it->first], 5 * std::sqrt(n_samples * p) + 1);
+    }
+  }
+
+  // Empty ranges and ranges without weight.
+  EXPECT_FALSE(map.sampleInRange(rng, 500, 500));
+  EXPECT_FALSE(map.sampleInRange(rng, 600, 500));
+  EXPECT_FALSE(map.sampleInRange(rng, 2000, 3000));
+  map.scaleRange(0, 500, 0);
+  EXPECT_FALSE(map.sampleInRange(rng, 0, 500));
+  EXPECT_GE(map.sampleInRange(rng, 0, 1000)->first, 500);
+}
+
+TEST(OrderStatisticMapTest, Ranked) {
+  maplib::RankedSamplingMap<int, int, double> map;
+  std::map<int, double> reference;
+  std::mt19937 rng(0);
+  std::uniform_int_distribution<int> key_distro(0, 500);
+
+  for (int i = 0; i < 2000; ++i) {
+    const int key = key_distro(rng);
+    if (i % 3 == 2) {
+      EXPECT_EQ(reference.erase(key), map.erase(key));
+    }
+    else {
+      map.insert(key, i, key % 5);
+      reference[key] = key % 5;
+    }
+  }
+  map.scaleRange(100, 300, 2);
+  for (auto it = reference.lower_bound(100); it != reference.lower_bound(300); ++it)
+    it->second *= 2;
+  ASSERT_TRUE(map.checkConsistency());
+  ASSERT_EQ(reference.size(), map.size());
+
+  std::size_t index = 0;
+  for (const auto& [key, weight] : reference) {
+    const auto it = map.findByIndex(index);
+    EXPECT_EQ(key, it->first);
+    EXPECT_EQ(index, it.position());
+    EXPECT_EQ(weight, it.getWeight());
+    ++index;
+  }
+  EXPECT_THROW(map.findByIndex(map.size()), std::out_of_range);
+
+  // Sampling conditioned on a range of indices.
+  std::vector<std::pair<int, double>> sorted(reference.begin(), reference.end());
+  for (auto [first, last] : {std::pair<std::size_t, std::size_t>{0, map.size()},
+                             {0, 1},
+                             {10, 30},
+                             {map.size() - 20, map.size()},
+                             {50, 51}}) {
+    std::map<int, int> counts;
+    double range_weight = 0;
+    for (std::size_t i = first; i < last; ++i)
+      range_weight += sorted[i].second;
+
+    const int n_samples = 20000;
+    for (int i = 0; i < n_samples; ++i) {
+      const auto it = map.sampleInIndexRange(rng, first, last);
+      if (!range_weight) {
+        EXPECT_FALSE(it);
+        break;
+      }
+      ASSERT_TRUE(it);
+      ASSERT_GE(it.position(), first);
+      ASSERT_LT(it.position(), last);
+      ++counts[it->first];
+    }
+    if (!range_weight)
+      continue;
+
+    for (std::size_t i = first; i < last; ++i) {
+      const double p = sorted[i].second / range_weight;
+      EXPECT_NEAR(p * n_samples, counts[sorted[i].first], 5 * std::sqrt(n_samples * p) + 1);
+    }
+  }
+
+  EXPECT_FALSE(map.sampleInIndexRange(rng, 5, 5));
+  EXPECT_THROW(map.sampleInIndexRange(rng, 0, map.size() + 1), std::out_of_range);
+  EXPECT_THROW(map.sampleInIndexRange(rng, 3, 2), std::out_of_range);
+}
+
+// Concatenates the keys in order: a non-commutative augmentation.
+struct KeyList {
+  using value_type = std::string;
+
+  static value_type identity() {
+    return "";
+  }
+  static value_type make(int key, int, double) {
+    return std::to_string(key) + " ";
+  }
+  static value_type combine(const value_type& left, const value_type& right) {
+    return left + right;
+  }
+  static void scale(value_type&, double) {}
+};
+
+TEST(OrderStatisticMapTest, Augmented) {
+  maplib::AugmentedSamplingMap<int, int, double, maplib::augmentation::MaxWeight<double>> max_map;
+  maplib::AugmentedSamplingMap<int, int, double, maplib::augmentation::MinValue<int>> min_map;
+  maplib::AugmentedSamplingMap<int, int, double, KeyList> list_map;
+  std::map<int, std::pair<int, double>> reference;
+  std::mt19937 rng(0);
+  std::uniform_int_distribution<int> key_distro(0, 300);
+
+  auto apply = [&](auto&& f) {
+    f(max_map);
+    f(min_map);
+    f(list_map);
+  };
+
+  for (int i = 0; i < 1500; ++i) {
+    const int key = key_distro(rng);
+    const int value = key_distro(rng);
+    const double weight = key_distro(rng) % 20;
+    switch (i % 5) {
+      case 0:
+      case 1:  // Insertion of a new key or update of the value.
+        apply([&](auto& map) { map.insert(key, value, weight); });
+        if (reference.count(key))
+          reference[key].first = value;
+        else
+          reference[key] = {value, weight};
+        break;
+      case 2:
+        apply([&](auto& map) { map.erase(key); });
+        reference.erase(key);
+        break;
+      case 3:
+        if (reference.count(key)) {
+          apply([&](auto& map) { map.findByKey(key).setWeight(weight); });
+          reference[key].second = weight;
+        }
+        break;
+      case 4: {  // Scale by a power of two, to keep the weights exact.
+        const double factor = i % 2 ? 2 : 0.5;
+        apply([&](auto& map) { map.scaleRange(key, key + 50, factor); });
+        for (auto it = reference.lower_bound(key); it != reference.lower_bound(key + 50); ++it)
+          it->second.second *= factor;
+      }
+    }
+  }
+  ASSERT_TRUE(max_map.checkConsistency());
+  ASSERT_TRUE(list_map.checkConsistency());
+
+  for (int i = 0; i < 200; ++i) {
+    const int lo = key_distro(rng);
+    const int hi = lo + key_distro(rng) / 4;
+    double max_weight = 0;
+    int min_value = std::numeric_limits<int>::max();
+    std::string list;
+    for (auto it = reference.lower_bound(lo); it != reference.lower_bound(hi); ++it) {
+      max_weight = std::max(max_weight, it->second.second);
+      min_value = std::min(min_value, it->second.first);
+      list += std::to_string(it->first) + " ";
+    }
+    EXPECT_EQ(max_weight, max_map.aggregate(lo, hi));
+    EXPECT_EQ(min_value, min_map.aggregate(lo, hi));
+    EXPECT_EQ(list, list_map.aggregate(lo, hi));
+
+    // First entry after lo with a weight above the threshold.
+    const double threshold = i % 30;
+    auto expected = reference.lower_bound(lo);
+    while (expected != reference.end() && !(expected->second.second > threshold))
+      ++expected;
+    const auto found = max_map.findFirst(lo, [&](double max) { return max > threshold; });
+    if (expected == reference.end())
+      EXPECT_FALSE(found);
+    else
+      EXPECT_EQ(expected->first, found->first);
+  }
+
+  std::string list;
+  for (const auto& [key, entry] : reference)
+    list += std::to_string(key) + " ";
+  EXPECT_EQ(list, list_map.aggregate());
+
+  // The n-th entry is the first with n + 1 keys in the prefix.
+  auto n_keys = [](const std::string& s) {
+    return static_cast<std::size_t>(std::count(s.begin(), s.end(), ' '));
+  };
+  std::size_t n = 0;
+  for (const auto& [key, entry] : reference) {
+    EXPECT_EQ(key, list_map.findFirst([&](const std::string& s) { return n_keys(s) > n; })->first);
+    ++n;
+  }
+  EXPECT_FALSE(list_map.findFirst([&](const std::string& s) { return n_keys(s) > n; }));
+
+  maplib::AugmentedSamplingMap<int, int, double, KeyList> empty;
+  EXPECT_EQ("", empty.aggregate());
+  EXPECT_EQ("", list_map.aggregate(10, 10));
+}
+
+TEST(OrderStatisticMapTest, InsertOrAssign) {
+  maplib::SamplingMap<int, int, double> map;
+  maplib::RankedSamplingMap<int, int, double> ranked_map;
+  maplib::AugmentedSamplingMap<int, int, double, maplib::augmentation::MaxWeight<double>> max_map;
+  std::map<int, std::pair<int, double>> reference;
+  std::mt19937 rng(0);
+  std::uniform_int_distribution<int> key_distro(0, 200);
+
+  for (int i = 0; i < 2000; ++i) {
+    const int key = key_distro(rng);
+    const double weight = key_distro(rng) % 10;
+    if (i % 50 == 49) {  // Leave pending scales in the trees.
+      map.scaleRange(key, key + 40, 2);
+      ranked_map.scaleRange(key, key + 40, 2);
+      max_map.scaleRange(key, key + 40, 2);
+      for (auto it = reference.lower_bound(key); it != reference.lower_bound(key + 40); ++it)
+        it->second.second *= 2;
+      continue;
+    }
+
+    const bool inserted = !reference.count(key);
+    reference[key] = {i, weight};
+    const auto [it, success] = map.insertOrAssign(key, i, weight);
+    EXPECT_EQ(inserted, success);
+    EXPECT_EQ(key, it->first);
+    EXPECT_EQ(inserted, ranked_map.insertOrAssign(key, i, weight).second);
+    EXPECT_EQ(inserted, max_map.insertOrAssign(key, i, weight).second);
+  }
+  ASSERT_TRUE(map.checkConsistency());
+  ASSERT_TRUE(ranked_map.checkConsistency());
+  ASSERT_TRUE(max_map.checkConsistency());
+  ASSERT_EQ(reference.size(), map.size());
+
+  double total = 0;
+  double max_weight = 0;
+  std::size_t index = 0;
+  for (const auto& [key, entry] : reference) {
+    const auto it = map.findByKey(key);
+    ASSERT_TRUE(it);
+    EXPECT_EQ(entry.first, it->second);
+    EXPECT_EQ(entry.second, it.getWeight());
+    EXPECT_EQ(index++, ranked_map.findByKey(key).position());
+    total += entry.second;
+    max_weight = std::max(max_weight, entry.second);
+  }
+  EXPECT_NEAR(total, map.totalWeight(), 1e-8 * total);
+  EXPECT_EQ(max_weight, max_map.aggregate());
+}
+
+TEST(OrderStatisticMapTest, EraseWithPendingScales) {
+  maplib::RankedSamplingMap<int, int, double> map;
+  std::map<int, std::pair<int, double>> reference;
+  std::mt19937 rng(0);
+  std::uniform_int_distribution<int> key_distro(0, 300);
+
+  for (int i = 0; i < 3000; ++i) {
+    const int key = key_distro(rng);
+    const auto expect = i % 6 < 3 ? maplib::Expect::CHANGE : maplib::Expect::NO_CHANGE;
+    switch (i % 4) {
+      case 0:
+        map.insert(key, i, key % 5, expect);
+        reference.insert({key, {i, key % 5}}).first->second.first = i;
+        break;
+      case 1:
+        EXPECT_EQ(reference.erase(key), map.erase(key));
+        break;
+      case 2:
+        if (auto it = map.findByKey(key)) {
+          map.erase(it);
+          reference.erase(key);
+        }
+        break;
+      case 3:
+        map.scaleRange(key, key + 30, 2);
+        for (auto it = reference.lower_bound(key); it != reference.lower_bound(key + 30); ++it)
+          it->second.second *= 2;
+    }
+    ASSERT_EQ(reference.size(), map.size());
+  }
+  ASSERT_TRUE(map.checkConsistency());
+
+  std::size_t index = 0;
+  double total = 0;
+  for (const auto& [key, entry] : reference) {
+    const auto it = map.findByIndex(index++);
+    EXPECT_EQ(key, it->first);
+    EXPECT_EQ(entry.first, it->second);
+    EXPECT_EQ(entry.second, it.getWeight());
+    total += entry.second;
+  }
+  EXPECT_NEAR(total, map.totalWeight(), 1e-8 * total);
+}
+
+TEST(OrderStatisticMapTest, ScaleMovedMap) {
+  using Map = maplib::SamplingMap<int, int, double>;
+  Map map;
+  for (int i = 0; i < 100; ++i)
+    map.insert(i, i, i);
+  const auto it = map.findByKey(10);
+  EXPECT_EQ(10, it.getWeight());
+
+  // Iterators stay valid after a move, and see the scales applied by the new owner.
+  Map moved(std::move(map));
+  moved.scaleAll(2);
+  moved.scaleRange(0, 50, 0.5);
+  EXPECT_EQ(10, it.getWeight());
+  EXPECT_EQ(160, moved.findByKey(80).getWeight());
+
+  const Map copy(moved);
+  const auto linearized = copy.linearize();
+  ASSERT_EQ(100, linearized.size());
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(i < 50 ? i : 2 * i, std::get<2>(linearized[i]));
+    EXPECT_EQ(std::get<2>(linearized[i]), moved.findByKey(i).getWeight());
+  }
+
+  std::stringstream stream;
+  moved.save(stream);
+  Map loaded;
+  loaded.load(stream);
+  EXPECT_EQ(linearized, loaded.linearize());
+}
+
 //// Manually test insertion, erasure, and retrieval.
 TEST(OrderStatisticMapTest, InsertFindErase) {
   maplib::SamplingMap<std::string, int, unsigned> map;
@@ -188,3 +859,79 @@ TEST(OrderStatisticMapTest, Assignment) {
   map3 = std::move(map1);
   EXPECT_EQ(map2.linearize(), map3.linearize());
 }
+
+TEST(OrderStatisticMapTest, Compact) {
+  maplib::SamplingMap<int, int, double> map;
+
+  std::mt19937_64 rng(0);
+  std::uniform_int_distribution<int> distro(0, 200);
+  for (int i = 0; i < 1000; ++i) {
+    const int key = distro(rng);
+    if (i % 3 == 2)
+      map.erase(key);
+    else
+      map.insert(key, i, key + 0.5);
+  }
+
+  const auto linearized = map.linearize();
+  const double total_weight = map.totalWeight();
+
+  map.compact();
+  ASSERT_TRUE(map.checkConsistency());
+  EXPECT_EQ(linearized, map.linearize());
+  EXPECT_DOUBLE_EQ(total_weight, map.totalWeight());
+}
+
+TEST(OrderStatisticMapTest, SaveLoad) {
+  for (int n : {0, 1, 2, 7, 8, 1000}) {
+    maplib::SamplingMap<int, float, double> map;
+    for (int i = 0; i < n; ++i)
+      map.insert((i * 37) % 1009, i * 0.5f, i + 1.);
+
+    std::stringstream stream;
+    map.save(stream);
+
+    maplib::SamplingMap<int, float, double> loaded{{-1, 0, 1}};
+    loaded.load(stream);
+
+    ASSERT_TRUE(loaded.checkConsistency());
+    EXPECT_EQ(map.size(), loaded.size());
+    EXPECT_EQ(map.linearize(), loaded.linearize());
+    EXPECT_DOUBLE_EQ(map.totalWeight(), loaded.totalWeight());
+
+    // The loaded tree is a valid red-black tree.
+    for (int i = 0; i < 100; ++i) {
+      loaded.insert(2000 + i, 0, 1);
+      loaded.erase((i * 37) % 1009);
+      ASSERT_TRUE(loaded.checkConsistency());
+    }
+  }
+}
+
+TEST(OrderStatisticMapTest, LoadInvalidStream) {
+  maplib::SamplingMap<int, int, double> map{{1, 1, 1}, {2, 2, 2}};
+  std::stringstream stream;
+  map.save(stream);
+  const std::string snapshot = stream.str();
+
+  // Different types.
+  maplib::SamplingMap<long, int, double> other_types;
+  std::stringstream stream2(snapshot);
+  EXPECT_THROW(other_types.load(stream2), std::runtime_error);
+
+  // Truncated stream.
+  maplib::SamplingMap<int, int, double> truncated;
+  std::stringstream stream3(snapshot.substr(0, snapshot.size() - 1));
+  EXPECT_THROW(truncated.load(stream3), std::runtime_error);
+
+  // Not a snapshot.
+  std::stringstream stream4(std::string(snapshot.size(), 'x'));
+  EXPECT_THROW(truncated.load(stream4), std::runtime_error);
+
+  // Corrupted size, larger than any allocation.
+  std::string huge_size = snapshot;
+  const std::uint64_t size = std::uint64_t(1) << 62;
+  std::memcpy(&huge_size[offsetof(maplib::details::SnapshotHeader, size)], &size, sizeof(size));
+  std::stringstream stream5(huge_size);
+  EXPECT_THROW(truncated.load(stream5), std::runtime_error);
+}
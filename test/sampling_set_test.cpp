@@ -10,9 +10,12 @@
 
 #include "order_statistic_map/sampling_set.hpp"
 
+#include <algorithm>
+#include <iterator>
 #include <set>
 #include <random>
 #include <string>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -78,6 +81,70 @@ TEST(SamplingSetTest, SamplingFloat) {
   EXPECT_THROW(empty.sample(rng1), std::out_of_range);
 }
 
+TEST(SamplingSetTest, SampleBatch) {
+  maplib::SamplingSet<int, unsigned> set{{0, 1}, {1, 2}, {2, 1}};
+
+  const std::vector<unsigned> positions{0, 1, 2, 3};
+  std::vector<int> keys;
+  set.sample(positions.begin(), positions.end(), std::back_inserter(keys));
+  EXPECT_EQ(std::vector<int>({0, 1, 1, 2}), keys);
+
+  std::ranlux24_base rng(0);
+  keys.clear();
+  set.sampleBatch(rng, 100, std::back_inserter(keys));
+  EXPECT_EQ(100, keys.size());
+  EXPECT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+
+  const std::vector<unsigned> out_of_range{4};
+  EXPECT_THROW(set.sample(out_of_range.begin(), out_of_range.end(), std::back_inserter(keys)),
+               std::out_of_range);
+}
+
+TEST(SamplingSetTest, SampleWithoutReplacement) {
+  maplib::SamplingSet<int, unsigned> set{{0, 1}, {1, 2}, {2, 0}, {3, 5}};
+
+  std::ranlux24_base rng(0);
+  std::vector<int> keys;
+  set.sampleWithoutReplacement(rng, 2, std::back_inserter(keys));
+  ASSERT_EQ(2, keys.size());
+  EXPECT_NE(keys[0], keys[1]);
+
+  keys.clear();
+  set.sampleWithoutReplacement(rng, 4, std::back_inserter(keys));
+  std::sort(keys.begin(), keys.end());
+  EXPECT_EQ(std::vector<int>({0, 1, 3}), keys);
+  EXPECT_EQ(8, set.totalWeight());
+}
+
+TEST(SamplingSetTest, Scale) {
+  maplib::SamplingSet<int, double> set{{0, 1}, {1, 2}, {2, 3}, {3, 4}};
+  set.scaleAll(2);
+  EXPECT_EQ(20, set.totalWeight());
+
+  set.scaleRange(1, 3, 0.5);
+  EXPECT_EQ(15, set.totalWeight());
+  EXPECT_EQ(0, set.sample(1.9));
+  EXPECT_EQ(1, set.sample(2.1));
+  EXPECT_EQ(3, set.sample(7.1));
+
+  EXPECT_EQ(7, set.cumulativeWeight(3));
+  EXPECT_EQ(5, set.weightBetween(1, 3));
+  EXPECT_EQ(0, set.weightBetween(3, 1));
+
+  std::mt19937 rng(0);
+  for (int i = 0; i < 100; ++i) {
+    const int key = set.sampleInRange(rng, 1, 3);
+    EXPECT_TRUE(key == 1 || key == 2);
+  }
+  set.scaleRange(1, 3, 0);
+  EXPECT_THROW(set.sampleInRange(rng, 1, 3), std::out_of_range);
+
+  EXPECT_FALSE(set.insertOrAssign(1, 5));
+  EXPECT_TRUE(set.insertOrAssign(4, 1));
+  EXPECT_EQ(16, set.totalWeight());
+  EXPECT_EQ(5, set.weightBetween(1, 3));
+}
+
 // Manually test insertion, erasure, and retrieval.
 TEST(SamplingSetTest, InsertFindErase) {
   maplib::SamplingSet<std::string, int> set;
@@ -0,0 +1,146 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Test for the SharedSamplingMap and SharedSamplingMapReader classes.
+
+#include "order_statistic_map/shared_sampling_map.hpp"
+
+#include <map>
+#include <random>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+
+class SharedSamplingMapTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    maplib::SharedSamplingMap<int, int, double>::remove(name_);
+  }
+  void TearDown() override {
+    maplib::SharedSamplingMap<int, int, double>::remove(name_);
+  }
+
+  const std::string name_ = "/maplib_shared_sampling_map_test";
+};
+
+TEST_F(SharedSamplingMapTest, WriterOperations) {
+  maplib::SharedSamplingMap<int, int, double> map(name_, 256);
+  std::map<int, double> weights;
+
+  std::mt19937_64 rng(0);
+  std::uniform_int_distribution<int> distro(0, 300);
+  for (int i = 0; i < 1000; ++i) {
+    const int key = distro(rng);
+    if (i % 3 == 2) {
+      EXPECT_EQ(weights.erase(key), map.erase(key));
+    }
+    else if (i % 3 == 1 && weights.count(key)) {
+      map.setWeight(key, i);
+      weights[key] = i;
+    }
+    else if (weights.size() < 256) {
+      map.insert(key, 2 * key, key + 0.5);
+      weights.emplace(key, key + 0.5);
+    }
+    ASSERT_TRUE(map.checkConsistency());
+  }
+
+  ASSERT_EQ(weights.size(), map.size());
+  std::size_t idx = 0;
+  double total = 0;
+  for (const auto& [key, weight] : weights) {
+    const auto it = map.findByIndex(idx++);
+    EXPECT_EQ(key, it->first);
+    EXPECT_EQ(2 * key, it->second);
+    EXPECT_EQ(weight, it.getWeight());
+    total += weight;
+  }
+  EXPECT_NEAR(total, map.totalWeight(), 1e-8 * total);
+
+  // The capacity is fixed.
+  for (int key = 1000; map.size() < 256; ++key)
+    map.insert(key, 0, 1);
+  EXPECT_THROW(map.insert(-1, 0, 1), std::length_error);
+  ASSERT_TRUE(map.checkConsistency());
+  EXPECT_EQ(256, map.size());
+  EXPECT_FALSE(map.findByKey(-1));
+
+  // The value of a present key can still be updated.
+  const auto [it, inserted] = map.insert(1000, 42, 1);
+  EXPECT_FALSE(inserted);
+  EXPECT_EQ(42, it->second);
+}
+
+TEST_F(SharedSamplingMapTest, Reader) {
+  maplib::SharedSamplingMap<int, int, unsigned> map(name_, 16);
+  map.insert(0, 10, 1);
+  map.insert(1, 11, 2);
+  map.insert(2, 12, 1);
+
+  maplib::SharedSamplingMapReader<int, int, unsigned> reader(name_);
+  EXPECT_EQ(3, reader.size());
+  EXPECT_EQ(4, reader.totalWeight());
+
+  EXPECT_EQ(std::make_tuple(1, 11, 2u), reader.findByKey(1).value());
+  EXPECT_EQ(std::make_tuple(2, 12, 1u), reader.findByIndex(2).value());
+  EXPECT_EQ(1, std::get<0>(reader.sample(2u).value()));
+  EXPECT_FALSE(reader.findByKey(3));
+  EXPECT_FALSE(reader.findByIndex(3));
+  EXPECT_FALSE(reader.sample(4u));
+
+  std::mt19937 rng(0);
+  for (int i = 0; i < 10; ++i)
+    EXPECT_TRUE(reader.sample(rng));
+
+  // Modifications are visible immediately.
+  map.setWeight(0, 5);
+  EXPECT_EQ(8, reader.totalWeight());
+  map.erase(1);
+  EXPECT_FALSE(reader.findByKey(1));
+}
+
+// Readers in another process sample while the writer keeps modifying the tree.
+TEST_F(SharedSamplingMapTest, ConcurrentProcesses) {
+  maplib::SharedSamplingMap<int, int, double> map(name_, 1024);
+  for (int key = 0; key < 512; ++key)
+    map.insert(key, 2 * key, key + 1.);
+
+  const pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+
+  if (pid == 0) {  // Reader process: every entry read must be consistent.
+    maplib::SharedSamplingMapReader<int, int, double> reader(name_);
+    std::mt19937 rng(1);
+    int errors = 0;
+    for (int i = 0; i < 100000; ++i) {
+      const auto entry = reader.sample(rng);
+      if (entry && std::get<1>(*entry) != 2 * std::get<0>(*entry))
+        ++errors;
+      const auto found = reader.findByKey(i % 1024);
+      if (found && std::get<1>(*found) != 2 * std::get<0>(*found))
+        ++errors;
+    }
+    _exit(errors ? 1 : 0);
+  }
+
+  std::mt19937 rng(0);
+  std::uniform_int_distribution<int> distro(0, 1023);
+  for (int i = 0; i < 100000; ++i) {
+    const int key = distro(rng);
+    if (!map.erase(key))
+      map.insert(key, 2 * key, key + 1.);
+  }
+
+  int status;
+  waitpid(pid, &status, 0);
+  EXPECT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(0, WEXITSTATUS(status));
+  EXPECT_TRUE(map.checkConsistency());
+}
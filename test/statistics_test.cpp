@@ -0,0 +1,121 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Test for the operation counters.
+
+#include "order_statistic_map/order_statistic_map.hpp"
+#include "order_statistic_map/order_statistic_set.hpp"
+#include "order_statistic_map/sampling_map.hpp"
+
+#include <random>
+
+#include "gtest/gtest.h"
+
+using maplib::CountingStatistics;
+
+TEST(StatisticsTest, OrderStatisticMap) {
+  maplib::OrderStatisticMap<int, int, 64, CountingStatistics> map;
+  EXPECT_EQ(0, map.stats().comparisons);
+
+  // Ascending insertions require a rotation at every other step.
+  for (int i = 0; i < 128; ++i)
+    map.insert(i, i);
+
+  auto counters = map.stats();
+  EXPECT_LT(0, counters.rotations);
+  EXPECT_EQ(counters.comparisons, counters.descended_nodes);
+  EXPECT_EQ(2, counters.pool_allocations);
+  EXPECT_EQ(0, counters.undone_insertions);
+
+  map.resetStats();
+  EXPECT_EQ(0, map.stats().comparisons);
+  EXPECT_EQ(0, map.stats().pool_allocations);
+
+  map.insert(64, 0);
+  counters = map.stats();
+  EXPECT_EQ(1, counters.undone_insertions);
+  EXPECT_GE(counters.comparisons, 1);
+  EXPECT_LE(counters.comparisons, 2 * 8);
+
+  map.erase(1000);
+  EXPECT_EQ(1, map.stats().undone_erasures);
+
+  map.resetStats();
+  EXPECT_TRUE(map.contains(10));
+  EXPECT_FALSE(map.contains(1000));
+  map.findByIndex(10);
+  EXPECT_LT(0, map.stats().descended_nodes);
+
+  map.resetStats();
+  for (int i = 0; i < 128; ++i)
+    map.erase(i);
+  counters = map.stats();
+  EXPECT_LT(0, counters.rotations);
+  EXPECT_LT(0, counters.max_fix_depth);
+  EXPECT_EQ(0, counters.undone_erasures);
+  EXPECT_EQ(0, counters.pool_allocations);
+
+  // Only the pools beyond the ones held at the last reset are counted.
+  for (int i = 0; i < 256; ++i)
+    map.insert(i, i);
+  EXPECT_EQ(2, map.stats().pool_allocations);
+
+  // The pools of a compacted map are all new.
+  map.compact();
+  EXPECT_EQ(4, map.stats().pool_allocations);
+}
+
+TEST(StatisticsTest, OrderStatisticSet) {
+  maplib::OrderStatisticSet<int, 64, CountingStatistics> set;
+  set.insert(1);
+  set.insert(1);
+  EXPECT_EQ(1, set.stats().undone_insertions);
+}
+
+TEST(StatisticsTest, SamplingMap) {
+  using Map = maplib::SamplingMap<int, int, double, 64, false, void, CountingStatistics>;
+  Map map;
+  for (int i = 0; i < 100; ++i)
+    map.insert(i, i, 1.);
+  map.insert(0, 0, 1.);
+
+  auto counters = map.stats();
+  EXPECT_LT(0, counters.rotations);
+  EXPECT_EQ(1, counters.undone_insertions);
+  EXPECT_EQ(2, counters.pool_allocations);
+
+  map.resetStats();
+  std::mt19937 rng(0);
+  map.sample(rng);
+  counters = map.stats();
+  EXPECT_LT(0, counters.descended_nodes);
+  EXPECT_EQ(0, counters.comparisons);
+
+  // Moving the map moves the counters.
+  Map moved(std::move(map));
+  EXPECT_EQ(counters.descended_nodes, moved.stats().descended_nodes);
+}
+
+TEST(StatisticsTest, NoStatistics) {
+  // The default policy takes no space and counts nothing.
+  static_assert(sizeof(maplib::OrderStatisticMap<int, int>) <
+                sizeof(maplib::OrderStatisticMap<int, int, 64, CountingStatistics>));
+  static_assert(sizeof(maplib::SamplingMap<int, int, double>) <
+                sizeof(maplib::SamplingMap<int, int, double, 64, false, void, CountingStatistics>));
+
+  maplib::OrderStatisticMap<int, int> map;
+  for (int i = 0; i < 128; ++i)
+    map.insert(i, i);
+  map.insert(0, 0);
+
+  const auto counters = map.stats();
+  EXPECT_EQ(0, counters.comparisons);
+  EXPECT_EQ(0, counters.rotations);
+  EXPECT_EQ(0, counters.undone_insertions);
+  EXPECT_EQ(0, counters.pool_allocations);
+}
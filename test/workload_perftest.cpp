@@ -0,0 +1,312 @@
+// Copyright (C) ETH Zurich
+// Copyright (C) 2020 UT-Battelle, LLC
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Performance of realistic mixes of operations, from 10^2 to 10^7 elements. Each iteration performs
+// a single step of the mix. The first argument of each benchmark is the size, the following ones,
+// in thousandths, parameterize the mix:
+// - Zipf/size/theta/updates: lookups, or erase and reinsertion with probability `updates`, of keys
+//   with Zipfian popularity of exponent `theta`.
+// - SlidingWindow/size: insertion of the newest key and erasure of the oldest one.
+// - MonteCarlo/size/accept/reweight: proposal of an element by weighted sampling, accepted with
+//   probability `accept`. An accepted move changes the weight of the element with probability
+//   `reweight`, or replaces it with a new key.
+// - ReadHeavy/size/writes: access by index followed by position(), or erase and reinsertion with
+//   probability `writes`.
+// Random numbers are drawn before the timed loop. Filling the largest containers dominates the
+// run time: use --benchmark_filter to select a subset of the sizes and parameters, e.g.
+// --benchmark_filter='MonteCarlo/.*/800/'. Other parameters are set by editing the argument lists.
+
+#include "order_statistic_map/order_statistic_map.hpp"
+#include "order_statistic_map/sampling_map.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "perftest_statistics.hpp"
+
+#define ARGS RangeMultiplier(10)->Range(100, 10000000)
+#define SIZES benchmark::CreateRange(100, 10000000, 10)
+
+// Default parameters of the mixes, in thousandths, each swept with a few alternatives.
+#define ZIPF_ARGS ArgsProduct({SIZES, {500, 990}, {100}})
+#define MONTE_CARLO_ARGS ArgsProduct({SIZES, {200, 500, 800}, {500}})
+#define READ_HEAVY_ARGS ArgsProduct({SIZES, {10, 100}})
+
+const std::size_t n_draws = 1 << 16;
+
+// Returns the benchmark argument `index` as a probability, from thousandths.
+double fraction(const benchmark::State& state, int index) {
+  return state.range(index) / 1000.;
+}
+
+using Key = long;
+using Value = int;
+
+// Returns the `n` integers in [0, n) in random order.
+std::vector<Key> shuffledRange(std::size_t n, unsigned seed = 0) {
+  std::vector<Key> result(n);
+  std::iota(result.begin(), result.end(), 0);
+  std::shuffle(result.begin(), result.end(), std::mt19937_64(seed));
+  return result;
+}
+
+// Zipfian ranks in [0, n) with exponent theta < 1, from Gray et al., "Quickly generating
+// billion-record synthetic databases", SIGMOD 1994.
+std::vector<std::size_t> zipfDraws(std::size_t n, double theta, std::size_t n_samples) {
+  double zeta_n = 0;
+  for (std::size_t i = 1; i <= n; ++i)
+    zeta_n += std::pow(1. / i, theta);
+  const double zeta_2 = 1 + std::pow(0.5, theta);
+  const double alpha = 1. / (1. - theta);
+  const double eta = (1. - std::pow(2. / n, 1. - theta)) / (1. - zeta_2 / zeta_n);
+
+  std::mt19937_64 rng(42);
+  std::uniform_real_distribution<double> distro(0, 1);
+  std::vector<std::size_t> result(n_samples);
+  for (auto& rank : result) {
+    const double u = distro(rng);
+    const double uz = u * zeta_n;
+    if (uz < 1.)
+      rank = 0;
+    else if (uz < zeta_2)
+      rank = 1;
+    else
+      rank = std::min<std::size_t>(n - 1, n * std::pow(eta * u - eta + 1., alpha));
+  }
+  return result;
+}
+
+template <class Map>
+void fill(Map& map, const std::vector<Key>& keys) {
+  for (const Key key : keys)
+    map.insert({key, Value(key)});
+}
+
+template <class Map>
+static void performZipfTest(benchmark::State& state) {
+  const std::size_t size = state.range(0);
+  const auto keys = shuffledRange(size);
+  Map map;
+  fill(map, keys);
+
+  // Popular ranks are mapped to random keys, to spread them across the tree.
+  const auto ranks = zipfDraws(size, fraction(state, 1), n_draws);
+  std::mt19937_64 rng(0);
+  std::bernoulli_distribution update_distro(fraction(state, 2));
+  std::vector<bool> is_update(n_draws);
+  for (std::size_t i = 0; i < n_draws; ++i)
+    is_update[i] = update_distro(rng);
+
+  perftest::resetStatistics(map);
+  std::size_t i = 0;
+  for (auto _ : state) {
+    const Key key = keys[ranks[i]];
+    if (is_update[i]) {
+      map.erase(key);
+      map.insert({key, Value(key)});
+    }
+    else {
+      benchmark::DoNotOptimize(map.count(key));
+    }
+    i = (i + 1) % n_draws;
+  }
+  perftest::reportStatistics(state, map);
+}
+
+static void BM_MyMapZipf(benchmark::State& state) {
+  performZipfTest<maplib::OrderStatisticMap<Key, Value>>(state);
+}
+BENCHMARK(BM_MyMapZipf)->ZIPF_ARGS;
+
+static void BM_StdMapZipf(benchmark::State& state) {
+  performZipfTest<std::map<Key, Value>>(state);
+}
+BENCHMARK(BM_StdMapZipf)->ZIPF_ARGS;
+
+template <class Map, class Insert>
+static void performSlidingWindowTest(benchmark::State& state, Insert&& insert) {
+  const std::size_t size = state.range(0);
+  Map map;
+  for (const Key key : shuffledRange(size))
+    insert(map, key);
+
+  perftest::resetStatistics(map);
+  Key oldest = 0;
+  for (auto _ : state) {
+    insert(map, oldest + size);
+    map.erase(oldest);
+    ++oldest;
+  }
+  perftest::reportStatistics(state, map);
+}
+
+static void BM_MyMapSlidingWindow(benchmark::State& state) {
+  performSlidingWindowTest<maplib::OrderStatisticMap<Key, Value>>(
+      state, [](auto& map, Key key) { map.insert(key, Value(key)); });
+}
+BENCHMARK(BM_MyMapSlidingWindow)->ARGS;
+
+static void BM_StdMapSlidingWindow(benchmark::State& state) {
+  performSlidingWindowTest<std::map<Key, Value>>(
+      state, [](auto& map, Key key) { map.insert({key, Value(key)}); });
+}
+BENCHMARK(BM_StdMapSlidingWindow)->ARGS;
+
+static void BM_SamplingMapSlidingWindow(benchmark::State& state) {
+  performSlidingWindowTest<maplib::SamplingMap<Key, Value, double>>(
+      state, [](auto& map, Key key) { map.insert(key, Value(key), 1. + key % 16); });
+}
+BENCHMARK(BM_SamplingMapSlidingWindow)->ARGS;
+
+static void BM_SamplingMapMonteCarlo(benchmark::State& state) {
+  const std::size_t size = state.range(0);
+  maplib::SamplingMap<Key, Value, double> map;
+  for (const Key key : shuffledRange(size))
+    map.insert(key, Value(key), 1. + key % 16);
+
+  std::mt19937_64 rng(0);
+  std::uniform_real_distribution<double> distro(0, 1);
+  std::vector<double> positions(n_draws), new_weights(n_draws);
+  std::vector<int> moves(n_draws);  // 0: reject, 1: replace, 2: reweight.
+  const double accept = fraction(state, 1);
+  const double reweight = fraction(state, 2);
+  for (std::size_t i = 0; i < n_draws; ++i) {
+    positions[i] = distro(rng);
+    new_weights[i] = 1. + 15. * distro(rng);
+    if (distro(rng) < accept)
+      moves[i] = distro(rng) < reweight ? 2 : 1;
+    else
+      moves[i] = 0;
+  }
+
+  perftest::resetStatistics(map);
+  Key next_key = size;
+  std::size_t i = 0;
+  for (auto _ : state) {
+    auto it = map.sampleScaled(positions[i]);
+    if (moves[i] == 1) {
+      map.erase(it);
+      map.insert(next_key, Value(next_key), new_weights[i]);
+      ++next_key;
+    }
+    else if (moves[i] == 2) {
+      it.setWeight(new_weights[i]);
+    }
+    benchmark::DoNotOptimize(it);
+    i = (i + 1) % n_draws;
+  }
+  perftest::reportStatistics(state, map);
+}
+BENCHMARK(BM_SamplingMapMonteCarlo)->MONTE_CARLO_ARGS;
+
+static void BM_MyMapReadHeavy(benchmark::State& state) {
+  const std::size_t size = state.range(0);
+  const auto keys = shuffledRange(size);
+  maplib::OrderStatisticMap<Key, Value> map;
+  fill(map, keys);
+
+  std::mt19937_64 rng(0);
+  std::bernoulli_distribution write_distro(fraction(state, 1));
+  std::vector<std::size_t> indices(n_draws);
+  std::vector<bool> is_write(n_draws);
+  for (std::size_t i = 0; i < n_draws; ++i) {
+    indices[i] = rng() % size;
+    is_write[i] = write_distro(rng);
+  }
+
+  perftest::resetStatistics(map);
+  std::size_t i = 0;
+  for (auto _ : state) {
+    if (is_write[i]) {
+      const Key key = keys[indices[i]];
+      map.erase(key);
+      map.insert(key, Value(key));
+    }
+    else {
+      benchmark::DoNotOptimize(map.findByIndex(indices[i]).position());
+    }
+    i = (i + 1) % n_draws;
+  }
+  perftest::reportStatistics(state, map);
+}
+BENCHMARK(BM_MyMapReadHeavy)->READ_HEAVY_ARGS;
+
+// 90% of the steps insert a present key or erase a missing one, according to `hit_heavy`, and the
+// rest erase and reinsert a present key. Each operation is given the `expect` hint.
+template <class Map, class Insert, class Erase>
+static void performRedundantTest(benchmark::State& state, bool hit_heavy, Insert&& insert,
+                                 Erase&& erase) {
+  const std::size_t size = state.range(0);
+  Map map;
+  for (const Key key : shuffledRange(size))
+    insert(map, 2 * key);  // Odd keys are missing.
+
+  std::mt19937_64 rng(0);
+  std::vector<Key> keys(n_draws);
+  std::vector<bool> is_update(n_draws);
+  for (std::size_t i = 0; i < n_draws; ++i) {
+    keys[i] = 2 * (rng() % size);
+    is_update[i] = rng() % 10 == 0;
+  }
+
+  perftest::resetStatistics(map);
+  std::size_t i = 0;
+  for (auto _ : state) {
+    const Key key = keys[i];
+    if (is_update[i]) {
+      erase(map, key);
+      insert(map, key);
+    }
+    else if (hit_heavy) {
+      insert(map, key);
+    }
+    else {
+      erase(map, key + 1);
+    }
+    i = (i + 1) % n_draws;
+  }
+  perftest::reportStatistics(state, map);
+}
+
+template <maplib::Expect expect>
+static void performMyMapRedundantTest(benchmark::State& state, bool hit_heavy) {
+  performRedundantTest<maplib::OrderStatisticMap<Key, Value>>(
+      state, hit_heavy, [](auto& map, Key key) { map.insert(key, Value(key), expect); },
+      [](auto& map, Key key) { benchmark::DoNotOptimize(map.erase(key, expect)); });
+}
+
+static void BM_MyMapInsertHitHeavy(benchmark::State& state) {
+  performMyMapRedundantTest<maplib::Expect::CHANGE>(state, true);
+}
+BENCHMARK(BM_MyMapInsertHitHeavy)->ARGS;
+
+static void BM_MyMapInsertHitHeavyExpectNoChange(benchmark::State& state) {
+  performMyMapRedundantTest<maplib::Expect::NO_CHANGE>(state, true);
+}
+BENCHMARK(BM_MyMapInsertHitHeavyExpectNoChange)->ARGS;
+
+static void BM_MyMapEraseMissHeavy(benchmark::State& state) {
+  performMyMapRedundantTest<maplib::Expect::CHANGE>(state, false);
+}
+BENCHMARK(BM_MyMapEraseMissHeavy)->ARGS;
+
+static void BM_MyMapEraseMissHeavyExpectNoChange(benchmark::State& state) {
+  performMyMapRedundantTest<maplib::Expect::NO_CHANGE>(state, false);
+}
+BENCHMARK(BM_MyMapEraseMissHeavyExpectNoChange)->ARGS;
+
+static void BM_SamplingMapEraseMissHeavy(benchmark::State& state) {
+  performRedundantTest<maplib::SamplingMap<Key, Value, double>>(
+      state, false, [](auto& map, Key key) { map.insert(key, Value(key), 1. + key % 16); },
+      [](auto& map, Key key) { benchmark::DoNotOptimize(map.erase(key)); });
+}
+BENCHMARK(BM_SamplingMapEraseMissHeavy)->ARGS;